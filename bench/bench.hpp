@@ -0,0 +1,376 @@
+#pragma once
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Get the time from a monotonic clock, in nanoseconds.
+inline uint64_t getNanoseconds()
+{
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+// Make the compiler believe that a value is used, so that the code computing
+// it isn't optimized away.
+template <typename Type>
+inline void keep(const Type& value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Find the average time taken by a function, in nanoseconds. The function is
+// called in batches that double in size until a batch takes at least
+// `minimum` nanoseconds, so that reading the clock doesn't count for fast
+// functions, and slow ones are still only called a few times.
+template <typename Function>
+double measure(Function&& function, uint64_t minimum = 100'000'000)
+{
+	for (uint64_t calls = 1;; calls *= 2) {
+		uint64_t start = getNanoseconds();
+		for (uint64_t i = 0; i < calls; i++)
+			function();
+		uint64_t elapsed = getNanoseconds() - start;
+		if (elapsed >= minimum)
+			return static_cast<double>(elapsed) / calls;
+	}
+}
+
+// Print the heading of a table of results.
+inline void printHeading(const char* title)
+{
+	std::printf("\n%s\n", title);
+}
+
+// Set up a process that runs the server's code in-process: move into a new
+// temporary directory, so that the files it writes (such as the journal) don't
+// end up in the working directory, and silence the server's log. The directory
+// is removed when the program exits.
+inline void setUpServerCode()
+{
+	static std::string path = (std::filesystem::temp_directory_path() / "ircserv-bench-XXXXXX").string();
+	if (mkdtemp(path.data()) == nullptr || chdir(path.c_str()) == -1) {
+		std::perror("Failed to create a temporary directory");
+		std::exit(EXIT_FAILURE);
+	}
+	std::atexit([] { std::filesystem::remove_all(path); });
+	std::cout.setstate(std::ios::failbit);
+}
+
+// Print the median, 99th percentile and maximum of a list of times, given in
+// nanoseconds, in microseconds.
+inline void printLatencies(const char* name, std::vector<uint64_t> samples)
+{
+	if (samples.empty())
+		return (void) std::printf("%-28s %10s\n", name, "no samples");
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&] (double p) { return samples[(samples.size() - 1) * p] / 1000.0; };
+	std::printf("%-28s %10.1f %10.1f %10.1f\n", name, percentile(0.5), percentile(0.99), percentile(1));
+}
+
+// Print the heading of a table of latencies.
+inline void printLatencyHeading(const char* title)
+{
+	printHeading(title);
+	std::printf("%-28s %10s %10s %10s\n", "", "p50", "p99", "max");
+}
+
+/**
+ * A copy of ./ircserv started by a benchmark, either as a server or a bot. It
+ * runs in a temporary directory of its own, with its own configuration file,
+ * and its output goes to a log file there. It's stopped with SIGINT, so that it
+ * exits cleanly.
+ */
+class ServerProcess
+{
+public:
+	ServerProcess(const std::string& config, const std::vector<std::string>& arguments)
+		: arguments(arguments)
+	{
+		static const std::string binary = std::filesystem::absolute("ircserv");
+		program = binary;
+		directory = (std::filesystem::temp_directory_path() / "ircserv-bench-XXXXXX").string();
+		if (mkdtemp(directory.data()) == nullptr) {
+			std::perror("Failed to create a temporary directory");
+			std::exit(EXIT_FAILURE);
+		}
+		configure(config);
+		start();
+	}
+
+	~ServerProcess()
+	{
+		stop();
+		std::filesystem::remove_all(directory);
+	}
+
+	ServerProcess(const ServerProcess&) = delete;
+	ServerProcess& operator=(const ServerProcess&) = delete;
+
+	// Replace the configuration file. It's read again on start() or SIGHUP.
+	void configure(const std::string& config)
+	{
+		std::ofstream(directory + "/ircserv.conf") << config;
+	}
+
+	// Start the process, unless it's already running.
+	void start()
+	{
+		if (pid != -1)
+			return;
+		pid = fork();
+		if (pid == 0) {
+			int log;
+			if (chdir(directory.c_str()) == -1 || (log = open("log", O_WRONLY | O_CREAT | O_APPEND, 0644)) == -1)
+				_exit(EXIT_FAILURE);
+			dup2(log, STDOUT_FILENO);
+			dup2(log, STDERR_FILENO);
+			std::vector<char*> argv = {program.data(), const_cast<char*>("-c"), const_cast<char*>("ircserv.conf")};
+			for (std::string& argument: arguments)
+				argv.push_back(argument.data());
+			argv.push_back(nullptr);
+			execv(program.c_str(), argv.data());
+			_exit(EXIT_FAILURE);
+		}
+	}
+
+	// Stop the process with SIGINT, and wait for it to exit.
+	void stop()
+	{
+		if (pid == -1)
+			return;
+		kill(pid, SIGINT);
+		waitpid(pid, nullptr, 0);
+		pid = -1;
+	}
+
+	// Send a signal to the process.
+	void signal(int signal)
+	{
+		if (pid != -1)
+			kill(pid, signal);
+	}
+
+	const std::string& getDirectory() const
+	{
+		return directory;
+	}
+
+	pid_t getPid() const
+	{
+		return pid;
+	}
+
+private:
+	std::string program;
+	std::vector<std::string> arguments;
+	std::string directory;
+	pid_t pid = -1;
+};
+
+/**
+ * A client connection to a server, over TCP on the loopback interface or over
+ * a Unix-domain socket. Connecting is retried for a few seconds, to give a
+ * server that was just started time to listen.
+ */
+class Connection
+{
+public:
+	explicit Connection(int port)
+	{
+		struct sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		connectTo(AF_INET, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+
+		// Send each line right away, so that only the server's socket options
+		// make a difference.
+		int enable = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+	}
+
+	explicit Connection(const std::string& path)
+	{
+		struct sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+		connectTo(AF_UNIX, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+	}
+
+	~Connection()
+	{
+		if (fd != -1)
+			close(fd);
+	}
+
+	Connection(const Connection&) = delete;
+	Connection& operator=(const Connection&) = delete;
+
+	// Send a line, adding the CRLF.
+	void sendLine(std::string_view line)
+	{
+		std::string data = std::string(line) + "\r\n";
+		for (size_t sent = 0; sent < data.size();) {
+			ssize_t bytes = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+			if (bytes <= 0)
+				return;
+			sent += bytes;
+		}
+	}
+
+	// Read the next line, without its CRLF. Returns false if no complete line
+	// arrives within `timeout` milliseconds, or the connection was closed.
+	bool readLine(std::string& line, int timeout = 2000)
+	{
+		uint64_t deadline = getNanoseconds() + timeout * 1'000'000ull;
+		size_t end;
+		while ((end = buffer.find("\r\n")) == buffer.npos) {
+			uint64_t now = getNanoseconds();
+			struct pollfd event = {fd, POLLIN, 0};
+			if (now >= deadline || poll(&event, 1, (deadline - now + 999'999) / 1'000'000) <= 0)
+				return false;
+			char data[65536];
+			ssize_t bytes = recv(fd, data, sizeof(data), 0);
+			if (bytes <= 0) {
+				closed = true;
+				return false;
+			}
+			buffer.append(data, bytes);
+		}
+		line = buffer.substr(0, end);
+		buffer.erase(0, end + 2);
+		return true;
+	}
+
+	// Read lines until one contains some text. Returns false if none does
+	// within `timeout` milliseconds. The matching line is kept in lastLine.
+	bool waitFor(std::string_view text, int timeout = 2000)
+	{
+		uint64_t deadline = getNanoseconds() + timeout * 1'000'000ull;
+		while (true) {
+			uint64_t now = getNanoseconds();
+			if (now >= deadline || !readLine(lastLine, (deadline - now) / 1'000'000))
+				return false;
+			if (lastLine.find(text) != lastLine.npos)
+				return true;
+		}
+	}
+
+	// Throw away everything received until the server has been quiet for
+	// `quiet` milliseconds.
+	void drain(int quiet = 100)
+	{
+		std::string line;
+		while (readLine(line, quiet))
+			;
+	}
+
+	// Register as a user, and wait for the welcome message.
+	bool logIn(std::string_view nick, std::string_view password = "")
+	{
+		sendLine("PASS " + std::string(password));
+		sendLine("NICK " + std::string(nick));
+		sendLine("USER " + std::string(nick) + " 0 * " + std::string(nick));
+		return waitFor(" 001 ");
+	}
+
+	// Check if the server closed the connection.
+	bool isClosed() const
+	{
+		return closed;
+	}
+
+	int getSocket() const
+	{
+		return fd;
+	}
+
+	std::string lastLine;	// The last line found by waitFor
+
+private:
+	void connectTo(int family, const sockaddr* address, socklen_t length)
+	{
+		for (int attempt = 0; attempt < 300; attempt++) {
+			fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if (fd != -1 && connect(fd, address, length) == 0)
+				return;
+			close(fd);
+			fd = -1;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		std::perror("Failed to connect to the server");
+		std::exit(EXIT_FAILURE);
+	}
+
+	int fd = -1;
+	bool closed = false;
+	std::string buffer;
+};
+
+/**
+ * Measure how long private messages take from one client to another. Stops
+ * early if a message doesn't arrive.
+ */
+inline std::vector<uint64_t> measureLatency(Connection& sender, Connection& receiver, std::string_view receiverNick)
+{
+	std::vector<uint64_t> times;
+	for (int i = 0; i < 2000; i++) {
+		std::string text = "ping " + std::to_string(i);
+		uint64_t start = getNanoseconds();
+		sender.sendLine("PRIVMSG " + std::string(receiverNick) + " :" + text);
+		if (!receiver.waitFor(text))
+			break;
+		times.push_back(getNanoseconds() - start);
+	}
+	return times;
+}
+
+/**
+ * Measure how many messages per second get from one client to another through
+ * a channel they're both on, with the sender writing as fast as it can.
+ */
+inline double measureThroughput(Connection& sender, Connection& receiver, std::string_view channel)
+{
+	constexpr int count = 50000;
+	uint64_t start = getNanoseconds();
+	std::thread reader([&] {
+		std::string line;
+		for (int received = 0; received < count && receiver.readLine(line, 5000);)
+			received += line.find(" PRIVMSG ") != line.npos;
+	});
+	std::string batch;
+	for (int i = 0; i < count; i++) {
+		batch += "PRIVMSG " + std::string(channel) + " :message number " + std::to_string(i) + " with some padding to a typical length\r\n";
+		if (batch.size() > 16384 || i == count - 1) {
+			for (size_t sent = 0; sent < batch.size();) {
+				ssize_t bytes = send(sender.getSocket(), batch.data() + sent, batch.size() - sent, MSG_NOSIGNAL);
+				if (bytes <= 0)
+					break;
+				sent += bytes;
+			}
+			batch.clear();
+		}
+	}
+	reader.join();
+	return count / ((getNanoseconds() - start) / 1e9);
+}
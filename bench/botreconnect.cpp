@@ -0,0 +1,113 @@
+#include <filesystem>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+static constexpr int PORT = 17401;
+static constexpr size_t SESSIONS = 100;
+
+/**
+ * Open the listening socket that stands in for the server.
+ */
+static int listenOn(int port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	int enable = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+	struct sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 || listen(fd, 1024) == -1) {
+		std::perror("Failed to listen");
+		std::exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+/**
+ * Accept connections until there are `count` of them, or no new one comes for
+ * a while, welcoming each one so that its session counts as registered.
+ * Returns the times they were accepted, in nanoseconds.
+ */
+static std::vector<uint64_t> acceptSessions(int listener, std::vector<int>& connections, size_t count)
+{
+	std::vector<uint64_t> times;
+	while (connections.size() < count) {
+		struct pollfd event = {listener, POLLIN, 0};
+		if (poll(&event, 1, 70'000) <= 0)
+			break;
+		int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+		if (fd == -1)
+			continue;
+		times.push_back(getNanoseconds());
+		connections.push_back(fd);
+		const char welcome[] = ":bench 001 bot :Welcome\r\n";
+		send(fd, welcome, sizeof(welcome) - 1, MSG_NOSIGNAL);
+	}
+	return times;
+}
+
+/**
+ * Close all the sessions' connections at once, as a server going down does.
+ */
+static void dropSessions(std::vector<int>& connections)
+{
+	for (int fd: connections)
+		close(fd);
+	connections.clear();
+}
+
+/**
+ * Print when the sessions came back, relative to when they could, and the
+ * most that came back within any 100 ms.
+ */
+static void printReconnects(const char* name, std::vector<uint64_t> times, uint64_t start)
+{
+	if (times.empty())
+		return (void) std::printf("%-24s no reconnects\n", name);
+	std::sort(times.begin(), times.end());
+	size_t peak = 0;
+	for (size_t first = 0, last = 0; last < times.size(); last++) {
+		while (times[last] - times[first] > 100'000'000)
+			first++;
+		peak = std::max(peak, last - first + 1);
+	}
+	auto at = [&] (double p) { return (times[(times.size() - 1) * p] - start) / 1e6; };
+	std::printf("%-24s %8zu %10.0f %10.0f %10.0f %10zu\n", name, times.size(), at(0), at(0.5), at(1), peak);
+}
+
+int main()
+{
+	// Start one bot process with all the sessions.
+	int listener = listenOn(PORT);
+	std::string names;
+	for (size_t i = 0; i < SESSIONS; i++)
+		names += (i == 0 ? "" : ",") + std::string("bot") + std::to_string(i);
+	std::string words = std::filesystem::absolute("badwords.txt");
+	ServerProcess bot("bot_words = " + words + "\n", {std::to_string(PORT), "", names});
+	std::vector<int> connections;
+	acceptSessions(listener, connections, SESSIONS);
+
+	printHeading("Bot sessions reconnecting after losing the server (ms)");
+	std::printf("%zu sessions in one process\n", SESSIONS);
+	std::printf("%-24s %8s %10s %10s %10s %10s\n", "", "sessions", "first", "median", "last", "max/100ms");
+
+	// A quick restart: the connections drop, and the server is back at once.
+	uint64_t start = getNanoseconds();
+	dropSessions(connections);
+	printReconnects("instant restart", acceptSessions(listener, connections, SESSIONS), start);
+
+	// A longer outage: attempts fail while the server is down, so the delays
+	// grow, and the sessions spread out further.
+	dropSessions(connections);
+	close(listener);
+	std::this_thread::sleep_for(std::chrono::seconds(3));
+	listener = listenOn(PORT);
+	start = getNanoseconds();
+	printReconnects("back after 3 s", acceptSessions(listener, connections, SESSIONS), start);
+	dropSessions(connections);
+	close(listener);
+}
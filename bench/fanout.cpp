@@ -0,0 +1,104 @@
+#include <fstream>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "channel.hpp"
+#include "client.hpp"
+#include "config.hpp"
+#include "server.hpp"
+
+// Number of socket pairs shared by the members. Each member gets its own file
+// descriptor, duplicated from one end of a pair, and the other ends are read
+// between measurements so that the sockets never fill up.
+static constexpr size_t SOCKET_PAIRS = 256;
+
+/**
+ * Read everything waiting on the far ends of the socket pairs.
+ */
+static void drain(const std::vector<int>& readers)
+{
+	char buffer[65536];
+	for (int fd: readers)
+		while (recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0)
+			;
+}
+
+/**
+ * Measure how long the event loop is blocked while a message is delivered to
+ * a channel of a given size, with a given number of fan-out threads. Returns
+ * the median time in microseconds.
+ */
+static double benchDelivery(size_t members, int threads)
+{
+	// The thread count is read when the server starts, from the configuration.
+	std::ofstream("fanout.conf") << "fanout_threads = " << threads << "\nfanout_threshold = 1\n";
+	Config::setPath("fanout.conf");
+	Config::load();
+	Server server("6667", "");
+
+	std::vector<int> readers;
+	std::vector<int> writers;
+	for (size_t i = 0; i < std::min(members, SOCKET_PAIRS); i++) {
+		int pair[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) == -1) {
+			std::perror("Failed to create a socket pair");
+			std::exit(EXIT_FAILURE);
+		}
+		writers.push_back(pair[0]);
+		readers.push_back(pair[1]);
+	}
+	Channel& channel = *server.newChannel("#big");
+	for (size_t i = 0; i < members; i++) {
+		Client& client = server.newClient(dup(writers[i % writers.size()]), "127.0.0.1");
+		channel.addMember(client);
+	}
+
+	std::string line = ":sender!user@127.0.0.1 PRIVMSG #big :A message of a typical length for a busy channel\r\n";
+	std::vector<uint64_t> times;
+	for (int i = 0; i < 50; i++) {
+		uint64_t start = getNanoseconds();
+		server.sendToMembers(channel, line, nullptr);
+		times.push_back(getNanoseconds() - start);
+		drain(readers);
+	}
+	for (int fd: writers)
+		close(fd);
+	for (int fd: readers)
+		close(fd);
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2] / 1000.0;
+}
+
+int main()
+{
+	setUpServerCode();
+
+	// Each member takes a file descriptor, so the largest channel depends on
+	// the limit.
+	struct rlimit limit;
+	getrlimit(RLIMIT_NOFILE, &limit);
+	size_t maxMembers = limit.rlim_cur - 2 * SOCKET_PAIRS - 64;
+
+	unsigned cpus = std::thread::hardware_concurrency();
+	std::vector<int> threadCounts = {0, 1, 3};
+	if (cpus > 4)
+		threadCounts.push_back(cpus - 1);
+	printHeading("Loop stall while delivering one message (us, median of 50)");
+	std::printf("%d CPUs, fanout_threads = auto would use %u\n", cpus, cpus > 1 ? cpus - 1 : 0);
+	std::printf("%-10s", "members");
+	for (int threads: threadCounts)
+		std::printf(" %9d thr", threads);
+	std::printf("\n");
+	for (size_t members: {1000, 5000, 15000, 50000}) {
+		if (members > maxMembers) {
+			std::printf("%-10zu (skipped: over the file descriptor limit of %zu)\n", members, (size_t) limit.rlim_cur);
+			continue;
+		}
+		std::printf("%-10zu", members);
+		for (int threads: threadCounts)
+			std::printf(" %13.1f", benchDelivery(members, threads));
+		std::printf("\n");
+	}
+}
@@ -0,0 +1,154 @@
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+
+// Ports of the two servers.
+static constexpr int PORT_A = 17101;
+static constexpr int PORT_B = 17102;
+
+static int failures = 0;
+
+/**
+ * Report the result of one step of the test.
+ */
+static void check(bool passed, const char* description)
+{
+	std::printf("%-60s %s\n", description, passed ? "ok" : "FAILED");
+	failures += !passed;
+}
+
+/**
+ * Get the configuration for one of the servers, optionally linking to the
+ * other one.
+ */
+static std::string getConfig(const char* name, int linkPort = 0)
+{
+	std::string config = "server_name = " + std::string(name) + "\n";
+	config += "link_retry_interval = 1\n";
+	config += "link_password = linksecret\nlink_allow = ?.test 127.0.0.1\n";
+	config += "service = badwords prudebot\n";
+	config += "bot_words = " + std::filesystem::absolute("badwords.txt").string() + "\n";
+	if (linkPort != 0)
+		config += "link = 127.0.0.1:" + std::to_string(linkPort) + "\n";
+	return config;
+}
+
+/**
+ * Measure how long a channel message takes to reach a member on the same
+ * server and a member on the other server.
+ */
+static void benchLatency(Connection& sender, Connection& local, Connection& remote)
+{
+	std::vector<uint64_t> localTimes, remoteTimes;
+	for (int i = 0; i < 2000; i++) {
+		std::string text = "latency " + std::to_string(i);
+		uint64_t start = getNanoseconds();
+		sender.sendLine("PRIVMSG #net :" + text);
+		if (local.waitFor(text))
+			localTimes.push_back(getNanoseconds() - start);
+		if (remote.waitFor(text))
+			remoteTimes.push_back(getNanoseconds() - start);
+	}
+	printLatencyHeading("Channel message delivery (us)");
+	printLatencies("same server", localTimes);
+	printLatencies("across the link", remoteTimes);
+}
+
+int main()
+{
+	printHeading("Two linked servers");
+
+	// Start server A, and create #net there. Channel creation times are in
+	// seconds, so wait before creating it again on server B, which makes it
+	// newer there.
+	ServerProcess a(getConfig("a.test"), {std::to_string(PORT_A), ""});
+	Connection alice(PORT_A), carol(PORT_A), twinA(PORT_A), longNick(PORT_A);
+	alice.logIn("alice");
+	carol.logIn("carol");
+	twinA.logIn("twin");
+	longNick.logIn("longnick");
+	alice.sendLine("JOIN #net");
+	alice.waitFor(" 366 ");
+	carol.sendLine("JOIN #net");
+	carol.waitFor(" 366 ");
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+	// Connections can't become links without the link password, or with a
+	// name that isn't on the link_allow list.
+	Connection intruder(PORT_A), stranger(PORT_A);
+	intruder.sendLine("SERVER evil.test :Intruder");
+	check(intruder.waitFor("ERROR :Incorrect password"), "SERVER without the link password is refused");
+	stranger.sendLine("PASS :linksecret");
+	stranger.sendLine("SERVER evil.example :Stranger");
+	check(stranger.waitFor("ERROR :Server not allowed"), "SERVER with a name that isn't allowed is refused");
+	ServerProcess b(getConfig("b.test") + "nicklen = 6\n", {std::to_string(PORT_B), ""});
+	Connection bob(PORT_B), twinB(PORT_B);
+	bob.logIn("bob");
+	twinB.logIn("twin");
+	bob.sendLine("JOIN #net");
+	bob.waitFor(" 366 ");
+
+	// Link B to A. Each side gets the other's users and channels in the burst.
+	// The channel is older on A, so B drops its modes and statuses before
+	// adding A's members.
+	b.configure(getConfig("b.test", PORT_A) + "nicklen = 6\n");
+	b.signal(SIGHUP);
+	check(alice.waitFor("bob!bob@") && alice.lastLine.ends_with("JOIN #net"), "burst: users on B join #net on A");
+	check(bob.waitFor("MODE #net -o bob"), "SJOIN: B takes the older channel's state from A");
+	check(bob.waitFor("alice!alice@") && bob.lastLine.ends_with("JOIN #net"), "burst: users on A join #net on B");
+	bob.sendLine("NAMES #net");
+	check(bob.waitFor(" 353 ") && bob.lastLine.find("@alice") != std::string::npos
+		&& bob.lastLine.find("@bob") == std::string::npos, "SJOIN: alice stays an operator, bob doesn't");
+
+	// Both users called twin are killed, since neither can keep the name.
+	check(twinA.waitFor("ERROR") && twinA.lastLine.find("Nick collision") != std::string::npos,
+		"nick collision: the user on A is killed");
+	check(twinB.waitFor("ERROR") && twinB.lastLine.find("Nick collision") != std::string::npos,
+		"nick collision: the user on B is killed");
+
+	// B has a shorter nicklen, so it can't take A's user called longnick.
+	check(longNick.waitFor("ERROR") && longNick.lastLine.find("Invalid nickname") != std::string::npos,
+		"nicklen: a nickname too long for B is killed on A");
+
+	// Both servers run a service called prudebot. Each keeps its own, instead
+	// of killing it as a nick collision, so A's still works.
+	alice.sendLine("INVITE prudebot #net");
+	alice.sendLine("PRIVMSG #net :this is shit");
+	check(alice.waitFor("NO, BAD WORD!") && alice.lastLine.starts_with(":prudebot!"),
+		"services: a service on both servers survives the link");
+	alice.sendLine("KICK #net prudebot");
+	bob.sendLine("LUSERS");
+	check(bob.waitFor(" 251 ") && bob.lastLine.find(" 2 servers") != std::string::npos, "LUSERS counts both servers");
+
+	// Messages reach the other server's members.
+	alice.sendLine("PRIVMSG #net :hello from A");
+	check(bob.waitFor("hello from A"), "messages reach members on the other server");
+	bob.drain();
+	carol.drain();
+	benchLatency(alice, carol, bob);
+
+	// Split the network by restarting A. Its users quit on B, with both
+	// servers' names as the reason, and B links again by itself once A is
+	// back, bringing its members back to #net.
+	a.stop();
+	check(bob.waitFor("QUIT :b.test a.test", 3000), "split: users on A quit on B");
+	a.start();
+	Connection dave(PORT_A);
+	dave.logIn("dave");
+	dave.sendLine("JOIN #net");
+	bool rejoined = false;
+	for (int attempt = 0; attempt < 50 && !rejoined; attempt++) {
+		dave.sendLine("NAMES #net");
+		rejoined = dave.waitFor(" 353 ") && dave.lastLine.find("bob") != std::string::npos;
+		if (!rejoined)
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	check(rejoined, "rejoin: B links again, and bob is back on #net on A");
+	dave.drain();
+	bob.sendLine("PRIVMSG #net :hello again");
+	check(dave.waitFor("hello again"), "rejoin: messages flow again");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,127 @@
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "mask.hpp"
+#include "utility.hpp"
+
+/**
+ * The naive way to match a wildcard mask: try every way a '*' could expand,
+ * recursively. It takes exponential time when many '*'s each have many places
+ * to go.
+ */
+static bool matchRecursive(const char* mask, const char* string)
+{
+	if (*mask == '\0')
+		return *string == '\0';
+	if (*mask == '*')
+		return matchRecursive(mask + 1, string) || (*string != '\0' && matchRecursive(mask, string + 1));
+	if (*string == '\0' || (*mask != '?' && foldChar(*mask) != foldChar(*string)))
+		return false;
+	return matchRecursive(mask + 1, string + 1);
+}
+
+/**
+ * The matcher WHO used before masks were compiled: only the most recent '*' is
+ * retried after a mismatch, so the worst case is quadratic instead of
+ * exponential. Both strings must already be casefolded.
+ */
+static bool matchBacktracking(std::string_view mask, std::string_view string)
+{
+	size_t m = 0, s = 0;
+	size_t starMask = mask.npos, starString = 0;
+	while (s < string.length()) {
+		if (m < mask.length() && (mask[m] == '?' || mask[m] == string[s])) {
+			m++, s++;
+		} else if (m < mask.length() && mask[m] == '*') {
+			starMask = m++;
+			starString = s;
+		} else if (starMask != mask.npos) {
+			m = starMask + 1;
+			s = ++starString;
+		} else {
+			return false;
+		}
+	}
+	while (m < mask.length() && mask[m] == '*')
+		m++;
+	return m == mask.length();
+}
+
+/**
+ * Compare matching one string against one mask.
+ */
+static void benchSingle()
+{
+	static const struct {
+		const char* name;
+		const char* mask;
+		std::string string;
+	} cases[] = {
+		{"host ban, match", "*!*@*.example.com", "Someone!~user@dsl-12-34.Example.COM"},
+		{"host ban, miss", "*!*@*.example.org", "Someone!~user@dsl-12-34.Example.COM"},
+		{"no wildcards", "someone!~user@dsl-12-34.example.com", "Someone!~user@dsl-12-34.Example.COM"},
+		{"prefix", "some*", "Someone!~user@dsl-12-34.Example.COM"},
+		{"worst case, 6 stars", "*a*a*a*a*a*a*b", std::string(40, 'a')},
+		{"worst case, 8 stars", "*a*a*a*a*a*a*a*a*b", std::string(40, 'a')},
+		{"worst case, '?'", "*?*?*?*?*?*?*!", std::string(40, 'x')},
+	};
+	printHeading("One mask against one string (ns per match)");
+	std::printf("%-24s %12s %14s %14s\n", "case", "Mask", "backtracking", "recursive");
+	for (const auto& test: cases) {
+		Mask mask(test.mask);
+		std::string foldedMask = foldCase(test.mask);
+		double compiled = measure([&] { keep(mask.matches(test.string)); });
+		double backtracking = measure([&] { keep(matchBacktracking(foldedMask, foldCase(test.string))); });
+		double recursive = measure([&] { keep(matchRecursive(test.mask, test.string.c_str())); });
+		std::printf("%-24s %12.1f %14.1f %14.1f\n", test.name, compiled, backtracking, recursive);
+	}
+}
+
+/**
+ * Compare matching one hostmask against a ban list, with a MaskSet and by
+ * trying each mask in turn.
+ */
+static void benchList()
+{
+	printHeading("One hostmask against a ban list (ns per check)");
+	std::printf("%-24s %12s %14s %14s\n", "bans", "MaskSet", "backtracking", "recursive");
+	for (size_t count: {10, 100, 1000, 5000}) {
+		MaskSet set;
+		std::vector<std::string> masks;
+		for (size_t i = 0; i < count; i++) {
+			switch (i % 4) {
+				case 0: masks.push_back("*!*@host" + std::to_string(i) + ".isp" + std::to_string(i % 50) + ".net"); break;
+				case 1: masks.push_back("nick" + std::to_string(i) + "!*@*"); break;
+				case 2: masks.push_back("*!user" + std::to_string(i) + "@*"); break;
+				case 3: masks.push_back("*!*@10.0." + std::to_string(i % 256) + ".*"); break;
+			}
+			set.add(masks.back());
+		}
+		std::vector<std::string> foldedMasks;
+		for (const std::string& mask: masks)
+			foldedMasks.push_back(foldCase(mask));
+		std::string string = "Someone!~user@dsl-12-34.Example.COM";
+		double compiled = measure([&] { keep(set.match(string)); });
+		double backtracking = measure([&] {
+			std::string folded = foldCase(string);
+			bool found = false;
+			for (size_t i = 0; i < foldedMasks.size() && !found; i++)
+				found = matchBacktracking(foldedMasks[i], folded);
+			keep(found);
+		});
+		double recursive = measure([&] {
+			bool found = false;
+			for (size_t i = 0; i < masks.size() && !found; i++)
+				found = matchRecursive(masks[i].c_str(), string.c_str());
+			keep(found);
+		});
+		std::printf("%-24zu %12.1f %14.1f %14.1f\n", count, compiled, backtracking, recursive);
+	}
+}
+
+int main()
+{
+	benchSingle();
+	benchList();
+}
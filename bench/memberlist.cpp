@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "bench.hpp"
+#include "client.hpp"
+#include "memberlist.hpp"
+#include "server.hpp"
+
+/**
+ * Channel membership as it was kept before MemberList: a std::set of clients
+ * for each kind of status.
+ */
+struct MemberSets
+{
+	std::set<Client*> members;
+	std::set<Client*> operators;
+	std::set<Client*> invited;
+};
+
+/**
+ * Compare MemberList with the sets for a channel of a given size, in which
+ * every tenth member is an operator.
+ */
+static void benchChannel(Server& server, size_t size)
+{
+	// The clients have no connections, so they're given keys that can't be
+	// file descriptors.
+	static int nextKey = 1'000'000;
+	std::vector<Client*> clients;
+	for (size_t i = 0; i < size; i++)
+		clients.push_back(&server.newClient(nextKey++, "host" + std::to_string(i) + ".example.com"));
+	MemberList list;
+	MemberSets sets;
+	for (size_t i = 0; i < size; i++) {
+		list.addMember(clients[i]);
+		sets.members.insert(clients[i]);
+		if (i % 10 == 0) {
+			list.setFlags(clients[i], MEMBER_OPERATOR);
+			sets.operators.insert(clients[i]);
+		}
+	}
+
+	// Look up the members in a random order, so that the caches don't help.
+	std::vector<Client*> order = clients;
+	std::shuffle(order.begin(), order.end(), std::mt19937(size));
+	size_t next = 0;
+	auto nextClient = [&] { return order[next++ % order.size()]; };
+
+	// Membership tests, as done for every message sent to a channel.
+	double listLookup = measure([&] { keep(list.isMember(nextClient())); });
+	double setLookup = measure([&] { keep(sets.members.contains(nextClient())); });
+
+	// Going through the members and their status, as for NAMES, per member.
+	double listNames = measure([&] {
+		size_t operators = 0;
+		for (const Member& member: list.allMembers())
+			operators += (member.flags & MEMBER_OPERATOR) != 0;
+		keep(operators);
+	}) / size;
+	double setNames = measure([&] {
+		size_t operators = 0;
+		for (Client* member: sets.members)
+			operators += sets.operators.contains(member);
+		keep(operators);
+	}) / size;
+
+	// Removing a member, and adding it back, as when a user parts and joins.
+	double listChurn = measure([&] {
+		Client* client = nextClient();
+		list.removeMember(client);
+		list.addMember(client);
+	});
+	double setChurn = measure([&] {
+		Client* client = nextClient();
+		sets.members.erase(client);
+		sets.operators.erase(client);
+		sets.invited.erase(client);
+		sets.members.insert(client);
+	});
+
+	std::printf("%-8zu %-18s %12.1f %12.1f\n", size, "isMember", listLookup, setLookup);
+	std::printf("%-8s %-18s %12.2f %12.2f\n", "", "NAMES, per member", listNames, setNames);
+	std::printf("%-8s %-18s %12.1f %12.1f\n", "", "part and join", listChurn, setChurn);
+}
+
+int main()
+{
+	// The server is never destroyed, since it would send ERROR to the clients,
+	// which have no sockets.
+	setUpServerCode();
+	Server* server = new Server("6667", "");
+	printHeading("Channel members (ns per operation)");
+	std::printf("%-8s %-18s %12s %12s\n", "members", "operation", "MemberList", "std::set");
+	for (size_t size: {10, 1000, 50000})
+		benchChannel(*server, size);
+}
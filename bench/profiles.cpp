@@ -0,0 +1,44 @@
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+// The built-in socket profiles, each on a listener of its own.
+static const struct {
+	const char* name;
+	int port;
+} profiles[] = {
+	{"default", 17201},
+	{"latency", 17202},
+	{"bulk", 17203},
+};
+
+int main()
+{
+	std::string config;
+	for (const auto& profile: profiles)
+		config += "listen = 127.0.0.1:" + std::to_string(profile.port) + " " + profile.name + "\n";
+	ServerProcess server(config, {std::to_string(profiles[0].port), ""});
+
+	std::vector<std::vector<uint64_t>> latencies;
+	std::vector<double> throughputs;
+	for (const auto& profile: profiles) {
+		Connection sender(profile.port), receiver(profile.port);
+		std::string suffix = profile.name;
+		sender.logIn("sender" + suffix);
+		receiver.logIn("receiver" + suffix);
+		sender.sendLine("JOIN #bench");
+		receiver.sendLine("JOIN #bench");
+		sender.drain();
+		receiver.drain();
+		latencies.push_back(measureLatency(sender, receiver, "receiver" + suffix));
+		throughputs.push_back(measureThroughput(sender, receiver, "#bench"));
+	}
+
+	printLatencyHeading("Private message latency by socket profile (us)");
+	for (size_t i = 0; i < std::size(profiles); i++)
+		printLatencies(profiles[i].name, latencies[i]);
+	printHeading("Channel message throughput by socket profile");
+	for (size_t i = 0; i < std::size(profiles); i++)
+		std::printf("%-28s %10.0f messages/s\n", profiles[i].name, throughputs[i]);
+}
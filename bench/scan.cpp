@@ -0,0 +1,172 @@
+#include <random>
+#include <string>
+#include <vector>
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#include "bench.hpp"
+#include "irc.hpp"
+#include "scan.hpp"
+
+/**
+ * Split a message the way the parser did before scanDelimiters, with repeated
+ * find calls on a copy of the line. Returns the number of parts.
+ */
+static int splitNaive(std::string message)
+{
+	int argc = 0;
+	char* argv[MAX_MESSAGE_PARTS];
+	size_t begin = message.find_first_not_of(' ');
+	if (begin != message.npos && message[begin] == ':') {
+		size_t end = message.find(' ', begin);
+		if (end == message.npos)
+			return 0;
+		message[end] = '\0';
+		begin = end + 1;
+	}
+	while (begin < message.length()) {
+		begin = message.find_first_not_of(' ', begin);
+		if (begin == message.npos)
+			break;
+		size_t end = message.find(' ', begin);
+		if (end == message.npos)
+			end = message.length();
+		if (message[begin] != '@') {
+			if (argc == MAX_MESSAGE_PARTS)
+				return -1;
+			if (message[begin] == ':') {
+				end = message.length();
+				begin++;
+			}
+			argv[argc++] = message.data() + begin;
+			message[end] = '\0';
+		}
+		begin = end + (end < message.length());
+	}
+	keep(argv);
+	return argc;
+}
+
+/**
+ * Handle a receive buffer the old way: find each "\r\n", copy the line out,
+ * split it, and erase it from the front of the buffer.
+ */
+static int parseNaive(std::string& input)
+{
+	int parts = 0;
+	for (size_t newline; (newline = input.find("\r\n")) != input.npos;) {
+		parts += splitNaive(std::string(input.begin(), input.begin() + newline));
+		input.erase(0, newline + 2);
+	}
+	return parts;
+}
+
+/**
+ * Handle a receive buffer the new way: scan it once, split the lines in
+ * place, and erase them all at once.
+ */
+static int parseScanned(std::string& input, Delimiters& delimiters)
+{
+	int parts = 0;
+	char* argv[MAX_MESSAGE_PARTS];
+	char* prefix;
+	scanDelimiters(input, delimiters);
+	size_t begin = 0;
+	for (uint32_t end: delimiters.lineEnds) {
+		parts += splitMessage(input.data(), begin, end, delimiters.spaces, argv, prefix);
+		begin = end + 2;
+	}
+	input.erase(0, begin);
+	return parts;
+}
+
+/**
+ * Make up a buffer of about the given size, full of channel messages of
+ * random words, like a busy client sends.
+ */
+static std::string makeTraffic(std::mt19937& random, size_t size)
+{
+	std::string traffic;
+	while (traffic.size() < size) {
+		std::string message = "PRIVMSG #channel" + std::to_string(random() % 10) + " :";
+		size_t length = std::uniform_int_distribution<size_t>(10, 200)(random);
+		while (message.size() < length) {
+			message += std::string(1 + random() % 9, 'a' + random() % 26);
+			message += ' ';
+		}
+		message.back() = '\r';
+		traffic += message + "\n";
+	}
+	return traffic;
+}
+
+/**
+ * Find how many TSC cycles there are in a nanosecond, so that the results can
+ * be given per cycle as well. Returns 0 where there's no TSC.
+ */
+static double getCyclesPerNanosecond()
+{
+#ifdef __x86_64__
+	uint64_t start = getNanoseconds();
+	uint64_t cycles = __rdtsc();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	return static_cast<double>(__rdtsc() - cycles) / (getNanoseconds() - start);
+#else
+	return 0;
+#endif
+}
+
+int main()
+{
+	static constexpr size_t sizes[] = {512, 4096, 65536};
+	std::mt19937 random(42);
+	std::vector<std::string> buffers;
+	for (size_t size: sizes)
+		buffers.push_back(makeTraffic(random, size));
+	double cyclesPerNanosecond = getCyclesPerNanosecond();
+	const char* unit = cyclesPerNanosecond > 0 ? "bytes per TSC cycle" : "bytes/ns";
+	double scale = cyclesPerNanosecond > 0 ? cyclesPerNanosecond : 1;
+
+	auto printRow = [&] (const char* name, auto&& handle) {
+		std::printf("%-20s", name);
+		for (const std::string& buffer: buffers)
+			std::printf(" %10.2f", buffer.size() / measure([&] { handle(buffer); }) / scale);
+		std::printf("\n");
+	};
+	auto printSizes = [&] (const char* title) {
+		printHeading(title);
+		std::printf("%-20s %10s %10s %10s\n", "", "512 B", "4 KiB", "64 KiB");
+	};
+	std::vector<const char*> kernels;
+	for (const char* kernel: {"avx2", "sse2", "scalar"})
+		if (isScanKernelSupported(kernel))
+			kernels.push_back(kernel);
+
+	// The scan alone, for each kernel the CPU can run.
+	Delimiters delimiters;
+	printSizes((std::string("Finding line ends and spaces (") + unit + ")").c_str());
+	for (const char* kernel: kernels) {
+		selectScanKernel(kernel);
+		printRow(kernel, [&] (const std::string& buffer) {
+			scanDelimiters(buffer, delimiters);
+			keep(delimiters);
+		});
+	}
+
+	// Splitting every message in the buffer, the old way and with each kernel.
+	// Both copy the buffer first, since handling it consumes it.
+	std::string input;
+	printSizes((std::string("Splitting all the messages in a buffer (") + unit + ")").c_str());
+	printRow("find and copy", [&] (const std::string& buffer) {
+		input = buffer;
+		keep(parseNaive(input));
+	});
+	for (const char* kernel: kernels) {
+		selectScanKernel(kernel);
+		printRow(kernel, [&] (const std::string& buffer) {
+			input = buffer;
+			keep(parseScanned(input, delimiters));
+		});
+	}
+}
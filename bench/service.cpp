@@ -0,0 +1,97 @@
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+static constexpr int SERVICE_PORT = 17501;
+static constexpr int BOT_PORT = 17502;
+
+/**
+ * Get the CPU time a process has used so far, in milliseconds.
+ */
+static double getCpuTime(pid_t pid)
+{
+	std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+	std::string stat((std::istreambuf_iterator<char>(file)), {});
+	size_t position = stat.rfind(')') + 2;
+	std::vector<std::string> fields;
+	while (position < stat.size()) {
+		size_t end = stat.find(' ', position);
+		fields.push_back(stat.substr(position, end - position));
+		position = end == stat.npos ? stat.size() : end + 1;
+	}
+	// Fields 14 and 15 of the file (user and system time) are at 11 and 12
+	// here, since the first two were skipped.
+	return (std::stod(fields[11]) + std::stod(fields[12])) * 1000 / sysconf(_SC_CLK_TCK);
+}
+
+/**
+ * Measure one way of running the bad word filter: how long the scolding takes
+ * to arrive, and how much CPU time the server and the bot (if it's a separate
+ * process) spend on a stream of ordinary channel messages.
+ */
+static void benchFilter(const char* name, int port, const std::vector<const ServerProcess*>& processes)
+{
+	Connection user(port), reader(port);
+	user.logIn("user");
+	reader.logIn("reader");
+	user.sendLine("JOIN #chat");
+	user.sendLine("INVITE prudebot #chat");
+	if (!user.waitFor("prudebot!") || !user.lastLine.ends_with("JOIN #chat")) {
+		std::printf("%-28s prudebot didn't join\n", name);
+		return;
+	}
+	reader.sendLine("JOIN #chat");
+	user.drain();
+	reader.drain();
+
+	std::vector<uint64_t> times;
+	for (int i = 0; i < 2000; i++) {
+		uint64_t start = getNanoseconds();
+		user.sendLine("PRIVMSG #chat :this is shit number " + std::to_string(i));
+		if (!user.waitFor("NO, BAD WORD!"))
+			break;
+		times.push_back(getNanoseconds() - start);
+	}
+	reader.drain();
+
+	double cpu = 0;
+	for (const ServerProcess* process: processes)
+		cpu -= getCpuTime(process->getPid());
+	double throughput = measureThroughput(user, reader, "#chat");
+	for (const ServerProcess* process: processes)
+		cpu += getCpuTime(process->getPid());
+	printLatencies(name, times);
+	std::printf("%-28s %10.0f messages/s, %.0f ms of CPU for 50000 messages\n", "", throughput, cpu);
+}
+
+int main()
+{
+	std::string words = "bot_words = " + std::filesystem::absolute("badwords.txt").string() + "\n";
+	printLatencyHeading("Time until a bad word is scolded (us)");
+
+	// The filter as a service inside the server.
+	{
+		ServerProcess server(words + "service = badwords prudebot\n", {std::to_string(SERVICE_PORT), ""});
+		benchFilter("service", SERVICE_PORT, {&server});
+	}
+
+	// The filter as a bot connected over TCP.
+	{
+		ServerProcess server(words, {std::to_string(BOT_PORT), ""});
+		Connection probe(BOT_PORT);
+		ServerProcess bot(words, {std::to_string(BOT_PORT), "", "prudebot"});
+		probe.logIn("probe");
+		bool online = false;
+		for (int attempt = 0; attempt < 100 && !online; attempt++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			probe.sendLine("WHO prudebot");
+			while (probe.waitFor(" 3") && probe.lastLine.find(" 315 ") == std::string::npos)
+				online |= probe.lastLine.find(" 352 ") != std::string::npos;
+		}
+		benchFilter("TCP bot", BOT_PORT, {&server, &bot});
+	}
+}
@@ -0,0 +1,39 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+static constexpr int PORT = 17301;
+
+int main()
+{
+	// The socket's path is relative to the server's directory.
+	ServerProcess server("listen = 127.0.0.1\nlisten = unix:ircserv.sock\n", {std::to_string(PORT), ""});
+	std::string path = server.getDirectory() + "/ircserv.sock";
+
+	std::vector<uint64_t> latencies[2];
+	double throughputs[2];
+	for (int unix = 0; unix < 2; unix++) {
+		auto connect = [&] {
+			return unix ? std::make_unique<Connection>(path) : std::make_unique<Connection>(PORT);
+		};
+		std::unique_ptr<Connection> sender = connect(), receiver = connect();
+		std::string suffix = std::to_string(unix);
+		sender->logIn("sender" + suffix);
+		receiver->logIn("receiver" + suffix);
+		sender->sendLine("JOIN #bench");
+		receiver->sendLine("JOIN #bench");
+		sender->drain();
+		receiver->drain();
+		latencies[unix] = measureLatency(*sender, *receiver, "receiver" + suffix);
+		throughputs[unix] = measureThroughput(*sender, *receiver, "#bench");
+	}
+
+	printLatencyHeading("Private message latency (us)");
+	printLatencies("loopback TCP", latencies[0]);
+	printLatencies("Unix-domain socket", latencies[1]);
+	printHeading("Channel message throughput");
+	std::printf("%-28s %10.0f messages/s\n", "loopback TCP", throughputs[0]);
+	std::printf("%-28s %10.0f messages/s\n", "Unix-domain socket", throughputs[1]);
+}
@@ -0,0 +1,68 @@
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "wordmatcher.hpp"
+
+/**
+ * The way the bot looked for words before WordMatcher: lowercase the message,
+ * then search it for each word in turn. Unlike WordMatcher, it also finds
+ * words inside longer words.
+ */
+static bool matchNaive(const std::vector<std::string>& words, std::string message)
+{
+	for (char& c: message)
+		c = std::tolower(static_cast<unsigned char>(c));
+	for (const std::string& word: words)
+		if (std::strstr(message.c_str(), word.c_str()))
+			return true;
+	return false;
+}
+
+/**
+ * Make up a word of random letters.
+ */
+static std::string makeWord(std::mt19937& random, size_t minLength, size_t maxLength)
+{
+	std::string word(std::uniform_int_distribution<size_t>(minLength, maxLength)(random), ' ');
+	for (char& c: word)
+		c = 'a' + random() % 26;
+	return word;
+}
+
+int main()
+{
+	// The messages are made of common words, which aren't in the lists, and
+	// one in a hundred has a listed word in it.
+	std::mt19937 random(42);
+	std::vector<std::string> common;
+	for (int i = 0; i < 500; i++)
+		common.push_back(makeWord(random, 2, 8));
+	std::vector<std::string> listed;
+	for (int i = 0; i < 10000; i++)
+		listed.push_back(makeWord(random, 9, 12));
+	std::vector<std::string> messages;
+	for (int i = 0; i < 1000; i++) {
+		std::string message;
+		while (message.size() < 80)
+			message += (message.empty() ? "" : " ") + common[random() % common.size()];
+		if (i % 100 == 0)
+			message += " " + listed[random() % listed.size()];
+		message[0] = std::toupper(message[0]);
+		messages.push_back(message);
+	}
+
+	printHeading("Checking channel messages for listed words (messages/s)");
+	std::printf("%-10s %14s %14s %10s\n", "words", "WordMatcher", "naive", "states");
+	for (size_t count: {10, 100, 1000, 10000}) {
+		std::vector<std::string> words(listed.begin(), listed.begin() + count);
+		WordMatcher matcher;
+		matcher.build(words);
+		size_t next = 0;
+		double automaton = measure([&] { keep(matcher.matches(messages[next++ % messages.size()])); });
+		double naive = measure([&] { keep(matchNaive(words, messages[next++ % messages.size()])); });
+		std::printf("%-10zu %14.0f %14.0f %10zu\n", count, 1e9 / automaton, 1e9 / naive, matcher.getStateCount());
+	}
+}
@@ -1,60 +1,31 @@
 #pragma once
 
-#include <set>
+#include <deque>
 #include <string>
-#include <string_view>
+#include <vector>
 
+#include "botsession.hpp"
+#include "wordmatcher.hpp"
+
+/**
+ * A process running any number of bot sessions, which share one epoll loop
+ * and one word list.
+ */
 class Bot
 {
 public:
-	explicit Bot(const char* name);
+	explicit Bot(const std::vector<std::string>& names);
 	~Bot();
 
 	void run(const char* port, const char* password);
+	const WordMatcher& getWords() const;
 
 private:
-	int connectToServer(const char* port);
-	void parseMessage(std::string message);
-	void handleMessage(int argc, char** argv);
-	void receive();
-
-	// Send a string to the client.
-	void send(const std::string_view& string);
-
-	// Send a single value of numeric type (using std::to_string).
-	template <typename Type>
-	void send(const Type& value)
-	{
-		send(std::to_string(value));
-	}
-
-	// Send multiple values by recursively calling other send() functions.
-	template <typename First, typename... Rest>
-	void send(const First& first, const Rest&... rest)
-	{
-		send(first);
-		send(rest...);
-	}
-
-	// Send multiple values and add a CRLF line break at the end.
-	template <typename... Arguments>
-	void sendLine(const Arguments&... arguments)
-	{
-		send(arguments...); // Send all the arguments.
-		send("\r\n"); // Add a newline at the end.
-	}
-
-	// Types that must be converted to string_view to be sent.
-	void send(char character) { send(std::string_view(&character, 1)); }
-	void send(char* string) { send(std::string_view(string)); }
-	void send(const char* string = "") { send(std::string_view(string)); }
-	void send(const std::string& string) { send(std::string_view(string)); }
+	bool loadWords();
+	void connectSessions(const char* port, const char* password);
+	int getTimeout() const;
 
-	int socket = -1;
 	int epoll = -1;
-	bool disconnected = false;
-	std::string name;
-	std::string input;
-	std::string output;
-	std::set<std::string> channels;
+	std::deque<BotSession> sessions;	// All sessions (a deque, since they can't be moved)
+	WordMatcher words;					// Words to scold users for
 };
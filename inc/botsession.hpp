@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Bot;
+
+/**
+ * One of the bot identities run by a Bot process: a connection to the server
+ * with its own nickname, channels and buffers. When the connection is lost,
+ * the session reconnects by itself after a randomized delay, which grows with
+ * each failed attempt, and joins its channels again.
+ */
+class BotSession
+{
+public:
+	BotSession(Bot& bot, std::string_view name, uint32_t index);
+	~BotSession();
+	BotSession(const BotSession&) = delete;
+	BotSession& operator=(const BotSession&) = delete;
+
+	void connect(int epoll, const char* port, const char* password);
+	void handleEvent();
+	bool isConnected() const;
+	bool isStopped() const;
+	int64_t getReconnectTime() const;
+	const std::string& getName() const;
+
+private:
+	int connectToServer(const char* port);
+	void disconnect(std::string_view reason);
+	void parseMessage(size_t begin, size_t end, std::span<const uint32_t> spaces);
+	void handleMessage(int argc, char** argv);
+	void receive();
+
+	// Send a string to the server.
+	void send(const std::string_view& string);
+
+	// Send a single value of numeric type (using std::to_string).
+	template <typename Type>
+	void send(const Type& value)
+	{
+		send(std::to_string(value));
+	}
+
+	// Send multiple values by recursively calling other send() functions.
+	template <typename First, typename... Rest>
+	void send(const First& first, const Rest&... rest)
+	{
+		send(first);
+		send(rest...);
+	}
+
+	// Send multiple values and add a CRLF line break at the end.
+	template <typename... Arguments>
+	void sendLine(const Arguments&... arguments)
+	{
+		send(arguments...); // Send all the arguments.
+		send("\r\n"); // Add a newline at the end.
+	}
+
+	// Types that must be converted to string_view to be sent.
+	void send(char character) { send(std::string_view(&character, 1)); }
+	void send(char* string) { send(std::string_view(string)); }
+	void send(const char* string = "") { send(std::string_view(string)); }
+	void send(const std::string& string) { send(std::string_view(string)); }
+
+	Bot& bot;
+	uint32_t index;					// Position in the bot's sessions, used as the epoll key
+	int socket = -1;
+	bool disconnected = false;		// Whether the connection was lost while handling an event
+	bool stopped = false;			// Whether the session gave up for good
+	int failures = 0;				// Connection attempts that failed since the last successful one
+	int64_t reconnectTime = 0;		// When to connect again, in milliseconds
+	std::string name;
+	std::string input;
+	std::string output;
+	std::set<std::string> channels;	// Channels to be in, joined again after reconnecting
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * A server-wide pool of I/O buffers. Clients borrow a buffer only while they
+ * have pending input or output, and give it back as soon as it's drained, so
+ * idle clients hold no buffer memory at all. Buffers start at io_buffer_size
+ * bytes; ones that grew much bigger during a burst are freed instead of being
+ * reused. Buffers can be borrowed by the fan-out threads too, so the pool is
+ * protected by a mutex.
+ */
+class BufferPool
+{
+public:
+	BufferPool() = default;
+	BufferPool(const BufferPool&) = delete;
+	BufferPool& operator=(const BufferPool&) = delete;
+
+	void acquire(std::string& buffer);
+	void release(std::string& buffer);
+	size_t trim();
+
+	size_t getInUseCount();
+	size_t getPeakCount();
+	size_t getFreeCount();
+
+private:
+	std::mutex mutex;
+	std::vector<std::string> buffers;	// Unused buffers, ready to be borrowed
+	size_t inUse = 0;					// Number of buffers currently borrowed
+	size_t peak = 0;					// Highest number of buffers borrowed at once
+	size_t lowWater = 0;				// Lowest number of unused buffers since the last trim
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * A set of bytes allowed in some kind of name: a range, minus a few excluded
+ * bytes. Strings are checked against it 16 bytes at a time by isInCharClass,
+ * which compares with the range and each excluded byte at once, and one byte
+ * at a time with the bitmap.
+ */
+struct CharClass
+{
+	constexpr CharClass(unsigned char lowest, unsigned char highest, std::string_view excluded)
+		: lowest(lowest), highest(highest), excluded(excluded)
+	{
+		for (int c = lowest; c <= highest; c++)
+			if (excluded.find(static_cast<char>(c)) == excluded.npos)
+				allowed[c / 64] |= uint64_t(1) << (c % 64);
+	}
+
+	constexpr bool contains(unsigned char c) const
+	{
+		return (allowed[c / 64] >> (c % 64)) & 1;
+	}
+
+	unsigned char lowest;			// First byte of the range
+	unsigned char highest;			// Last byte of the range
+	std::string_view excluded;		// Bytes in the range that aren't allowed (at most 8)
+	uint64_t allowed[4] = {};		// Bitmap of the allowed bytes
+};
+
+// Nicknames, channel names after the '#', and other names: printable ASCII
+// except for the characters that separate parts of masks and lists.
+inline constexpr CharClass NAME_CHARS(0x21, 0x7e, ",:!@#*");
+
+// Channel keys: anything but whitespace.
+inline constexpr CharClass KEY_CHARS(0x00, 0xff, "\t\n\v\f\r ");
+
+// Lowercase version of each character, according to the server's casemapping.
+extern std::array<char, 256> caseFoldTable;
+
+bool isKnownCasemapping(std::string_view name);
+void setCasemapping(std::string_view name);
+const char* getCasemapping();
+void foldCaseInPlace(char* data, size_t length);
+bool equalsIgnoreCase(std::string_view a, std::string_view b);
+bool isInCharClass(std::string_view string, const CharClass& chars);
@@ -1,24 +1,46 @@
 #pragma once
 
 #include <climits>
-#include <set>
+#include <span>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "history.hpp"
+#include "journal.hpp"
+#include "mask.hpp"
+#include "memberlist.hpp"
 
 class Client;
 class Server;
 
 struct MemberIterators
 {
-	std::set<Client*>::iterator first, last;
+	MemberList::Iterator first, last;
 	auto begin() { return first; }
 	auto end() { return last; }
 };
 
+// An entry on a channel's ban (+b) or ban exception (+e) list.
+struct ListEntry
+{
+	std::string mask;	// The full nick!user@host mask
+	std::string setBy;	// Nickname of the client who added the mask
+	int64_t setAt;		// Unix timestamp for when the mask was added
+};
+
+// A server link with members on a channel, and how many of them there are.
+struct ChannelLink
+{
+	Client* link;	// The link the members are reached through
+	int members;	// Number of members behind the link
+};
+
 class Channel
 {
 public:
-	explicit Channel(std::string_view name);
+	explicit Channel(std::string_view name, Journal* journal = nullptr);
 	Channel(const Channel&) = default;
 	Channel& operator=(const Channel&) = default;
 	~Channel() = default;
@@ -31,12 +53,17 @@ public:
 	void addOperator(Client& client);
 	void removeOperator(Client& client);
 
+	bool isVoiced(Client& client) const;
+	void addVoice(Client& client);
+	void removeVoice(Client& client);
+
 	bool hasKey() const;
 	std::string_view getKey() const;
 	bool setKey(std::string_view newKey);
 	void removeKey();
 
 	MemberIterators allMembers();
+	std::span<const Member> allMemberEntries() const;
 	int getMemberLimit() const;
 	void setMemberLimit(int limit);
 	bool isFull() const;
@@ -51,21 +78,42 @@ public:
 	void removeInvited(Client& invited);
 	void resetInvited();
 
+	bool addListMask(char mode, std::string_view mask, std::string_view setBy);
+	bool removeListMask(char mode, std::string_view mask);
+	const std::vector<ListEntry>& getListMasks(char mode) const;
+	bool isBanned(Client& client);
+	void forgetBanStatus(Client& client);
+
 	std::string getModes() const;
 	static bool isValidName(std::string_view name);
 	Client* findClientByName(std::string_view name);
 
+	void renameMember(Client& client, std::string_view newNick);
 	std::string_view getName() const;
+	History& getHistory();
 
 	bool hasTopic() const;
 	std::string_view getTopic() const;
 	std::string_view getTopicChange() const;
 	void setTopic(std::string_view newTopic, Client& client);
+	void setTopic(std::string_view newTopic, std::string_view setter);
 
 	bool isTopicRestricted() const;
 	void setTopicRestricted(bool enable);
 
 	int64_t getCreationTime() const;
+	void setCreationTime(int64_t time);
+	void resetModes();
+	const std::vector<ChannelLink>& getLinks() const;
+
+	bool isDormant() const;
+	void setDormant(bool enable);
+
+	void saveSnapshot(StateWriter& out) const;
+	void restoreSnapshot(StateReader& in);
+	void replay(JournalRecord type, StateReader& in);
+	void saveState(StateWriter& out, const std::unordered_map<const Client*, int64_t>& clientIndexes) const;
+	void restoreState(StateReader& in, const std::vector<Client*>& clients);
 
 private:
 	std::string name;				// The name of the channel
@@ -73,10 +121,17 @@ private:
 	std::string topicChangeStr;		// The nick of the person who last changed topic plus a timestamp
 	std::string key;				// Key for the +k mode (empty = no key)
 	int64_t creationTime;			// Unix timestamp for the channel creation
-	std::set<Client*> members;		// All clients joined to this channel
-	std::set<Client*> operators;	// All clients with operator privileges
-	std::set<Client*> invited;		// All nicknames invited to this channel
+	MemberList members;				// All clients joined or invited to this channel
+	std::unordered_map<std::string, Client*> nicks;	// Members by casefolded nickname
+	MaskSet bans;					// Compiled masks for the +b mode
+	MaskSet exceptions;				// Compiled masks for the +e mode
+	std::vector<ListEntry> banList;			// Ban masks, in the order they were set
+	std::vector<ListEntry> exceptionList;	// Exception masks, in the order they were set
+	std::vector<ChannelLink> links;			// Server links with members on the channel
 	bool inviteOnly = false;		// Whether the +i mode is set
 	bool topicRestricted = false;	// Whether the +t mode is set
 	int memberLimit = INT_MAX;		// Limit for the +l mode
+	bool dormant = false;			// Whether the channel was restored from disk and nobody has joined since
+	History history;				// Recent messages, for CHATHISTORY
+	Journal* journal;				// Journal where changes to the channel are recorded, if any
 };
@@ -1,17 +1,37 @@
 #pragma once
 
 #include <climits>
-#include <set>
+#include <span>
+#include <type_traits>
 #include <string>
 #include <string_view>
 
+#include "clienttable.hpp"
+#include "inlinestring.hpp"
+#include "interned.hpp"
+#include "irc.hpp"
 #include "server.hpp"
+#include "smallvector.hpp"
+#include "state.hpp"
+#include "timerwheel.hpp"
 
 class Channel;
+class Service;
+struct HistoryLine;
+
+// The IRCv3 capabilities a client can enable with CAP REQ.
+enum Capability : uint8_t
+{
+	CAP_BATCH = 1,				// Replies to a query are grouped with BATCH
+	CAP_MESSAGE_TAGS = 2,		// Messages are sent with their tags
+	CAP_SERVER_TIME = 4,		// Messages have a time tag
+	CAP_CHATHISTORY = 8,		// The client can use CHATHISTORY (draft/chathistory)
+};
 
 struct ClientChannelIterators
 {
-	std::set<Channel*>::iterator first, last;
+	Channel** first;
+	Channel** last;
 	auto begin() { return first; }
 	auto end() { return last; }
 };
@@ -20,21 +40,48 @@ class Client
 {
 public:
 	Client(Server& server, int fd, std::string_view host);
-	~Client() = default;
+	~Client();
 
 	int getSocket() const;
+	ClientHandle getHandle() const;
+	void acquireHandle();
 	ClientChannelIterators allChannels();
+	bool isOnChannel(const Channel* channel) const;
+	void addChannel(Channel* channel);
+	void removeChannel(Channel* channel);
+	size_t getChannelCount() const;
 	void setChannelMode(Channel& channel, char* modes, char* args);
 	void clearChannels();
 	std::string_view getHost() const;
-	std::string_view getFullName() const;
+	std::string getFullName() const;
 	std::string_view getNick() const;
+	bool markVisited(uint64_t epoch);
+	bool hasRegistered() const;
+	bool isIrcOperator() const;
+	bool hasCapability(uint8_t capability) const;
+	bool hasFullSendQueue() const;
+	bool isRemote() const;
+	Client* getLink() const;
+	void setRemote(Client& link, std::string_view newNick, std::string_view newUser, std::string_view newRealname);
+	Service* getService() const;
+	void setService(Service& newService, std::string_view newNick);
+	std::string getIntroduction() const;
+	bool isLink() const;
+	bool isOutgoingLink() const;
+	std::string_view getServerName() const;
+	void startLink();
+	void finishLink(std::string_view name);
 	bool isDisconnected() const;
 	void setDisconnected();
+	void startTimer();
+	void saveState(StateWriter& out) const;
+	void restoreState(StateReader& in);
+	void handleTimeout();
 
 	void receive();
-	void parseMessage(std::string message);
-	void handleMessage(int argc, char** argv);
+	void parseMessage(size_t begin, size_t end, std::span<const uint32_t> spaces);
+	void handleMessage(int argc, char** argv, const char* prefix = nullptr);
+	void handleLinkMessage(const char* prefix, int argc, char** argv);
 
 	void handleUser(int argc, char** argv);
 	void handleNick(int argc, char** argv);
@@ -54,23 +101,34 @@ public:
 	void handleLusers(int argc, char** argv);
 	void handleMotd(int argc, char** argv);
 	void handleNotice(int argc, char** argv);
+	void handlePong(int argc, char** argv);
+	void handleServer(int argc, char** argv);
+	void handleOper(int argc, char** argv);
+	void handleRehash(int argc, char** argv);
+	void handleStats(int argc, char** argv);
+	void handleCap(int argc, char** argv);
+	void handleChatHistory(int argc, char** argv);
 
 	// Send a numeric reply.
 	template <typename... Arguments>
 	void sendNumeric(const char* num, const Arguments&... args)
 	{
-		const char* name = nick.empty() ? "*" : nick.c_str();
+		std::string_view name = nick.empty() ? "*" : std::string_view(nick);
 		sendLine(":", server.getHostname(), " ", num, " ", name, " ", args...);
 	}
 
 	// Send a string to the client.
 	void send(const std::string_view& string);
 
-	// Send a single value of numeric type (using std::to_string).
+	// Send a single value of numeric type (using std::to_string), or of a type
+	// that converts to a string_view.
 	template <typename Type>
 	void send(const Type& value)
 	{
-		send(std::to_string(value));
+		if constexpr (std::is_convertible_v<Type, std::string_view>)
+			send(std::string_view(value));
+		else
+			send(std::to_string(value));
 	}
 
 	// Send multiple values by recursively calling other send() functions.
@@ -97,20 +155,51 @@ public:
 
 	static bool isValidName(std::string_view name);
 	void handleRegistrationComplete();
+	void sendHistoryLine(const HistoryLine& message, std::string_view batch = {});
+	void sendListMasks(Channel& channel, char mode);
+	void sendWhoReply(Client& client, Channel* channel, std::string_view fields, std::string_view token);
 	bool checkParams(const char* cmd, bool reg, int argc, int min, int max);
 
 private:
+	void handleRemoteServer(int argc, char** argv);
+	void handleSquit(int argc, char** argv);
+	void handleRemoteUser(int argc, char** argv);
+	void handleRemoteNick(Client& source, int argc, char** argv);
+	void handleSjoin(int argc, char** argv);
+	void handleBmask(int argc, char** argv);
+	void handleTburst(int argc, char** argv);
+	void handleKill(int argc, char** argv);
+	void handleError(int argc, char** argv);
+	size_t writeSocket(std::string_view data);
+
+	// Fields are ordered to keep the object small, since an idle connection
+	// is mostly just this object.
 	Server& server;					// Reference to the server object
+	Client* link = nullptr;			// For users on other servers, the server link they're reached through
+	Service* service = nullptr;		// For in-process services, the service behind the pseudo-client
+	ClientHandle handle;			// The client's handle in the ClientTable (see acquireHandle)
 	int socket = -1;				// The socket used for the client's connection
-	std::set<Channel*>	channels;	// All channels the client is joined to
-	std::string host;				// The client's host IP address
-	std::string user;				// The client's user name
-	std::string realname;			// The client's real name
-	std::string fullname;			// The full nick!user@host name
-	std::string nick;				// The client's nickname
-	std::string input;				// Buffered data from recv()
-	std::string output;				// Buffered data for send()
 	bool isRegistered = false;		// Whether the client completed registration
 	bool isPassValid = false;		// Whether the client gave the correct password
+	bool isLinkPassValid = false;	// Whether the client gave the link password (see handleServer)
 	bool disconnected = false;		// Set to true when the client is disconnected
+	bool awaitingPong = false;		// Whether a PING was sent without a reply yet
+	bool outgoingLink = false;		// Whether this is a server link opened by this server
+	bool isOper = false;			// Whether the client is an IRC operator (see OPER)
+	bool sendQueueFull = false;		// Set when pending output goes over the SendQ limit
+	bool negotiatingCaps = false;	// Whether registration waits for CAP END
+	uint8_t capabilities = 0;		// The capabilities the client enabled (see Capability)
+	InlineString<NICKLEN> nick;		// The client's nickname
+	InlineString<USERLEN> user;		// The client's user name
+	InternedString host;			// The client's host IP address
+	InternedString realname;		// The client's real name
+	InternedString serverName;		// For server links, the name of the linked server
+	SmallVector<Channel*, 2> channels;	// All channels the client is joined to
+	std::string input;				// Buffered data from recv()
+	std::string output;				// Buffered data for send()
+	int64_t lastActivity = 0;		// Time of the last message, in Unix milliseconds
+	int64_t lastMessage = 0;		// Time of the last message other than PING/PONG
+	int64_t floodClock = 0;			// Time until which the client's flood penalty lasts
+	uint64_t visitMark = 0;			// Epoch of the last neighbour fan-out that reached the client
+	Timer timer;					// Timer for registration, keepalive and idle timeouts
 };
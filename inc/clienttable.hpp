@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class Client;
+
+// A reference to a client that can safely outlive it: the index of the
+// client's slot in the ClientTable, and the generation of the slot when the
+// client got it. Once the client is gone, the slot's generation changes, so
+// the handle no longer finds anything, even after the slot is reused.
+struct ClientHandle
+{
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool operator==(const ClientHandle& other) const = default;
+};
+
+/**
+ * The table of live clients that ClientHandles point into. Structures that
+ * refer to clients without being told when they leave (such as invite lists)
+ * keep handles, and find out that a client is gone by looking it up, in
+ * constant time, instead of the server removing it from each of them when it
+ * disconnects. Slots of removed clients are reused for new ones.
+ */
+class ClientTable
+{
+public:
+	static ClientHandle add(Client& client);
+	static void remove(ClientHandle handle);
+	static Client* find(ClientHandle handle);
+
+private:
+	struct Slot
+	{
+		Client* client;			// The client, or null if the slot is free
+		uint32_t generation;	// Incremented each time the slot is freed
+		uint32_t nextFree;		// Next free slot, if this one is free
+	};
+
+	static std::vector<Slot> slots;
+	static uint32_t firstFree;	// First free slot, or UINT32_MAX if there's none
+};
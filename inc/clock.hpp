@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * The server's wall clock, sampled once per iteration of the event loop. The
+ * formatted timestamps are only rebuilt when the second changes, so reading
+ * the time anywhere in a message handler never calls into the C library's time
+ * formatting functions.
+ */
+class Clock
+{
+public:
+	static void update();
+	static int64_t getUnixTime();
+	static int64_t getMilliseconds();
+	static std::string_view getUnixString();
+	static std::string_view getAsctime();
+	static std::string_view getIsoTime();
+
+private:
+	static int64_t seconds;			// Unix time in seconds
+	static int64_t milliseconds;	// Unix time in milliseconds
+	static char unixString[24];		// Seconds as a decimal string
+	static char asctimeString[32];	// Local time in asctime() format
+	static char isoString[32];		// UTC time in ISO 8601 format, with milliseconds
+	static size_t unixLength;
+	static size_t asctimeLength;
+	static size_t isoLength;
+};
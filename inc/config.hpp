@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "irc.hpp"
+
+/**
+ * A named set of socket options, applied to a listening socket and to the
+ * connections accepted on it. Zero leaves an option at the kernel's default.
+ */
+struct SocketProfile
+{
+	std::string name;
+	bool noDelay = false;		// TCP_NODELAY: send small writes without waiting to merge them
+	int notSentLowat = 0;		// TCP_NOTSENT_LOWAT: unsent bytes the kernel queues before the socket stops being writable
+	int sendBuffer = 0;			// SO_SNDBUF, in bytes
+	int receiveBuffer = 0;		// SO_RCVBUF, in bytes
+	int busyPoll = 0;			// SO_BUSY_POLL: microseconds to busy-poll the device when reading
+	int deferAccept = 0;		// TCP_DEFER_ACCEPT: seconds to wait for the first data before accepting
+};
+
+/**
+ * An address to accept connections on, and the socket profile to use for it.
+ */
+struct ListenAddress
+{
+	std::string address;		// "host", "host:port", or "unix:path"
+	std::string profile;		// Name of a SocketProfile
+};
+
+/**
+ * The server's tunable settings, read from a configuration file of "key =
+ * value" lines (see ircserv.conf for the full list). The file is read at
+ * startup, and again on SIGHUP or an operator's REHASH, so most settings can
+ * be changed without restarting the server. Settings missing from the file
+ * keep their default values. Sizes are in bytes, and times are in seconds
+ * unless noted otherwise.
+ */
+struct Config
+{
+	// Server and network.
+	std::string serverName;						// Name of this server on the network (defaults to the hostname)
+	std::string link;							// Address of another server to link to ("host:port"), if any
+	std::string linkPassword;					// Password linked servers give each other (empty to refuse links)
+	std::vector<std::pair<std::string, std::string>> linkAllow;	// Name and address masks of servers allowed to link
+	std::string casemapping = "ascii";			// How names are compared ignoring case (needs a restart)
+	std::vector<ListenAddress> listen = {{"0.0.0.0", "default"}};	// Addresses to accept connections on
+	std::string unixHost = "localhost";			// Host given to clients on Unix-domain sockets
+	std::vector<std::pair<std::string, std::string>> operators;	// Names and passwords accepted by OPER
+	std::string motdFile;						// File with the message of the day (empty for the built-in one)
+	std::string motd;							// Contents of the MOTD file, read along with the configuration
+	std::string botWords = "badwords.txt";		// File with the words the bot reacts to
+	std::vector<std::pair<std::string, std::string>> services;	// Types and nicknames of in-process services
+	std::vector<std::pair<std::string, std::string>> filters;	// Message filter stages and their actions, in order
+	std::string filterWords;					// File with the words for the "words" filter stage
+	std::string historySpillDir;				// Directory for channel history segment files (empty to keep none)
+
+	// Socket profiles for listeners. The built-in ones can be redefined.
+	std::vector<SocketProfile> profiles = {
+		{"default"},
+		{"latency", true, 16 * 1024, 0, 0, 50, 5},
+		{"bulk", false, 0, 1 << 20, 1 << 20, 0, 0},
+	};
+
+	// Event loop and I/O.
+	size_t listenBacklog = 20;					// Maximum length of the pending connection queue
+	size_t epollBatch = 10;						// Maximum number of events received by epoll at one time
+	size_t epollBusyPoll = 0;					// Microseconds epoll busy-polls for events before sleeping
+	size_t fanoutThreshold = 2000;				// Channel size at which messages are delivered by several threads
+	int64_t fanoutThreads = 0;					// Extra delivery threads, or -1 for one per extra CPU (needs a restart)
+	size_t ioBufferSize = 1024;					// Size of the buffers clients borrow for pending I/O
+	size_t ioBufferMaxSize = 16 * 1024;			// Buffers that grew beyond this are freed instead of reused
+	size_t ioPoolMaxFree = 4096;				// Maximum number of unused I/O buffers kept for reuse
+	size_t ioPoolTrimInterval = 60;				// Time between freeing I/O buffers that went unused
+	std::string scanKernel = "auto";			// Vector instructions used to find message boundaries
+
+	// Per-client limits, where zero means no limit.
+	size_t sendQueue = 0;						// Output a client can fall behind on before it's dropped
+	size_t receiveQueue = 0;					// Length of an unfinished line a client can send
+	size_t floodCost = 0;						// Milliseconds of penalty for each message
+	size_t floodBurst = 10000;					// Milliseconds of penalty allowed before the client is dropped
+	size_t filterRepeatCount = 3;				// Times a message can be repeated before the "repeat" filter stage matches
+	size_t filterRepeatWindow = 60;				// Time between repeats for them to count as repeats
+
+	// Channel history, for CHATHISTORY.
+	size_t historyLines = 100;					// Messages kept in memory for each channel (0 disables history)
+	size_t historyBytes = 64 * 1024;			// Bytes of messages kept in memory for each channel
+	size_t historyMaxReplies = 100;				// Most messages returned for one CHATHISTORY query
+	size_t historySpillSize = 1 << 20;			// Size of each channel's history segment file
+
+	// Timeouts.
+	size_t registrationTimeout = 60;			// Time a connection may take to complete registration
+	size_t pingInterval = 120;					// Silence from a client before it's sent a PING
+	size_t pingTimeout = 60;					// Time to wait for any reply to a PING
+	size_t idleTimeout = 0;						// Time without messages (other than PING/PONG) before a client is dropped
+	size_t linkRetryInterval = 10;				// Time before reopening a lost or failed server link
+	size_t journalCheckInterval = 60;			// Time between checks for whether the journal should be compacted
+	size_t journalCompactSize = 4 << 20;		// Journal size at which it's compacted into a new snapshot
+
+	// Protocol limits, advertised to clients in RPL_ISUPPORT.
+	size_t nickLength = NICKLEN;				// Maximum number of characters in a nickname
+	size_t userLength = USERLEN;				// Maximum number of characters in a username
+	size_t channelLength = 63;					// Maximum number of characters in a channel name
+	size_t topicLength = 255;					// Maximum number of characters in a channel topic
+	size_t kickLength = 255;					// Maximum number of characters in a kick reason
+	size_t channelLimit = 50;					// Maximum number of channels a client can be joined to
+	size_t maxList = 5000;						// Maximum number of entries on a ban or exception list
+	size_t whoMaxReplies = 200;					// Maximum number of replies sent for a single WHO mask
+
+	std::vector<std::string> getSupportTokens() const;
+	const SocketProfile& getProfile(std::string_view name) const;
+
+	static const Config& get();
+	static void setPath(std::string_view path);
+	static const std::string& getPath();
+	static bool load();
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A small pool of worker threads for splitting a loop over many items into
+ * parts that run at the same time. The calling thread takes one part itself,
+ * and run() only returns once every part is finished, so the work looks the
+ * same to the rest of the program as a plain loop would.
+ */
+class FanOut
+{
+public:
+	explicit FanOut(size_t threadCount);
+	FanOut(const FanOut&) = delete;
+	FanOut& operator=(const FanOut&) = delete;
+	~FanOut();
+
+	size_t getThreadCount() const;
+	void run(size_t count, const std::function<void(size_t, size_t)>& task);
+
+private:
+	void work(size_t part);
+	void runPart(size_t part);
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;	// Signals the workers that a job is ready
+	std::condition_variable done;	// Signals the caller that the last part finished
+	const std::function<void(size_t, size_t)>* task = nullptr;	// The current job
+	size_t count = 0;				// Number of items in the current job
+	uint64_t generation = 0;		// Incremented for each job
+	size_t remaining = 0;			// Number of parts still running
+	std::exception_ptr error;		// First exception thrown by a part
+	bool stopping = false;			// Set when the pool is destroyed
+};
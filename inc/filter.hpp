@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "wordmatcher.hpp"
+
+class Client;
+struct Config;
+
+// What a filter stage does with a message it matches.
+enum FilterAction
+{
+	FILTER_BLOCK,		// Drop the message, and stop running the pipeline
+	FILTER_REWRITE,		// Let the stage change the message text
+	FILTER_TAG,			// Deliver the message, but report it to operators
+};
+
+// A message going through the filter pipeline.
+struct FilterMessage
+{
+	Client& sender;
+	std::string_view command;		// "PRIVMSG" or "NOTICE"
+	std::string_view targets;		// The message's target list
+	std::string text;				// The message text, as rewritten so far
+	std::vector<std::string> tags;	// Names of the stages that tagged the message
+	std::string blockedBy;			// Name of the stage that blocked the message, if any
+};
+
+/**
+ * One step of the filter pipeline. A stage decides whether a message matches,
+ * and the pipeline then applies the action configured for the stage. Stages
+ * that support FILTER_REWRITE also know how to change a message.
+ */
+class FilterStage
+{
+public:
+	FilterStage(std::string_view name, FilterAction action);
+	virtual ~FilterStage() = default;
+
+	virtual bool matches(FilterMessage& message) = 0;
+	virtual void rewrite(std::string& text);
+
+	const std::string& getName() const;
+	FilterAction getAction() const;
+
+	// Counters shown by STATS f.
+	uint64_t calls = 0;			// Messages checked by the stage
+	uint64_t hits = 0;			// Messages the stage matched
+	uint64_t nanoseconds = 0;	// Total time spent in the stage
+
+private:
+	std::string name;
+	FilterAction action;
+};
+
+/**
+ * The filters that PRIVMSG and NOTICE messages from local users go through
+ * before they're delivered, in the order given by the "filter" lines of the
+ * configuration file. Each stage is timed, so operators can see what each one
+ * costs with STATS f.
+ */
+class FilterPipeline
+{
+public:
+	void configure(const Config& config);
+	bool run(FilterMessage& message);
+	bool isEmpty() const;
+	const std::vector<std::unique_ptr<FilterStage>>& getStages() const;
+
+	static bool isValidStage(std::string_view stage, std::string_view action);
+	static bool parseAction(std::string_view name, FilterAction& action);
+	static const char* getActionName(FilterAction action);
+
+private:
+	std::vector<std::unique_ptr<FilterStage>> stages;
+};
+
+size_t findControlByte(std::string_view text, size_t from = 0);
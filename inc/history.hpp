@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "state.hpp"
+
+struct Config;
+class HistorySegment;
+
+// A message in a channel's history, pointing at the line as it was broadcast.
+// The line starts with its tags ("@time=...;msgid=... "), which are left out
+// for clients that didn't enable them, and ends with "\r\n".
+struct HistoryLine
+{
+	uint64_t msgid;				// Message ID, increasing with each message
+	int64_t time;				// Unix time in milliseconds
+	uint32_t tagLength;			// Length of the tags, including the space after them
+	std::string_view line;		// The tagged line
+
+	std::string_view getUntagged() const { return line.substr(tagLength); }
+	std::string_view getTags() const { return line.substr(1, tagLength - 2); }
+	std::string_view getTimeTag() const { return getTags().substr(0, getTags().find(';')); }
+};
+
+// One end of a CHATHISTORY range, given as "msgid=<id>" or "timestamp=<time>",
+// or "*" for the latest message.
+struct HistoryReference
+{
+	enum Type { LATEST, MSGID, TIMESTAMP } type = LATEST;
+	uint64_t msgid = 0;
+	int64_t time = 0;			// Unix time in milliseconds
+
+	static bool parse(std::string_view string, HistoryReference& reference);
+};
+
+// The kinds of CHATHISTORY queries.
+enum HistoryQuery
+{
+	HISTORY_LATEST,				// Latest messages, after the reference unless it's "*"
+	HISTORY_BEFORE,				// Latest messages before the reference
+	HISTORY_AFTER,				// Earliest messages after the reference
+	HISTORY_BETWEEN,			// Messages between two references, from the first
+};
+
+/**
+ * The recent messages of a channel, kept so that clients can fetch what they
+ * missed with CHATHISTORY. Messages are stored already tagged and serialized,
+ * in a ring of reusable lines bounded by history_lines and history_bytes, so
+ * broadcasting a message and replaying it later both send the same bytes.
+ *
+ * If history_spill_dir is set, messages pushed out of the ring are moved to a
+ * fixed-size segment file for the channel, which is mapped into memory and
+ * used as a ring of its own. Segments outlive the channel and the server
+ * process, and are picked up again the next time the channel is used.
+ */
+class History
+{
+public:
+	explicit History(std::string_view channelName);
+
+	HistoryLine add(std::string_view line);
+	void query(HistoryQuery type, const HistoryReference& from, const HistoryReference& to,
+		size_t limit, std::vector<HistoryLine>& result);
+	void saveState(StateWriter& out) const;
+	void restoreState(StateReader& in);
+
+private:
+	// A line in the ring. The line's buffer is reused for later messages.
+	struct Entry
+	{
+		uint64_t msgid;
+		int64_t time;
+		uint32_t tagLength;
+		std::string line;
+	};
+
+	Entry& push(const Config& config, size_t length);
+	void evict();
+	HistorySegment* getSegment(const Config& config);
+
+	std::string name;						// Casefolded channel name, for the segment file
+	std::vector<Entry> entries;				// The ring of recent messages
+	size_t first = 0;						// Index of the oldest message in the ring
+	size_t count = 0;						// Number of messages in the ring
+	size_t bytes = 0;						// Length of the lines in the ring
+	Entry scratch;							// The last message, when history is disabled
+	std::shared_ptr<HistorySegment> segment;	// Older messages on disk, if enabled
+};
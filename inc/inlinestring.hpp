@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/**
+ * A string of at most Capacity characters, stored inside the object instead
+ * of on the heap. Longer strings are truncated when they're assigned.
+ */
+template <size_t Capacity>
+class InlineString
+{
+	static_assert(Capacity <= UINT8_MAX);
+
+public:
+	InlineString() = default;
+	InlineString(std::string_view string) { assign(string); }
+
+	InlineString& operator=(std::string_view string)
+	{
+		assign(string);
+		return *this;
+	}
+
+	operator std::string_view() const { return {text, count}; }
+	bool empty() const { return count == 0; }
+	size_t size() const { return count; }
+	size_t length() const { return count; }
+
+private:
+	void assign(std::string_view string)
+	{
+		count = std::min(string.size(), Capacity);
+		std::memmove(text, string.data(), count);
+	}
+
+	char text[Capacity] = {};
+	uint8_t count = 0;
+};
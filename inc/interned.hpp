@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+/**
+ * A handle to a string kept in one table shared by the whole server, so that
+ * any number of clients with the same host or real name share a single copy
+ * of it. Handles are reference counted, and a string is dropped from the
+ * table along with its last handle. An empty string needs no table entry.
+ */
+class InternedString
+{
+public:
+	InternedString() = default;
+	InternedString(std::string_view string);
+	InternedString(const InternedString& other);
+	InternedString& operator=(const InternedString& other);
+	InternedString& operator=(std::string_view string);
+	~InternedString();
+
+	operator std::string_view() const;
+	bool empty() const;
+	size_t size() const;
+	static size_t getTableSize();
+
+private:
+	using Entry = std::pair<const std::string, size_t>;
+
+	void release();
+
+	Entry* entry = nullptr;	// The string and its reference count in the table
+};
@@ -6,20 +6,25 @@
 // The maximum allowable port number.
 #define PORT_MAX 65535
 
-// Maximum length of the pending connection queue.
-#define MAX_BACKLOG 20
+// Environment variable used to pass the hand-over socket to a new process
+// during a hot restart.
+#define HANDOVER_ENV "IRCSERV_HANDOVER_FD"
+
+// Configuration file read at startup and on REHASH (see Config), unless
+// another one is given with -c on the command line.
+#define CONFIG_FILE "ircserv.conf"
+
+// Files where channel state is kept across restarts (see Journal).
+#define JOURNAL_FILE "ircserv.journal"
+#define SNAPSHOT_FILE "ircserv.snapshot"
 
 // Maximum number of parts (parameters) in one message.
 #define MAX_MESSAGE_PARTS 15
 
-// Maximum number of events received by epoll at one time.
-#define MAX_EVENTS 10
-
-#define NICKLEN 31		// Maximum number of characters in a nickname.
-#define USERLEN 31		// Maximum number of characters in a username.
-#define CHANNELLEN 63	// Maximum number of characters in a channel name.
-#define TOPICLEN 255	// Maximum number of characters in a channel topic.
-#define KICKLEN 255		// Maximum number of characters in a kick reason.
+// Longest nickname and username the server can store. The configured limits
+// (nicklen and userlen) can be lower, but not higher.
+#define NICKLEN 31
+#define USERLEN 31
 
 #define STRINGIFIER(x) #x
 #define STRINGIFY(x) STRINGIFIER(x)
@@ -82,6 +87,7 @@
 #define RPL_ENDOFEXCEPTLIST     349
 #define RPL_VERSION             351
 #define RPL_WHOREPLY            352
+#define RPL_WHOSPCRPL           354
 #define RPL_NAMREPLY            353
 #define RPL_LINKS               364
 #define RPL_ENDOFLINKS          365
@@ -141,6 +147,7 @@
 #define ERR_BANNEDFROMCHAN      474
 #define ERR_BADCHANNELKEY       475
 #define ERR_BADCHANMASK         476
+#define ERR_BANLISTFULL         478
 #define ERR_NOPRIVILEGES        481
 #define ERR_CHANOPRIVSNEEDED    482
 #define ERR_CANTKILLSERVER      483
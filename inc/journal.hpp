@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "state.hpp"
+
+// Types of records in the channel state journal. Every record starts with the
+// type and the channel name, followed by the arguments listed here.
+enum JournalRecord : int64_t
+{
+	JOURNAL_CREATE,				// Channel created (creation time)
+	JOURNAL_REMOVE,				// Channel removed
+	JOURNAL_TOPIC,				// Topic changed (topic, topic change string)
+	JOURNAL_KEY,				// Key set or removed (key, empty if removed)
+	JOURNAL_LIMIT,				// Member limit changed (limit)
+	JOURNAL_INVITE_ONLY,		// Mode +i changed (enabled)
+	JOURNAL_TOPIC_RESTRICTED,	// Mode +t changed (enabled)
+	JOURNAL_ADD_MASK,			// Ban or exception added (mode, mask, set by, set at)
+	JOURNAL_REMOVE_MASK,		// Ban or exception removed (mode, mask)
+};
+
+/**
+ * Keeps channel state on disk, so that it survives a restart. Changes are
+ * appended to a journal file, and the journal is periodically compacted into
+ * a snapshot of all channels. When the server starts, the snapshot is mapped
+ * into memory and read in place, and then the journal is replayed on top.
+ *
+ * Records are buffered in memory and written with a single append per
+ * iteration of the event loop. The journal isn't synced to disk, so it
+ * survives the server crashing, but not necessarily the machine crashing.
+ */
+class Journal
+{
+public:
+	Journal() = default;
+	Journal(const Journal&) = delete;
+	Journal& operator=(const Journal&) = delete;
+	~Journal();
+
+	void open(std::string_view journalFile, std::string_view snapshotFile);
+	bool isOpen() const;
+	void flush();
+	bool needsCompaction() const;
+	void compact(const StateWriter& snapshot);
+	void load(const std::function<void(StateReader&)>& loadSnapshot,
+		const std::function<void(StateReader&)>& replayRecord);
+
+	template <typename... Arguments>
+	void record(JournalRecord type, std::string_view channel, const Arguments&... arguments);
+
+private:
+	std::string journalPath;	// Path of the journal file
+	std::string snapshotPath;	// Path of the snapshot file
+	int fd = -1;				// The journal file, opened for appending
+	size_t size = 0;			// Bytes written to the journal file
+	StateWriter pending;		// Records not yet written to the journal file
+};
+
+/**
+ * Add a record to the journal. Integer and string arguments are written in the
+ * order they're given.
+ */
+template <typename... Arguments>
+void Journal::record(JournalRecord type, std::string_view channel, const Arguments&... arguments)
+{
+	if (fd == -1)
+		return;
+	StateWriter record;
+	record.writeInt(type);
+	record.writeString(channel);
+	([&] {
+		if constexpr (std::is_convertible_v<Arguments, std::string_view>)
+			record.writeString(arguments);
+		else
+			record.writeInt(arguments);
+	}(), ...);
+	pending.writeString(record.getData());
+}
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <string_view>
+#include <type_traits>
 
 // ANSI escape codes for nicer terminal output.
 #define ANSI_RED	"\x1b[31m"
@@ -20,7 +21,10 @@ void print(const std::string& str);
 template <typename Type>
 void print(const Type& value)
 {
-	print(std::to_string(value));
+	if constexpr (std::is_convertible_v<Type, std::string_view>)
+		print(std::string_view(value));
+	else
+		print(std::to_string(value));
 }
 
 template <typename First, typename... Rest>
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A wildcard mask (such as "nick!*@*.example.com"), compiled once so that it
+ * can be matched against many strings cheaply. '*' matches any sequence of
+ * characters, and '?' matches any single character. Matching ignores case,
+ * according to the server's casemapping.
+ */
+class Mask
+{
+public:
+	explicit Mask(std::string_view pattern);
+
+	static std::string normalize(std::string_view pattern);
+	bool matches(std::string_view string) const;
+	std::string_view getPattern() const;
+	std::string_view getPrefix() const;
+	std::string_view getSuffix() const;
+
+private:
+	// A run of literal characters (and '?') between two '*' wildcards, stored
+	// as an offset and length into the folded pattern.
+	struct Segment
+	{
+		size_t begin;
+		size_t length;
+	};
+
+	bool matchSegment(const Segment& segment, const char* string) const;
+	size_t findSegment(const Segment& segment, std::string_view string, size_t begin, size_t end) const;
+
+	std::string pattern;			// The mask as it was given
+	std::string folded;				// Casefolded pattern, with repeated '*'s merged
+	std::vector<Segment> segments;	// Literal segments between '*'s
+	size_t literalLength = 0;		// Number of characters matched by segments
+	bool anchoredBegin = true;		// Whether the pattern doesn't start with '*'
+	bool anchoredEnd = true;		// Whether the pattern doesn't end with '*'
+	bool hasWildcards = false;		// Whether there is any '*' or '?'
+};
+
+/**
+ * A set of compiled masks that can all be matched against one string at once.
+ * Masks without wildcards are found through a hash lookup, and masks ending in
+ * a long enough literal suffix (like "*!*@*.example.com") are bucketed by the
+ * last few characters of that suffix, so that only the masks that could
+ * possibly match are actually tried.
+ */
+class MaskSet
+{
+public:
+	MaskSet() = default;
+	MaskSet(const MaskSet& other);
+	MaskSet& operator=(const MaskSet& other);
+	~MaskSet() = default;
+
+	bool add(std::string_view pattern);
+	bool remove(std::string_view pattern);
+	bool contains(std::string_view pattern) const;
+	const Mask* match(std::string_view string) const;
+	const std::list<Mask>& allMasks() const;
+	size_t size() const;
+	bool isEmpty() const;
+	void clear();
+
+private:
+	using MaskIterator = std::list<Mask>::iterator;
+
+	static constexpr size_t SUFFIX_KEY_LENGTH = 4;
+
+	std::list<Mask> masks;										// All masks, in insertion order
+	std::unordered_map<std::string, MaskIterator> byPattern;	// Masks by folded pattern
+	std::unordered_map<std::string, const Mask*> literals;		// Masks without wildcards
+	std::unordered_map<std::string, std::vector<const Mask*>> bySuffix; // Masks by suffix key
+	std::vector<const Mask*> others;							// Masks that must always be tried
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "clienttable.hpp"
+
+class Client;
+
+// Status flags for a client on a channel's member list.
+enum MemberFlags : uint8_t
+{
+	MEMBER_OPERATOR   = 1 << 0,	// The member has channel operator privileges
+	MEMBER_VOICE      = 1 << 1,	// The member has voice
+	MEMBER_INVITED    = 1 << 2,	// The client is on the invite list
+	MEMBER_BANCHECKED = 1 << 3,	// The MEMBER_BANNED flag is up to date
+	MEMBER_BANNED     = 1 << 4,	// The member matches the ban list
+};
+
+// A client on a channel's member list, and its status flags. The pointer is
+// only safe to use for members, who are removed from the list when they leave.
+// Clients that are only invited can disconnect while on the list, which the
+// handle tells.
+struct Member
+{
+	Client* client;
+	ClientHandle handle;
+	uint8_t flags;
+
+	const char* getPrefix() const;
+};
+
+/**
+ * The set of clients that are joined to (or invited to) a channel, with status
+ * flags for each one. Entries are kept in one contiguous array, with channel
+ * members first and clients that are only invited after them, so iterating the
+ * members touches nothing else. An open-addressed hash table maps client
+ * handles to their positions in the array, so lookups and removals take
+ * constant time. Invited clients that disconnected are left on the list until
+ * it would have to grow, and are removed then.
+ */
+class MemberList
+{
+public:
+	// Iterator over the members, yielding a Client* for each one.
+	struct Iterator
+	{
+		const Member* entry;
+		Client* operator*() const { return entry->client; }
+		Iterator& operator++() { ++entry; return *this; }
+		bool operator==(const Iterator& other) const = default;
+	};
+
+	Iterator begin() const;
+	Iterator end() const;
+	std::span<const Member> allMembers() const;
+	std::span<const Member> allEntries() const;
+
+	bool isMember(const Client* client) const;
+	void addMember(Client* client);
+	void removeMember(Client* client);
+	size_t getMemberCount() const;
+
+	uint8_t getFlags(const Client* client) const;
+	bool setFlags(const Client* client, uint8_t flags);
+	void clearFlags(const Client* client, uint8_t flags);
+	void clearFlagsForAll(uint8_t flags);
+
+	void addInvited(Client* client);
+	void removeInvited(Client* client);
+	void clearInvited();
+
+private:
+	static constexpr uint32_t EMPTY = UINT32_MAX;
+
+	static size_t hash(ClientHandle handle);
+	size_t findSlot(ClientHandle handle) const;
+	size_t findEntry(const Client* client) const;
+	size_t addEntry(Client* client);
+	void removeEntry(size_t index);
+	void removeDisconnected();
+	void swapEntries(size_t a, size_t b);
+	void rehash(size_t capacity);
+
+	std::vector<Member> entries;	// Members first, then invited non-members
+	std::vector<uint32_t> slots;	// Hash table of indexes into entries
+	size_t memberCount = 0;			// Number of entries that are members
+};
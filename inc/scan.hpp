@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/**
+ * Where the messages in a receive buffer end, and where their parts are split,
+ * as found by scanDelimiters. Offsets are from the start of the buffer, in
+ * increasing order.
+ */
+struct Delimiters
+{
+	std::span<const uint32_t> lineEnds;		// Offset of the '\r' of each "\r\n"
+	std::span<const uint32_t> spaces;		// Offset of each ' '
+	std::vector<uint32_t> storage;			// Room for both lists, kept for the next scan
+};
+
+void scanDelimiters(std::string_view buffer, Delimiters& delimiters);
+int splitMessage(char* buffer, size_t begin, size_t end, std::span<const uint32_t> spaces,
+	char** argv, char*& prefix);
+bool isScanKernelSupported(std::string_view name);
+void selectScanKernel(std::string_view name);
+const char* getScanKernelName();
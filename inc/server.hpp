@@ -1,11 +1,23 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
+
+#include "bufferpool.hpp"
+#include "config.hpp"
+#include "fanout.hpp"
+#include "filter.hpp"
+#include "journal.hpp"
+#include "timerwheel.hpp"
 
 class Channel;
 class Client;
+class Service;
 
 struct ClientIterators
 {
@@ -14,6 +26,14 @@ struct ClientIterators
 	auto end() { return last; }
 };
 
+struct Listener
+{
+	std::string address;	// Address as given in the configuration
+	std::string profile;	// Name of the socket profile for accepted connections
+	int fd;					// The listening socket
+	bool warned = false;	// Whether the profile was already reported as not fully applied
+};
+
 struct ChannelIterators
 {
 	std::map<std::string, Channel>::iterator first, last;
@@ -29,29 +49,89 @@ public:
 
 	Channel* findChannelByName(std::string_view name);
 	Client* findClientByName(std::string_view name);
+	void updateNick(Client& client, std::string_view newNick);
+	void findClientsByMask(std::string_view pattern, std::vector<Client*>& result, size_t limit);
 	Channel* newChannel(const std::string& name);
 	Client& newClient(int fd, std::string_view host);
-	void eventLoop(const char* port);
+	void eventLoop();
+	void requestRehash();
+	bool handOver();
+	void resume(int socket);
+	void loadChannels();
 	bool correctPassword(std::string_view pass);
+	bool correctLinkPassword(std::string_view pass);
+	bool isLinkAllowed(std::string_view name, std::string_view host);
 	bool clientsOnSameChannel(const Client& a, const Client& b);
 	void disconnectClient(Client& client, std::string_view reason = "");
+	void forEachNeighbour(Client& client, const std::function<void(Client&)>& function);
 	std::string getLaunchTime();
-	static std::string getTimeString();
 	size_t getClientCount() const;
 	size_t getChannelCount() const;
 	ClientIterators allClients() { return {clients.begin(), clients.end()}; }
 	ChannelIterators allChannels() { return {channels.begin(), channels.end()}; }
 	std::string_view getHostname();
+	TimerWheel& getTimers();
+	BufferPool& getBufferPool();
+
+	void connectLink();
+	void registerLink(Client& link, std::string_view name);
+	bool addRemoteServer(std::string_view name, Client& link);
+	bool removeRemoteServer(std::string_view name, Client& link);
+	Client& newRemoteClient(Client& link, std::string_view nick, std::string_view user,
+		std::string_view host, std::string_view realname);
+	void killClient(Client& target, std::string_view reason, const Client* from);
+	void sendChannelState(Client& link, Channel& channel);
+	void propagateChannelState(Channel& channel);
+	void propagate(std::string_view line, const Client* except);
+	void propagateToChannel(Channel& channel, std::string_view line, const Client* except);
+	void sendToMembers(Channel& channel, std::string_view line, const Client* except);
+	void noticeOperators(std::string_view text);
+	void notifyServices(Channel& channel, Client& from, std::string_view text);
+	bool filterMessage(Client& sender, std::string_view command, std::string_view targets, std::string& text);
+	const FilterPipeline& getFilters() const;
+	size_t getServerCount() const;
+	size_t getLinkCount() const;
+	size_t getRemoteClientCount() const;
 
 private:
-	int createListenSocket(const char* port);
+	int createListenSocket(const std::string& address, const SocketProfile& profile);
+	void openListeners();
+	void openServices();
+	void acceptClient(Listener& listener);
+	void setBusyPoll();
+	void rehash();
+	void compactJournal(bool force);
+	void trimBuffers();
+	void watchSocket(int fd);
+	void sendLinkCredentials(Client& link);
+	void sendBurst(Client& link);
+	void removeLink(Client& link, std::string_view reason);
 
-	int serverFd = -1;
+	std::vector<Listener> listeners;				// Sockets accepting new connections
 	int epollFd = -1;
+	bool handedOver = false;
+	bool rehashPending = false;						// Whether REHASH was used during this iteration
 	std::string launchTime;
 	std::string port;
 	std::string password;
 	std::string hostname;
+	BufferPool buffers;								// I/O buffers for clients (outlives them)
+	Timer bufferTimer;								// Timer for freeing unused I/O buffers
 	std::map<int, Client> clients;
-	std::map<std::string, Channel> channels;
+	std::vector<std::unique_ptr<Service>> services;	// In-process pseudo-clients (see Service)
+	std::map<std::string, Channel> channels;		// Channels by casefolded name
+	std::map<std::string, Client*> nicks;		// Clients by casefolded nickname
+	std::multimap<std::string, Client*> hosts;	// Clients by casefolded host
+	TimerWheel timers;								// Timers for client timeouts
+	FanOut fanout;									// Threads for delivering messages to large channels
+	FilterPipeline filters;							// Filters for messages from local users
+	Journal journal;								// Channel state saved on disk
+	Timer compactionTimer;							// Timer for checking if the journal should be compacted
+	std::string linkTarget;							// Address of the server to link to ("host:port"), if any
+	Timer linkTimer;								// Timer for retrying the outgoing server link
+	std::vector<Client*> links;						// Registered links to directly connected servers
+	std::map<std::string, Client*> servers;			// All other servers, and the link they're reached through
+	int nextRemoteKey = -1;							// Key for the next remote user in `clients` (negative, since there's no socket)
+	size_t remoteClientCount = 0;					// Number of users on other servers
+	uint64_t neighbourEpoch = 0;					// Visit mark for the current neighbour fan-out
 };
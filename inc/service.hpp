@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+class Channel;
+class Client;
+class Server;
+
+/**
+ * A module that runs inside the server as a pseudo-client. It's a registered
+ * user like any other, so it joins channels, shows up in NAMES and WHO, and
+ * is introduced to other servers, but it has no connection. Instead of being
+ * sent lines of text, it's called directly with the parsed parts of the
+ * messages it's interested in. Services are started from the "service" lines
+ * of the configuration file.
+ */
+class Service
+{
+public:
+	Service(Server& server, std::string_view type);
+	virtual ~Service() = default;
+	Service(const Service&) = delete;
+	Service& operator=(const Service&) = delete;
+
+	static std::unique_ptr<Service> create(Server& server, std::string_view type);
+	static bool isKnownType(std::string_view type);
+
+	void attach(Client& newClient);
+	Client& getClient() const;
+	const std::string& getType() const;
+
+	// Called when the configuration is reloaded.
+	virtual void reload() {}
+
+	// Called when the service is invited to a channel. By default, the service
+	// joins the channel.
+	virtual void onInvite(Client& from, Channel& channel);
+
+	// Called for each message sent to a channel the service is on.
+	virtual void onChannelMessage(Client& from, Channel& channel, std::string_view text);
+
+	// Called for each private message sent to the service.
+	virtual void onPrivateMessage(Client& from, std::string_view text);
+
+protected:
+	void join(std::string_view channel);
+	void sendMessage(std::string_view target, std::string_view text);
+
+	Server& server;
+	Client* client = nullptr;	// The service's pseudo-client
+	std::string type;			// Name of the service's type in the configuration
+};
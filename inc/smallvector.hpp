@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * A vector that keeps up to InlineCapacity elements inside the object itself,
+ * and only moves them to the heap once it grows beyond that. Meant for small
+ * lists of pointers, so only trivially copyable element types are allowed.
+ */
+template <typename Type, size_t InlineCapacity>
+class SmallVector
+{
+	static_assert(std::is_trivially_copyable_v<Type>);
+
+public:
+	SmallVector() = default;
+
+	SmallVector(const SmallVector& other)
+	{
+		*this = other;
+	}
+
+	SmallVector& operator=(const SmallVector& other)
+	{
+		if (this != &other) {
+			clear();
+			reserve(other.count);
+			std::copy(other.begin(), other.end(), begin());
+			count = other.count;
+		}
+		return *this;
+	}
+
+	~SmallVector()
+	{
+		if (isOnHeap())
+			delete[] heap;
+	}
+
+	Type* begin() { return isOnHeap() ? heap : local; }
+	Type* end() { return begin() + count; }
+	const Type* begin() const { return isOnHeap() ? heap : local; }
+	const Type* end() const { return begin() + count; }
+	Type& front() { return *begin(); }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	void push_back(Type value)
+	{
+		if (count == capacity)
+			reserve(capacity * 2);
+		begin()[count++] = value;
+	}
+
+	// Remove every element equal to value, keeping the others in order.
+	void remove(const Type& value)
+	{
+		count = std::remove(begin(), end(), value) - begin();
+	}
+
+	// Remove all elements, and give back any heap storage.
+	void clear()
+	{
+		if (isOnHeap())
+			delete[] heap;
+		count = 0;
+		capacity = InlineCapacity;
+	}
+
+private:
+	bool isOnHeap() const { return capacity > InlineCapacity; }
+
+	void reserve(size_t newCapacity)
+	{
+		if (newCapacity <= capacity)
+			return;
+		Type* storage = new Type[newCapacity];
+		std::copy(begin(), end(), storage);
+		if (isOnHeap())
+			delete[] heap;
+		heap = storage;
+		capacity = newCapacity;
+	}
+
+	uint32_t count = 0;					// Number of elements
+	uint32_t capacity = InlineCapacity;	// Number of elements that fit without growing
+	union {
+		Type local[InlineCapacity];		// Storage while the elements fit inline
+		Type* heap;						// Storage once they don't
+	};
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Writes server state into a flat binary buffer, as a sequence of fixed-size
+ * integers and length-prefixed strings.
+ */
+class StateWriter
+{
+public:
+	void writeInt(int64_t value);
+	void writeString(std::string_view string);
+	const std::string& getData() const;
+	void clear();
+
+private:
+	std::string data;	// The serialized state
+};
+
+/**
+ * Reads back server state written by a StateWriter. Reading past the end of
+ * the data is treated as a failure.
+ */
+class StateReader
+{
+public:
+	explicit StateReader(std::string_view data);
+
+	int64_t readInt();
+	std::string_view readString();
+	bool isAtEnd() const;
+	size_t getOffset() const;
+
+private:
+	std::string_view data;	// The serialized state
+	size_t offset = 0;		// Current read position
+};
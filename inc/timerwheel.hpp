@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+class TimerWheel;
+
+/**
+ * A timer that can be scheduled on a TimerWheel. Timers are intrusive list
+ * nodes, so scheduling and cancelling them never allocates. A copied timer is
+ * never scheduled, and doesn't keep the callback (which usually refers to the
+ * object that owns the original timer).
+ */
+class Timer
+{
+public:
+	Timer() = default;
+	Timer(const Timer& other);
+	Timer& operator=(const Timer& other);
+	~Timer();
+
+	bool isScheduled() const;
+	void cancel();
+	int64_t getExpiry() const;
+
+	std::function<void()> callback;	// Called when the timer expires
+
+private:
+	friend class TimerWheel;
+
+	Timer* prev = nullptr;	// Previous timer in the same list
+	Timer* next = nullptr;	// Next timer in the same list
+	int64_t expiry = 0;		// Expiry time, in Unix milliseconds
+	size_t* count = nullptr;	// Counter of scheduled timers to update when unlinked
+};
+
+/**
+ * A hashed timing wheel. Time is divided into ticks, and each timer is kept in
+ * the slot for the tick it expires on (modulo the number of slots), so adding
+ * and removing a timer are constant time no matter how many timers there are.
+ * Timers further away than one revolution of the wheel simply stay in their
+ * slot until the wheel comes around to the right revolution.
+ */
+class TimerWheel
+{
+public:
+	TimerWheel();
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+	~TimerWheel();
+
+	void schedule(Timer& timer, int64_t expiry);
+	void advance(int64_t now);
+	int getTimeout(int64_t now) const;
+	size_t getTimerCount() const;
+
+private:
+	static constexpr int64_t TICK = 1000;	// Milliseconds per tick
+	static constexpr size_t SLOTS = 512;	// Number of slots in the wheel
+
+	static void link(Timer& head, Timer& timer);
+
+	Timer slots[SLOTS];		// Sentinel list heads for each slot
+	int64_t lastTick = -1;	// The last tick that was processed
+	size_t count = 0;		// The number of scheduled timers
+};
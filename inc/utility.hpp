@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cstdint>
 #include <stdexcept>
+#include <string>
 #include <string_view>
 
+#include "casemap.hpp"
 #include "log.hpp"
 
 // ANSI escape codes for nicer terminal output.
@@ -35,8 +38,17 @@
 		} \
 	} while (false)
 
+/**
+ * Convert a character to lowercase according to the server's casemapping.
+ */
+inline char foldChar(char c)
+{
+	return caseFoldTable[static_cast<unsigned char>(c)];
+}
+
 void safeClose(int& fd);
-bool matchIgnoreCase(const char* a, const char* b);
+std::string foldCase(std::string_view string);
 char* nextListItem(char*& list, const char* delimiter = ",");
 bool parseInt(const char* input, int& output);
+bool parseInt(const char* input, int64_t& output);
 bool isValidNameString(std::string_view string);
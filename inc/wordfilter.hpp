@@ -0,0 +1,20 @@
+#pragma once
+
+#include "service.hpp"
+#include "wordmatcher.hpp"
+
+/**
+ * A service that scolds users who say bad words on its channels. It's the
+ * in-process version of the bot, using the same word list (see bot_words).
+ */
+class WordFilterService : public Service
+{
+public:
+	explicit WordFilterService(Server& server);
+
+	void reload() override;
+	void onChannelMessage(Client& from, Channel& channel, std::string_view text) override;
+
+private:
+	WordMatcher words;	// Words to scold users for
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Finds any of a list of words in a text, ignoring case, in a single pass over
+ * the text no matter how many words there are. The words are compiled into an
+ * Aho-Corasick automaton, flattened into a table with one row per state and
+ * one column per character class, so each character costs one table lookup.
+ *
+ * A word only matches on its own, not as part of a longer word, unless it
+ * starts or ends with a '*', which lets it continue into other letters on that
+ * side. "foo" matches "a foo!" but not "food", "foo*" matches both, and
+ * "*foo*" matches anywhere.
+ */
+class WordMatcher
+{
+public:
+	bool load(const std::string& path);
+	void build(const std::vector<std::string>& words);
+	bool matches(std::string_view text) const;
+	size_t censor(std::string& text) const;
+	size_t getWordCount() const;
+	size_t getStateCount() const;
+
+private:
+	// A word, as stored in the automaton's output lists.
+	struct Word
+	{
+		uint32_t length;			// Number of characters in the word
+		bool wholeStart;			// Whether a word boundary is needed before the word
+		bool wholeEnd;				// Whether a word boundary is needed after the word
+		int32_t next = -1;			// Next word ending in the same state, or -1
+	};
+
+	uint8_t classes[256] = {};		// Character class of each byte (0 for bytes in no word)
+	size_t classCount = 1;			// Number of columns in the transition table
+	std::vector<int32_t> transitions;	// Next state for each state and character class
+	std::vector<int32_t> outputs;	// First word ending in each state, or -1
+	std::vector<Word> words;
+};
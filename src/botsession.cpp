@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/un.h>
+
+#include "bot.hpp"
+#include "botsession.hpp"
+#include "clock.hpp"
+#include "irc.hpp"
+#include "scan.hpp"
+#include "utility.hpp"
+
+// Bounds for the delay before reconnecting, in milliseconds. The delay doubles
+// with each failed attempt, from the minimum up to the maximum.
+static constexpr int64_t RECONNECT_MIN = 1000;
+static constexpr int64_t RECONNECT_MAX = 60000;
+
+BotSession::BotSession(Bot& bot, std::string_view name, uint32_t index)
+	: bot(bot)
+	, index(index)
+	, name(name)
+{
+}
+
+BotSession::~BotSession()
+{
+	safeClose(socket);
+}
+
+/**
+ * Open the connection to the server, and send the session's credentials. If
+ * the server can't be reached, another attempt is scheduled.
+ */
+void BotSession::connect(int epoll, const char* port, const char* password)
+{
+	socket = connectToServer(port);
+	if (socket == -1)
+		return disconnect("Failed to connect");
+
+	// Add the socket to the epoll list, keyed by the session's index.
+	struct epoll_event event;
+	event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+	event.data.u32 = index;
+	if (epoll_ctl(epoll, EPOLL_CTL_ADD, socket, &event) == -1)
+		fail("Failed to add socket to epoll: ", strerror(errno));
+
+	// Start by sending credentials to the server.
+	sendLine("PASS ", password);
+	sendLine("NICK ", name);
+	sendLine("USER ", name, " 0 * ", name);
+	log::info("Bot ", name, " connected to ", port);
+}
+
+/**
+ * Close the connection, and schedule the next attempt to open it, unless the
+ * session gave up. The delay is picked at random from the upper half of the
+ * current backoff range, so that sessions that lost their connections at the
+ * same time (when the server restarts, for example) don't all come back at
+ * once.
+ */
+void BotSession::disconnect(std::string_view reason)
+{
+	safeClose(socket);
+	disconnected = false;
+	input.clear();
+	output.clear();
+	if (stopped)
+		return;
+	int64_t delay = std::min(RECONNECT_MIN << std::min(failures, 16), RECONNECT_MAX);
+	delay = delay / 2 + std::rand() % (delay / 2 + 1);
+	failures++;
+	reconnectTime = Clock::getMilliseconds() + delay;
+	log::warn("Bot ", name, ": ", reason, ", reconnecting in ", delay, " ms");
+}
+
+/**
+ * Handle an event on the session's socket.
+ */
+void BotSession::handleEvent()
+{
+	send();
+	receive();
+	if (disconnected)
+		disconnect("Connection lost");
+}
+
+/**
+ * Check if the session currently has a connection to the server.
+ */
+bool BotSession::isConnected() const
+{
+	return socket != -1;
+}
+
+/**
+ * Check if the session gave up on connecting, which happens when its
+ * credentials are rejected.
+ */
+bool BotSession::isStopped() const
+{
+	return stopped;
+}
+
+/**
+ * Get the time of the next connection attempt, in milliseconds.
+ */
+int64_t BotSession::getReconnectTime() const
+{
+	return reconnectTime;
+}
+
+/**
+ * Get the session's nickname.
+ */
+const std::string& BotSession::getName() const
+{
+	return name;
+}
+
+/**
+ * Connect to a server on this machine, either through TCP on the given port,
+ * or through the Unix-domain socket at the given path, which skips the whole
+ * TCP stack. Anything with a slash in it is taken as a path. Returns the
+ * socket, or -1 if the connection couldn't be opened.
+ */
+int BotSession::connectToServer(const char* port)
+{
+	int fd = -1;
+	if (std::strchr(port, '/') != nullptr) {
+		struct sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (std::strlen(port) >= sizeof(address.sun_path))
+			fail("Socket path is too long: ", port);
+		std::strcpy(address.sun_path, port);
+		fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd == -1)
+			fail("socket() failed: ", strerror(errno));
+		if (::connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == -1) {
+			log::warn("Bot ", name, ": connect failed: ", strerror(errno));
+			safeClose(fd);
+		}
+		return fd;
+	}
+
+	// Get address info for the socket.
+	struct addrinfo *ai = nullptr;
+	struct addrinfo hints = {};
+	hints.ai_family   = AF_INET;		// IPv4 only (not IPv6).
+	hints.ai_socktype = SOCK_STREAM;	// TCP only (not UDP).
+	int status = getaddrinfo(nullptr, port, &hints, &ai);
+	if (status != 0)
+		fail("getaddrinfo() failed: ", gai_strerror(status));
+
+	// Create the socket and connect to the server.
+	fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+	if (fd == -1) {
+		freeaddrinfo(ai);
+		fail("socket() failed: ", strerror(errno));
+	}
+	if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+		log::warn("Bot ", name, ": connect failed: ", strerror(errno));
+		safeClose(fd);
+	}
+	freeaddrinfo(ai);
+	return fd;
+}
+
+void BotSession::send(const std::string_view& string)
+{
+	output.append(string);
+	ssize_t bytes = 1;
+	const int sendFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
+	while (bytes > 0 && socket != -1 && output.find("\r\n") != output.npos) {
+		bytes = ::send(socket, output.data(), output.size(), sendFlags);
+		if (bytes == -1) {
+			if (errno == ECONNRESET || errno == EPIPE)
+				disconnected = true;
+			if (errno == EAGAIN || errno == ECONNRESET || errno == EPIPE)
+				break;
+			fail("Failed to send to server: ", strerror(errno));
+		}
+		output.erase(0, bytes);
+	}
+}
+
+void BotSession::receive()
+{
+	// Receive data from the server.
+	char buffer[512];
+	ssize_t bytes = 1;
+	while (bytes > 0 && !disconnected) {
+		bytes = recv(socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+		// Handle errors.
+		if (bytes == -1) {
+			if (errno == ECONNRESET)
+				disconnected = true;
+			if (errno == EAGAIN || errno == ECONNRESET)
+				break;
+			fail("Failed to receive from server: ", strerror(errno));
+
+		// Handle the server closing the connection.
+		} else if (bytes == 0) {
+			disconnected = true;
+			break;
+
+		// Buffer received data.
+		} else {
+			input.append(buffer, bytes);
+
+			// Find all complete messages, and the spaces between their parts,
+			// in one pass over the buffer.
+			static Delimiters delimiters;
+			scanDelimiters(input, delimiters);
+			size_t begin = 0;
+			for (uint32_t end: delimiters.lineEnds) {
+				if (disconnected)
+					break;
+				parseMessage(begin, end, delimiters.spaces);
+				begin = end + 2;
+			}
+			input.erase(0, begin);
+		}
+	}
+}
+
+void BotSession::parseMessage(size_t begin, size_t end, std::span<const uint32_t> spaces)
+{
+	// Split the message in place. The source prefix isn't needed.
+	char* argv[MAX_MESSAGE_PARTS];
+	char* prefix;
+	int argc = splitMessage(input.data(), begin, end, spaces, argv, prefix);
+	if (argc == -1)
+		return log::warn("Message has too many parts: ", argv[0]);
+	handleMessage(argc, argv);
+}
+
+void BotSession::handleMessage(int argc, char** argv)
+{
+	// Ignore empty commands.
+	if (argc == 0)
+		return;
+	char* command = argv[0];
+
+	// Reconnect if ERROR is received, which the server sends before closing
+	// the connection.
+	if (std::strcmp(command, "ERROR") == 0) {
+		disconnected = true;
+		return;
+	}
+
+	// Try again later if 433 (nick already in use) is received, since the
+	// nickname may still be held by the previous connection.
+	if (std::strcmp(command, "433") == 0) {
+		log::warn("Bot ", name, ": Nickname already in use");
+		disconnected = true;
+		return;
+	}
+
+	// Give up if 464 (password is incorrect) is received.
+	if (std::strcmp(command, "464") == 0) {
+		log::error("Bot ", name, ": Password is incorrect");
+		disconnected = true;
+		stopped = true;
+		return;
+	}
+
+	// Once registered, the connection counts as successful. Rejoin the
+	// channels the session was in before reconnecting.
+	if (std::strcmp(command, "001") == 0) {
+		failures = 0;
+		for (const std::string& channel: channels)
+			sendLine("JOIN ", channel);
+	}
+
+	// Answer keepalive pings from the server.
+	if (argc == 2 && std::strcmp(command, "PING") == 0)
+		sendLine("PONG :", argv[1]);
+
+	// Join any channels the bot is invited to.
+	if (argc == 3 && std::strcmp(command, "INVITE") == 0) {
+		channels.insert(argv[2]);
+		sendLine("JOIN ", argv[2]);
+	}
+
+	// Leave any channels the bot is kicked from.
+	if (argc == 4 && std::strcmp(command, "KICK") == 0) {
+		if (argv[2] == name) {
+			channels.erase(argv[1]);
+			log::warn("Bot ", name, ": Kicked from ", argv[1]);
+		}
+	}
+
+	// React to private messages.
+	if (argc == 3 && std::strcmp(command, "PRIVMSG") == 0) {
+		char* channel = argv[1];
+		char* message = argv[2];
+
+		// Scold the sender if it's in a channel the bot is joined to, and has
+		// any of the bad words in it.
+		if (channels.contains(channel) && bot.getWords().matches(message))
+			sendLine("PRIVMSG ", channel, " :NO, BAD WORD!");
+	}
+}
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <malloc.h>
+
+#include "bufferpool.hpp"
+#include "config.hpp"
+
+/**
+ * Check if a string holds a buffer from the pool. Strings only get storage of
+ * their own when they borrow a buffer, so anything beyond the small inline
+ * storage of an empty string is a pooled buffer, even if the configured buffer
+ * size changed since it was borrowed.
+ */
+static bool hasBuffer(const std::string& buffer)
+{
+	return buffer.capacity() > std::string().capacity();
+}
+
+/**
+ * Give a buffer to a string, unless it already has one. A string without
+ * storage is always safe to pass to either function. Any contents of the
+ * string are kept.
+ */
+void BufferPool::acquire(std::string& buffer)
+{
+	if (hasBuffer(buffer))
+		return;
+	std::string storage;
+	{
+		std::lock_guard lock(mutex);
+		if (!buffers.empty()) {
+			storage.swap(buffers.back());
+			buffers.pop_back();
+			lowWater = std::min(lowWater, buffers.size());
+		}
+		peak = std::max(peak, ++inUse);
+	}
+	storage.reserve(Config::get().ioBufferSize);
+	storage.append(buffer);
+	buffer.swap(storage);
+}
+
+/**
+ * Take back the buffer of a string, leaving it empty and with no storage. The
+ * buffer is kept for reuse, unless it has grown too big or there are already
+ * io_pool_max_free unused buffers.
+ */
+void BufferPool::release(std::string& buffer)
+{
+	if (!hasBuffer(buffer))
+		return;
+	std::string storage;
+	storage.swap(buffer);
+	storage.clear();
+	std::lock_guard lock(mutex);
+	inUse--;
+	const Config& config = Config::get();
+	if (storage.capacity() <= config.ioBufferMaxSize && buffers.size() < config.ioPoolMaxFree)
+		buffers.push_back(std::move(storage));
+}
+
+/**
+ * Free the buffers that stayed unused since the last call, and hand the freed
+ * memory back to the operating system. Called every io_pool_trim_interval
+ * seconds, so that memory taken by a burst of traffic is given back once the
+ * server has been quiet for a while. Returns the number of buffers freed.
+ */
+size_t BufferPool::trim()
+{
+	size_t excess;
+	{
+		std::lock_guard lock(mutex);
+		excess = lowWater;
+		buffers.resize(buffers.size() - excess);
+		lowWater = buffers.size();
+	}
+	if (excess > 0)
+		malloc_trim(0);
+	return excess;
+}
+
+/**
+ * Get the number of buffers that are currently borrowed.
+ */
+size_t BufferPool::getInUseCount()
+{
+	std::lock_guard lock(mutex);
+	return inUse;
+}
+
+/**
+ * Get the highest number of buffers that were borrowed at the same time.
+ */
+size_t BufferPool::getPeakCount()
+{
+	std::lock_guard lock(mutex);
+	return peak;
+}
+
+/**
+ * Get the number of unused buffers kept for reuse.
+ */
+size_t BufferPool::getFreeCount()
+{
+	std::lock_guard lock(mutex);
+	return buffers.size();
+}
@@ -0,0 +1,191 @@
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "casemap.hpp"
+#include "utility.hpp"
+
+// The casemappings the server can use. In both, the uppercase characters are
+// a range starting at 'A', and each folds to the character 0x20 above it. For
+// rfc1459, the range also covers "[\]^", which fold to "{|}~".
+static const struct {
+	const char* name;
+	char last;
+} casemappings[] = {
+	{"ascii", 'Z'},
+	{"rfc1459", '^'},
+};
+
+/**
+ * Make the table for folding characters to lowercase, where the uppercase
+ * characters run from 'A' to `last`.
+ */
+static constexpr std::array<char, 256> makeFoldTable(char last)
+{
+	std::array<char, 256> table = {};
+	for (int c = 0; c < 256; c++)
+		table[c] = static_cast<char>(c >= 'A' && c <= last ? c + 0x20 : c);
+	return table;
+}
+
+// The casemapping in effect, and its table for foldChar.
+static const char* casemapping = "ascii";
+static char upperLast = 'Z';
+constinit std::array<char, 256> caseFoldTable = makeFoldTable('Z');
+
+/**
+ * Check whether a casemapping is one the server knows ("ascii" or "rfc1459").
+ */
+bool isKnownCasemapping(std::string_view name)
+{
+	for (const auto& known: casemappings)
+		if (name == known.name)
+			return true;
+	return false;
+}
+
+/**
+ * Choose the casemapping for comparing names. Since names are indexed by their
+ * folded forms, this must be done before any are added. Unknown casemappings
+ * are ignored.
+ */
+void setCasemapping(std::string_view name)
+{
+	for (const auto& known: casemappings) {
+		if (name == known.name) {
+			casemapping = known.name;
+			upperLast = known.last;
+			caseFoldTable = makeFoldTable(known.last);
+		}
+	}
+}
+
+/**
+ * Get the name of the casemapping in effect, as advertised in RPL_ISUPPORT.
+ */
+const char* getCasemapping()
+{
+	return casemapping;
+}
+
+/**
+ * Fold the uppercase characters in 8 bytes to lowercase at once. Bytes below
+ * 0x80 are uppercase if adding 0x80 - 'A' carries into their high bit, and
+ * adding 0x7f - upperLast doesn't. Neither sum can carry into the next byte.
+ * Since no uppercase character has the 0x20 bit set, folding just sets it.
+ */
+static inline uint64_t foldWord(uint64_t word)
+{
+	const uint64_t ones = 0x0101010101010101;
+	const uint64_t high = ones * 0x80;
+	uint64_t low = word & ~high;
+	uint64_t fromFirst = low + ones * (0x80 - 'A');
+	uint64_t pastLast = low + ones * (0x7f - upperLast);
+	uint64_t isUpper = fromFirst & ~pastLast & ~word & high;
+	return word | isUpper >> 2;
+}
+
+#ifdef __SSE2__
+/**
+ * Fold the uppercase characters in 16 bytes to lowercase at once. Subtracting
+ * 'A' moves the uppercase range to the lowest values, so it can be checked
+ * with one unsigned comparison.
+ */
+static inline __m128i foldBlock(__m128i bytes)
+{
+	__m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8('A'));
+	__m128i span = _mm_set1_epi8(upperLast - 'A');
+	__m128i isUpper = _mm_cmpeq_epi8(_mm_min_epu8(offset, span), offset);
+	return _mm_or_si128(bytes, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+/**
+ * Fold a string to lowercase in place, according to the server's casemapping.
+ * Works on 16 bytes at a time with SSE2, then 8 at a time within a register,
+ * then one at a time for the rest.
+ */
+void foldCaseInPlace(char* data, size_t length)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	for (; i + 16 <= length; i += 16) {
+		__m128i* block = reinterpret_cast<__m128i*>(data + i);
+		_mm_storeu_si128(block, foldBlock(_mm_loadu_si128(block)));
+	}
+#endif
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, data + i, 8);
+		word = foldWord(word);
+		std::memcpy(data + i, &word, 8);
+	}
+	for (; i < length; i++)
+		data[i] = foldChar(data[i]);
+}
+
+/**
+ * Check if two strings are equal when folded according to the server's
+ * casemapping, folding and comparing them a block at a time like
+ * foldCaseInPlace.
+ */
+bool equalsIgnoreCase(std::string_view a, std::string_view b)
+{
+	if (a.length() != b.length())
+		return false;
+	size_t i = 0;
+#ifdef __SSE2__
+	for (; i + 16 <= a.length(); i += 16) {
+		__m128i blockA = foldBlock(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i)));
+		__m128i blockB = foldBlock(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + i)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(blockA, blockB)) != 0xffff)
+			return false;
+	}
+#endif
+	for (; i + 8 <= a.length(); i += 8) {
+		uint64_t wordA, wordB;
+		std::memcpy(&wordA, a.data() + i, 8);
+		std::memcpy(&wordB, b.data() + i, 8);
+		if (wordA != wordB && foldWord(wordA) != foldWord(wordB))
+			return false;
+	}
+	for (; i < a.length(); i++)
+		if (foldChar(a[i]) != foldChar(b[i]))
+			return false;
+	return true;
+}
+
+/**
+ * Check if every byte of a string belongs to a character class. With SSE2, 16
+ * bytes at a time are checked against the class's range and each of its
+ * excluded bytes.
+ */
+bool isInCharClass(std::string_view string, const CharClass& chars)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	if (string.length() >= 16) {
+		assert(chars.excluded.length() <= 8);
+		__m128i lowest = _mm_set1_epi8(chars.lowest);
+		__m128i span = _mm_set1_epi8(chars.highest - chars.lowest);
+		__m128i excluded[8];
+		for (size_t j = 0; j < chars.excluded.length(); j++)
+			excluded[j] = _mm_set1_epi8(chars.excluded[j]);
+		for (; i + 16 <= string.length(); i += 16) {
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(string.data() + i));
+			__m128i offset = _mm_sub_epi8(bytes, lowest);
+			__m128i allowed = _mm_cmpeq_epi8(_mm_min_epu8(offset, span), offset);
+			for (size_t j = 0; j < chars.excluded.length(); j++)
+				allowed = _mm_andnot_si128(_mm_cmpeq_epi8(bytes, excluded[j]), allowed);
+			if (_mm_movemask_epi8(allowed) != 0xffff)
+				return false;
+		}
+	}
+#endif
+	for (; i < string.length(); i++)
+		if (!chars.contains(string[i]))
+			return false;
+	return true;
+}
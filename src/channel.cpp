@@ -1,16 +1,22 @@
-#include <ctime>
+#include <algorithm>
+#include <utility>
 
 #include "channel.hpp"
 #include "client.hpp"
+#include "clock.hpp"
+#include "config.hpp"
 #include "irc.hpp"
 #include "utility.hpp"
 
 /**
- * Make a new channel.
+ * Make a new channel. If a journal is given, any changes to the channel's
+ * modes, topic and lists are recorded there.
  */
-Channel::Channel(std::string_view name)
+Channel::Channel(std::string_view name, Journal* journal)
 	: name(name),
-	  creationTime(time(nullptr))
+	  creationTime(Clock::getUnixTime()),
+	  history(name),
+	  journal(journal)
 {
 }
 
@@ -19,7 +25,7 @@ Channel::Channel(std::string_view name)
  */
 bool Channel::isMember(Client& client) const
 {
-	return members.find(&client) != members.end();
+	return members.isMember(&client);
 }
 
 /**
@@ -27,18 +33,40 @@ bool Channel::isMember(Client& client) const
  */
 void Channel::addMember(Client& client)
 {
-	members.insert(&client);
+	members.addMember(&client);
+	nicks[foldCase(client.getNick())] = &client;
+	dormant = false;
+
+	// Count members on other servers by the link they're reached through.
+	if (Client* link = client.getLink()) {
+		auto found = std::find_if(links.begin(), links.end(), [&] (ChannelLink& entry) {
+			return entry.link == link;
+		});
+		if (found == links.end())
+			links.push_back({link, 1});
+		else
+			found->members++;
+	}
 }
 
 /**
- * Remove a client from a channel. The client is also removed from the operator
- * and invite lists, if applicable.
+ * Remove a client from a channel. The client's status flags are forgotten, and
+ * they are also removed from the invite list, if applicable.
  */
 void Channel::removeMember(Client& client)
 {
-	members.erase(&client);
-	operators.erase(&client);
-	invited.erase(&client);
+	if (!members.isMember(&client))
+		return members.removeMember(&client);
+	members.removeMember(&client);
+	nicks.erase(foldCase(client.getNick()));
+	if (Client* link = client.getLink()) {
+		for (auto i = links.begin(); i != links.end(); ++i) {
+			if (i->link == link && --i->members == 0) {
+				links.erase(i);
+				break;
+			}
+		}
+	}
 }
 
 /**
@@ -46,7 +74,7 @@ void Channel::removeMember(Client& client)
  */
 bool Channel::isOperator(Client& client) const
 {
-	return operators.find(&client) != operators.end();
+	return members.getFlags(&client) & MEMBER_OPERATOR;
 }
 
 /**
@@ -55,7 +83,7 @@ bool Channel::isOperator(Client& client) const
  */
 void Channel::addOperator(Client& client)
 {
-	operators.insert(&client);
+	members.setFlags(&client, MEMBER_OPERATOR);
 }
 
 /**
@@ -63,7 +91,31 @@ void Channel::addOperator(Client& client)
  */
 void Channel::removeOperator(Client& client)
 {
-	operators.erase(&client);
+	members.clearFlags(&client, MEMBER_OPERATOR);
+}
+
+/**
+ * Check if a client has voice on this channel.
+ */
+bool Channel::isVoiced(Client& client) const
+{
+	return members.getFlags(&client) & MEMBER_VOICE;
+}
+
+/**
+ * Give a channel member voice.
+ */
+void Channel::addVoice(Client& client)
+{
+	members.setFlags(&client, MEMBER_VOICE);
+}
+
+/**
+ * Take voice from a channel member.
+ */
+void Channel::removeVoice(Client& client)
+{
+	members.clearFlags(&client, MEMBER_VOICE);
 }
 
 /**
@@ -72,9 +124,9 @@ void Channel::removeOperator(Client& client)
 bool Channel::isValidName(std::string_view name)
 {
 	return !name.empty()
-		&& name.length() <= CHANNELLEN
+		&& name.length() <= Config::get().channelLength
 		&& name[0] == '#'
-		&& isValidNameString(&name[1]);
+		&& isValidNameString(name.substr(1));
 }
 
 /**
@@ -83,10 +135,102 @@ bool Channel::isValidName(std::string_view name)
  */
 Client* Channel::findClientByName(std::string_view nick)
 {
-	for (Client* client: members)
-		if (client->getNick() == nick)
-			return client;
-	return nullptr;
+	auto found = nicks.find(foldCase(nick));
+	return found != nicks.end() ? found->second : nullptr;
+}
+
+/**
+ * Update the nick index when a member changes their nickname. Must be called
+ * before the client's nickname is actually changed. The member's cached ban
+ * status is also forgotten, since it depends on the nickname.
+ */
+void Channel::renameMember(Client& client, std::string_view newNick)
+{
+	if (!isMember(client))
+		return;
+	nicks.erase(foldCase(client.getNick()));
+	nicks[foldCase(newNick)] = &client;
+	forgetBanStatus(client);
+}
+
+/**
+ * Add a mask to the ban list (mode 'b') or the ban exception list (mode 'e').
+ * Returns false if the mask is already on the list, or the list is full.
+ */
+bool Channel::addListMask(char mode, std::string_view mask, std::string_view setBy)
+{
+	MaskSet& masks = mode == 'b' ? bans : exceptions;
+	std::vector<ListEntry>& list = mode == 'b' ? banList : exceptionList;
+	if (masks.size() >= Config::get().maxList || !masks.add(mask))
+		return false;
+	list.push_back({std::string(mask), std::string(setBy), Clock::getUnixTime()});
+	members.clearFlagsForAll(MEMBER_BANCHECKED);
+	if (journal != nullptr)
+		journal->record(JOURNAL_ADD_MASK, name, mode, mask, setBy, list.back().setAt);
+	return true;
+}
+
+/**
+ * Remove a mask from the ban or ban exception list. Returns false if the mask
+ * wasn't on the list.
+ */
+bool Channel::removeListMask(char mode, std::string_view mask)
+{
+	MaskSet& masks = mode == 'b' ? bans : exceptions;
+	std::vector<ListEntry>& list = mode == 'b' ? banList : exceptionList;
+	if (!masks.remove(mask))
+		return false;
+	std::string folded = foldCase(mask);
+	for (auto i = list.begin(); i != list.end(); ++i) {
+		if (foldCase(i->mask) == folded) {
+			list.erase(i);
+			break;
+		}
+	}
+	members.clearFlagsForAll(MEMBER_BANCHECKED);
+	if (journal != nullptr)
+		journal->record(JOURNAL_REMOVE_MASK, name, mode, mask);
+	return true;
+}
+
+/**
+ * Get the entries on the ban list (mode 'b') or the ban exception list (mode
+ * 'e'), in the order they were added.
+ */
+const std::vector<ListEntry>& Channel::getListMasks(char mode) const
+{
+	return mode == 'b' ? banList : exceptionList;
+}
+
+/**
+ * Check if a client matches a ban mask, without matching a ban exception mask.
+ * The result is cached for channel members until the ban lists change, or the
+ * member changes nickname, so that checking a member on every message is just
+ * a hash lookup.
+ */
+bool Channel::isBanned(Client& client)
+{
+	if (bans.isEmpty())
+		return false;
+	uint8_t flags = members.getFlags(&client);
+	if (flags & MEMBER_BANCHECKED)
+		return flags & MEMBER_BANNED;
+	std::string fullname = client.getFullName();
+	bool banned = bans.match(fullname) && !exceptions.match(fullname);
+	if (isMember(client)) {
+		members.clearFlags(&client, MEMBER_BANNED);
+		members.setFlags(&client, MEMBER_BANCHECKED | (banned ? MEMBER_BANNED : 0));
+	}
+	return banned;
+}
+
+/**
+ * Forget the cached ban status of a client, for example because their nickname
+ * changed.
+ */
+void Channel::forgetBanStatus(Client& client)
+{
+	members.clearFlags(&client, MEMBER_BANCHECKED);
 }
 
 /**
@@ -130,12 +274,11 @@ std::string_view Channel::getKey() const
  */
 bool Channel::setKey(std::string_view newKey)
 {
-	if (newKey.empty())
+	if (newKey.empty() || !isInCharClass(newKey, KEY_CHARS))
 		return false;
-	for (char c: newKey)
-		if (std::isspace(c))
-			return false;
 	key = newKey;
+	if (journal != nullptr)
+		journal->record(JOURNAL_KEY, name, key);
 	return true;
 }
 
@@ -145,6 +288,8 @@ bool Channel::setKey(std::string_view newKey)
 void Channel::removeKey()
 {
 	key.clear();
+	if (journal != nullptr)
+		journal->record(JOURNAL_KEY, name, key);
 }
 
 /**
@@ -155,6 +300,14 @@ MemberIterators Channel::allMembers()
 	return {members.begin(), members.end()};
 }
 
+/**
+ * Get all channel members along with their status flags.
+ */
+std::span<const Member> Channel::allMemberEntries() const
+{
+	return members.allMembers();
+}
+
 /**
  * Get the channel member limit.
  */
@@ -170,6 +323,8 @@ void Channel::setMemberLimit(int limit)
 {
 	assert(limit > 0);
 	memberLimit = limit;
+	if (journal != nullptr)
+		journal->record(JOURNAL_LIMIT, name, limit);
 }
 
 /**
@@ -186,6 +341,8 @@ bool Channel::isInviteOnly() const
 void Channel::setInviteOnly(bool enable)
 {
 	inviteOnly = enable;
+	if (journal != nullptr)
+		journal->record(JOURNAL_INVITE_ONLY, name, enable);
 }
 
 /**
@@ -193,7 +350,7 @@ void Channel::setInviteOnly(bool enable)
  */
 bool Channel::isInvited(Client& client) const
 {
-	return invited.contains(&client);
+	return members.getFlags(&client) & MEMBER_INVITED;
 }
 
 /**
@@ -201,7 +358,7 @@ bool Channel::isInvited(Client& client) const
  */
 void Channel::addInvited(Client& client)
 {
-	invited.insert(&client);
+	members.addInvited(&client);
 }
 
 /**
@@ -209,7 +366,7 @@ void Channel::addInvited(Client& client)
  */
 void Channel::removeInvited(Client& client)
 {
-	invited.erase(&client);
+	members.removeInvited(&client);
 }
 
 /**
@@ -217,7 +374,7 @@ void Channel::removeInvited(Client& client)
  */
 void Channel::resetInvited()
 {
-	invited.clear();
+	members.clearInvited();
 }
 
 /**
@@ -226,7 +383,7 @@ void Channel::resetInvited()
  */
 bool Channel::isFull() const
 {
-	return static_cast<int>(members.size()) >= memberLimit;
+	return static_cast<int>(members.getMemberCount()) >= memberLimit;
 }
 
 /**
@@ -235,7 +392,7 @@ bool Channel::isFull() const
  */
 bool Channel::isEmpty() const
 {
-	return members.empty();
+	return members.getMemberCount() == 0;
 }
 
 /**
@@ -243,7 +400,7 @@ bool Channel::isEmpty() const
  */
 int Channel::getMemberCount() const
 {
-	return static_cast<int>(members.size());
+	return static_cast<int>(members.getMemberCount());
 }
 
 /**
@@ -254,6 +411,14 @@ std::string_view Channel::getName() const
 	return name;
 }
 
+/**
+ * Get the channel's recent messages.
+ */
+History& Channel::getHistory()
+{
+	return history;
+}
+
 /**
  * Check if the channel currently has a topic.
  */
@@ -283,11 +448,22 @@ std::string_view Channel::getTopicChange() const
  */
 void Channel::setTopic(std::string_view newTopic, Client& client)
 {
-	topic = newTopic;
-	topicChangeStr = std::string(client.getNick()) + " " + Server::getTimeString();
+	setTopic(newTopic, client.getNick());
 	log::info(client.getNick(), " changed topic of ", name, " to: ", newTopic);
 }
 
+/**
+ * Set the current topic on behalf of a nickname that isn't necessarily a
+ * client on this server (for topics received from other servers).
+ */
+void Channel::setTopic(std::string_view newTopic, std::string_view setter)
+{
+	topic = newTopic;
+	topicChangeStr = std::string(setter) + " " + std::string(Clock::getAsctime());
+	if (journal != nullptr)
+		journal->record(JOURNAL_TOPIC, name, topic, topicChangeStr);
+}
+
 /**
  * Get whether or not the topic is restricted (meaning it can only be changed by
  * a channel operator).
@@ -303,6 +479,8 @@ bool Channel::isTopicRestricted() const
 void Channel::setTopicRestricted(bool enable)
 {
 	topicRestricted = enable;
+	if (journal != nullptr)
+		journal->record(JOURNAL_TOPIC_RESTRICTED, name, enable);
 }
 
 /**
@@ -312,3 +490,215 @@ int64_t Channel::getCreationTime() const
 {
 	return creationTime;
 }
+
+/**
+ * Change the channel's creation time. When servers link, the channel with the
+ * older creation time wins, so the time is shared across the network.
+ */
+void Channel::setCreationTime(int64_t time)
+{
+	creationTime = time;
+	if (journal != nullptr)
+		journal->record(JOURNAL_CREATE, name, creationTime);
+}
+
+/**
+ * Clear the channel's modes, topic, lists, and the status of every member.
+ * Used when the channel loses to an older channel of the same name on a server
+ * that's linking to this one.
+ */
+void Channel::resetModes()
+{
+	setInviteOnly(false);
+	setTopicRestricted(false);
+	removeKey();
+	setMemberLimit(INT_MAX);
+	for (char mode: {'b', 'e'})
+		while (!getListMasks(mode).empty())
+			removeListMask(mode, std::string(getListMasks(mode).back().mask));
+	if (hasTopic())
+		setTopic("", "");
+	members.clearFlagsForAll(MEMBER_OPERATOR | MEMBER_VOICE);
+}
+
+/**
+ * Get the server links that have members on this channel, which are the only
+ * links that channel messages need to be sent to.
+ */
+const std::vector<ChannelLink>& Channel::getLinks() const
+{
+	return links;
+}
+
+/**
+ * Check if the channel was restored from disk, and nobody has joined it since.
+ * Dormant channels are kept even though they're empty, so that their modes,
+ * topic and lists are still there when their members come back.
+ */
+bool Channel::isDormant() const
+{
+	return dormant;
+}
+
+/**
+ * Set whether the channel is dormant. Joining the channel always makes it
+ * active again.
+ */
+void Channel::setDormant(bool enable)
+{
+	dormant = enable;
+}
+
+/**
+ * Serialize the channel's persistent state (everything except its members)
+ * for the snapshot file.
+ */
+void Channel::saveSnapshot(StateWriter& out) const
+{
+	out.writeString(topic);
+	out.writeString(topicChangeStr);
+	out.writeString(key);
+	out.writeInt(creationTime);
+	out.writeInt(inviteOnly);
+	out.writeInt(topicRestricted);
+	out.writeInt(memberLimit);
+	for (const std::vector<ListEntry>* list: {&banList, &exceptionList}) {
+		out.writeInt(list->size());
+		for (const ListEntry& entry: *list) {
+			out.writeString(entry.mask);
+			out.writeString(entry.setBy);
+			out.writeInt(entry.setAt);
+		}
+	}
+}
+
+/**
+ * Restore the channel's persistent state from a snapshot. Nothing is recorded
+ * in the journal, since the state is already on disk.
+ */
+void Channel::restoreSnapshot(StateReader& in)
+{
+	Journal* savedJournal = std::exchange(journal, nullptr);
+	topic = in.readString();
+	topicChangeStr = in.readString();
+	key = in.readString();
+	creationTime = in.readInt();
+	inviteOnly = in.readInt();
+	topicRestricted = in.readInt();
+	memberLimit = in.readInt();
+	for (char mode: {'b', 'e'}) {
+		for (int64_t count = in.readInt(); count > 0; count--) {
+			std::string mask(in.readString());
+			std::string setBy(in.readString());
+			int64_t setAt = in.readInt();
+			if (addListMask(mode, mask, setBy))
+				(mode == 'b' ? banList : exceptionList).back().setAt = setAt;
+		}
+	}
+	journal = savedJournal;
+}
+
+/**
+ * Apply a record from the journal to the channel. The record's type and the
+ * channel name have already been read. Nothing is recorded in the journal
+ * while replaying it.
+ */
+void Channel::replay(JournalRecord type, StateReader& in)
+{
+	Journal* savedJournal = std::exchange(journal, nullptr);
+	switch (type) {
+	case JOURNAL_CREATE:
+		creationTime = in.readInt();
+		break;
+	case JOURNAL_TOPIC:
+		topic = in.readString();
+		topicChangeStr = in.readString();
+		break;
+	case JOURNAL_KEY:
+		key = in.readString();
+		break;
+	case JOURNAL_LIMIT:
+		memberLimit = in.readInt();
+		break;
+	case JOURNAL_INVITE_ONLY:
+		inviteOnly = in.readInt();
+		break;
+	case JOURNAL_TOPIC_RESTRICTED:
+		topicRestricted = in.readInt();
+		break;
+	case JOURNAL_ADD_MASK: {
+		char mode = in.readInt();
+		std::string mask(in.readString());
+		std::string setBy(in.readString());
+		int64_t setAt = in.readInt();
+		if (addListMask(mode, mask, setBy))
+			(mode == 'b' ? banList : exceptionList).back().setAt = setAt;
+		break;
+	}
+	case JOURNAL_REMOVE_MASK: {
+		char mode = in.readInt();
+		removeListMask(mode, in.readString());
+		break;
+	}
+	default:
+		journal = savedJournal;
+		fail("Unexpected journal record type ", static_cast<int64_t>(type));
+	}
+	journal = savedJournal;
+}
+
+/**
+ * Serialize the channel's state for handing it over to a new server process.
+ * Clients are referred to by their index in the list of saved clients.
+ */
+void Channel::saveState(StateWriter& out, const std::unordered_map<const Client*, int64_t>& clientIndexes) const
+{
+	saveSnapshot(out);
+
+	// Save members and invited clients, along with their status flags. The
+	// cached ban status is left out, since it's cheap to recompute. Clients
+	// that aren't being saved (users on other servers) are skipped, and so
+	// are invited clients that disconnected.
+	std::span<const Member> entries = members.allEntries();
+	std::vector<size_t> saved;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const Client* client = ClientTable::find(entries[i].handle);
+		if (client != nullptr && clientIndexes.contains(client))
+			saved.push_back(i);
+	}
+	out.writeInt(saved.size());
+	for (size_t i: saved) {
+		out.writeInt(clientIndexes.at(entries[i].client));
+		out.writeInt(i < members.getMemberCount());
+		out.writeInt(entries[i].flags & ~(MEMBER_BANCHECKED | MEMBER_BANNED));
+	}
+
+	// Keep the recent messages, so that clients can still fetch them.
+	history.saveState(out);
+}
+
+/**
+ * Restore the channel's state from a previous server process. Clients that
+ * couldn't be restored are null pointers, and are skipped.
+ */
+void Channel::restoreState(StateReader& in, const std::vector<Client*>& clients)
+{
+	restoreSnapshot(in);
+
+	// Restore members and invited clients.
+	for (int64_t count = in.readInt(); count > 0; count--) {
+		Client* client = clients.at(in.readInt());
+		bool isMember = in.readInt();
+		uint8_t flags = in.readInt();
+		if (client == nullptr)
+			continue;
+		if (isMember) {
+			addMember(*client);
+			client->addChannel(this);
+		}
+		if (flags & MEMBER_INVITED)
+			addInvited(*client);
+		members.setFlags(client, flags);
+	}
+	history.restoreState(in);
+}
@@ -1,7 +1,13 @@
 #include <sys/socket.h>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 
 #include "client.hpp"
+#include "clock.hpp"
+#include "config.hpp"
+#include "history.hpp"
+#include "scan.hpp"
 #include "utility.hpp"
 #include "irc.hpp"
 
@@ -11,11 +17,22 @@
 Client::Client(Server& server, int socket, std::string_view host)
 	: server(server),
 	  socket(socket),
-	  host(host),
-	  isPassValid(server.correctPassword(""))
+	  isPassValid(server.correctPassword("")),
+	  host(host)
 {
 }
 
+/**
+ * Destroy a Client, giving any I/O buffers it still holds back to the pool, and
+ * invalidating its handle.
+ */
+Client::~Client()
+{
+	server.getBufferPool().release(input);
+	server.getBufferPool().release(output);
+	ClientTable::remove(handle);
+}
+
 /**
  * Get the client's socket file descriptor.
  */
@@ -24,6 +41,23 @@ int Client::getSocket() const
 	return socket;
 }
 
+/**
+ * Get the client's handle, which channels use to refer to it.
+ */
+ClientHandle Client::getHandle() const
+{
+	return handle;
+}
+
+/**
+ * Add the client to the ClientTable. Must be called once the client is in its
+ * final place in the server's list of clients, since the table points to it.
+ */
+void Client::acquireHandle()
+{
+	handle = ClientTable::add(*this);
+}
+
 /**
  * Get an iterator pair over the channels the client is joined to.
  */
@@ -32,6 +66,44 @@ ClientChannelIterators Client::allChannels()
 	return {channels.begin(), channels.end()};
 }
 
+/**
+ * Check if the client is joined to a channel. The client's own channel list is
+ * searched, which is bounded by chanlimit, so the cost doesn't depend on the
+ * size of the channel.
+ */
+bool Client::isOnChannel(const Channel* channel) const
+{
+	for (const Channel* joined: channels)
+		if (joined == channel)
+			return true;
+	return false;
+}
+
+/**
+ * Add a channel to the client's list of channels.
+ */
+void Client::addChannel(Channel* channel)
+{
+	if (!isOnChannel(channel))
+		channels.push_back(channel);
+}
+
+/**
+ * Remove a channel from the client's list of channels.
+ */
+void Client::removeChannel(Channel* channel)
+{
+	channels.remove(channel);
+}
+
+/**
+ * Get the number of channels the client is joined to.
+ */
+size_t Client::getChannelCount() const
+{
+	return channels.size();
+}
+
 /**
  * Clear the client's list of channels.
  */
@@ -49,10 +121,15 @@ std::string_view Client::getHost() const
 }
 
 /**
- * Get the client's long-form name (in the form nick!user@host).
+ * Get the client's long-form name (in the form nick!user@host). It's put
+ * together when needed rather than stored, since it would be a heap
+ * allocation for every connection.
  */
-std::string_view Client::getFullName() const
+std::string Client::getFullName() const
 {
+	std::string fullname;
+	fullname.reserve(nick.size() + user.size() + host.size() + 2);
+	fullname.append(nick).append(1, '!').append(user).append(1, '@').append(host);
 	return fullname;
 }
 
@@ -64,6 +141,189 @@ std::string_view Client::getNick() const
 	return nick;
 }
 
+/**
+ * Mark the client as visited by a neighbour fan-out. Returns false if the
+ * client was already visited during the same fan-out.
+ */
+bool Client::markVisited(uint64_t epoch)
+{
+	if (visitMark == epoch)
+		return false;
+	visitMark = epoch;
+	return true;
+}
+
+/**
+ * Check if the client has completed registration as a user.
+ */
+bool Client::hasRegistered() const
+{
+	return isRegistered && serverName.empty();
+}
+
+/**
+ * Check if the client has become an IRC operator with the OPER command.
+ */
+bool Client::isIrcOperator() const
+{
+	return isOper;
+}
+
+/**
+ * Check if the client enabled a capability with CAP REQ, or any of several
+ * capabilities if they're combined.
+ */
+bool Client::hasCapability(uint8_t capability) const
+{
+	return (capabilities & capability) != 0;
+}
+
+/**
+ * Send a message from a channel's history with the tags the client can take:
+ * all of them with message-tags, only the time with server-time alone, and
+ * none otherwise. If the message is part of a batch, its tag is added.
+ */
+void Client::sendHistoryLine(const HistoryLine& message, std::string_view batch)
+{
+	std::string_view tags;
+	if (hasCapability(CAP_MESSAGE_TAGS))
+		tags = message.getTags();
+	else if (hasCapability(CAP_SERVER_TIME))
+		tags = message.getTimeTag();
+	if (batch.empty() && tags.size() == message.getTags().size())
+		return send(message.line);
+	if (batch.empty() && tags.empty())
+		return send(message.getUntagged());
+	send("@");
+	if (!batch.empty())
+		send("batch=", batch, tags.empty() ? "" : ";");
+	send(tags, " ", message.getUntagged());
+}
+
+/**
+ * Check if the client stopped reading for so long that its pending output went
+ * over the SendQ limit. Such clients are disconnected by the event loop.
+ */
+bool Client::hasFullSendQueue() const
+{
+	return sendQueueFull && !disconnected;
+}
+
+/**
+ * Check if the client is a user on another server, reached through a server
+ * link instead of a connection of its own.
+ */
+bool Client::isRemote() const
+{
+	return link != nullptr;
+}
+
+/**
+ * Get the server link that a remote user is reached through, or a null pointer
+ * for users on this server.
+ */
+Client* Client::getLink() const
+{
+	return link;
+}
+
+/**
+ * Turn the client into a registered user on another server, introduced by a
+ * server link.
+ */
+void Client::setRemote(Client& newLink, std::string_view newNick, std::string_view newUser, std::string_view newRealname)
+{
+	link = &newLink;
+	server.updateNick(*this, newNick);
+	nick = newNick;
+	user = newUser;
+	realname = newRealname;
+	isRegistered = true;
+	isPassValid = true;
+}
+
+/**
+ * Get the service behind an in-process pseudo-client, or a null pointer for
+ * ordinary clients.
+ */
+Service* Client::getService() const
+{
+	return service;
+}
+
+/**
+ * Turn the client into the registered pseudo-client of an in-process service.
+ * It has no connection, so it never times out, and it's told about messages by
+ * calls to the service instead of being sent them.
+ */
+void Client::setService(Service& newService, std::string_view newNick)
+{
+	service = &newService;
+	server.updateNick(*this, newNick);
+	nick = newNick;
+	user = "service";
+	realname = "In-process service";
+	isRegistered = true;
+	isPassValid = true;
+}
+
+/**
+ * Get the message that introduces the user to other servers.
+ */
+std::string Client::getIntroduction() const
+{
+	std::string introduction = "NICK ";
+	introduction.append(nick).append(" 1 ").append(user).append(" ");
+	introduction.append(host).append(" :").append(realname);
+	return introduction;
+}
+
+/**
+ * Check if the connection is a link to another server, either registered or
+ * still being set up.
+ */
+bool Client::isLink() const
+{
+	return !serverName.empty() || outgoingLink;
+}
+
+/**
+ * Check if the connection is a server link opened by this server, which
+ * should be reopened if it's lost.
+ */
+bool Client::isOutgoingLink() const
+{
+	return outgoingLink;
+}
+
+/**
+ * Get the name of the server at the other end of a server link.
+ */
+std::string_view Client::getServerName() const
+{
+	return serverName;
+}
+
+/**
+ * Mark the connection as a server link opened by this server. The other end
+ * registers it by sending PASS and SERVER messages back.
+ */
+void Client::startLink()
+{
+	outgoingLink = true;
+}
+
+/**
+ * Complete the registration of a server link. From now on, all messages on the
+ * connection are handled by handleLinkMessage.
+ */
+void Client::finishLink(std::string_view name)
+{
+	serverName = name;
+	isRegistered = true;
+	server.getTimers().schedule(timer, lastActivity + Config::get().pingInterval * 1000);
+}
+
 /**
  * Check if the client has been marked as disconnected.
  */
@@ -78,8 +338,110 @@ bool Client::isDisconnected() const
 void Client::setDisconnected()
 {
 	disconnected = true;
+	timer.cancel();
+}
+
+/**
+ * Start the client's timer, giving it registration_timeout seconds to complete
+ * registration. Must only be called once the client is at its final address
+ * (the timer callback refers back to the client).
+ */
+void Client::startTimer()
+{
+	lastActivity = lastMessage = Clock::getMilliseconds();
+	timer.callback = [this] { handleTimeout(); };
+	server.getTimers().schedule(timer, lastActivity + Config::get().registrationTimeout * 1000);
+}
+
+/**
+ * Serialize the client's state for handing it over to a new server process.
+ * The socket and host are passed separately, since they're needed to create
+ * the client in the first place.
+ */
+void Client::saveState(StateWriter& out) const
+{
+	out.writeString(user);
+	out.writeString(realname);
+	out.writeString(nick);
+	out.writeString(input);
+	out.writeString(output);
+	out.writeInt(isRegistered);
+	out.writeInt(isPassValid);
+	out.writeInt(isOper);
+	out.writeInt(negotiatingCaps);
+	out.writeInt(capabilities);
+}
+
+/**
+ * Restore the client's state from a previous server process. Must be called
+ * after the client has been added to the server (see startTimer).
+ */
+void Client::restoreState(StateReader& in)
+{
+	user = in.readString();
+	realname = in.readString();
+	std::string_view savedNick = in.readString();
+	for (std::string* buffer: {&input, &output}) {
+		std::string_view saved = in.readString();
+		if (!saved.empty()) {
+			server.getBufferPool().acquire(*buffer);
+			buffer->append(saved);
+		}
+	}
+	isRegistered = in.readInt();
+	isPassValid = in.readInt();
+	isOper = in.readInt();
+	negotiatingCaps = in.readInt();
+	capabilities = in.readInt();
+	if (!savedNick.empty())
+		server.updateNick(*this, savedNick);
+	nick = savedNick;
+	if (isRegistered)
+		server.getTimers().schedule(timer, lastActivity + Config::get().pingInterval * 1000);
+}
+
+/**
+ * Handle the client's timer expiring. Depending on the client's state, this
+ * either disconnects the client, sends a keepalive PING, or just reschedules
+ * the timer because the client was active in the meantime. Activity never
+ * touches the timer itself, which keeps receiving messages cheap.
+ */
+void Client::handleTimeout()
+{
+	int64_t now = Clock::getMilliseconds();
+	TimerWheel& timers = server.getTimers();
+	const Config& config = Config::get();
+
+	// Drop connections that never finished registering.
+	if (!isRegistered)
+		return server.disconnectClient(*this, "Registration timeout");
+
+	// Drop clients that didn't answer the last PING in time.
+	if (awaitingPong) {
+		log::info("Ping timeout for ", nick);
+		std::string seconds = std::to_string(config.pingTimeout);
+		return server.disconnectClient(*this, "Ping timeout: " + seconds + " seconds");
+	}
+
+	// Drop clients that have been idle for too long, if there's a limit.
+	int64_t idleDeadline = lastMessage + config.idleTimeout * 1000;
+	if (config.idleTimeout > 0 && now >= idleDeadline)
+		return server.disconnectClient(*this, "Idle timeout");
+
+	// Check again later if the client has been active recently.
+	int64_t pingDeadline = lastActivity + config.pingInterval * 1000;
+	if (now < pingDeadline) {
+		int64_t next = config.idleTimeout > 0 ? std::min(pingDeadline, idleDeadline) : pingDeadline;
+		return timers.schedule(timer, next);
+	}
+
+	// Otherwise, check that the client is still there.
+	sendLine("PING :", server.getHostname());
+	awaitingPong = true;
+	timers.schedule(timer, now + config.pingTimeout * 1000);
 }
 
+
 void Client::receive()
 {
 	// Receive data from the client.
@@ -92,89 +454,80 @@ void Client::receive()
 		if (bytes == -1) {
 			if (errno == EAGAIN || errno == ECONNRESET)
 				break; // Nothing more to read.
+			if (errno == ECONNREFUSED || errno == ETIMEDOUT || errno == EHOSTUNREACH) {
+				server.disconnectClient(*this, strerror(errno));
+				break; // An outgoing connection failed.
+			}
 			fail("Failed to receive from client: ", strerror(errno));
 
 		// Handle client disconnection.
 		} else if (bytes == 0) {
 			server.disconnectClient(*this);
 
-		// Buffer received data.
+		// Buffer received data, in a buffer borrowed from the pool until all of
+		// it has been handled.
 		} else {
+			server.getBufferPool().acquire(input);
 			input.append(buffer, bytes);
 
-			// Check for complete messages.
-			while (true) {
-				size_t newline = input.find("\r\n");
-				if (newline == input.npos)
-					break;
-				auto begin = input.begin();
-				auto end = input.begin() + newline;
-				parseMessage(std::string(begin, end));
-				input.erase(0, newline + 2);
+			// Any data from the client shows that the connection is alive.
+			lastActivity = Clock::getMilliseconds();
+			awaitingPong = false;
+
+			// Find all complete messages, and the spaces between their parts,
+			// in one pass over the buffer. The delimiters are only needed
+			// until the messages are handled, so one list serves all clients.
+			static Delimiters delimiters;
+			scanDelimiters(input, delimiters);
+			const Config& config = Config::get();
+			size_t begin = 0;
+			for (uint32_t end: delimiters.lineEnds) {
+
+				// Each message moves the client's flood clock ahead by a fixed
+				// penalty, while the clock runs no slower than real time. A
+				// client whose clock gets too far ahead is sending faster than
+				// allowed. Server links are exempt.
+				if (config.floodCost > 0 && !isLink()) {
+					floodClock = std::max(floodClock, lastActivity) + config.floodCost;
+					if (floodClock - lastActivity > static_cast<int64_t>(config.floodBurst))
+						return server.disconnectClient(*this, "Excess Flood");
+				}
+				parseMessage(begin, end, delimiters.spaces);
+				begin = end + 2;
 			}
+			input.erase(0, begin);
+			if (input.empty())
+				server.getBufferPool().release(input);
+
+			// What's left is an unfinished line, which can't grow forever.
+			if (config.receiveQueue > 0 && input.size() > config.receiveQueue && !isLink())
+				return server.disconnectClient(*this, "RecvQ exceeded");
 		}
 	}
 }
 
 /**
- * Parse a raw client message, then pass it to the message handler for the
- * message's command, along with any parameters.
+ * Parse a raw client message, found between two offsets of the input buffer,
+ * then pass it to the message handler for the message's command, along with
+ * any parameters. The message is split in place, using the spaces found when
+ * the buffer was scanned.
  */
-void Client::parseMessage(std::string message)
+void Client::parseMessage(size_t begin, size_t end, std::span<const uint32_t> spaces)
 {
-	// Array for holding the individual parts of the message.
-	int argc = 0;
-
 	char* argv[MAX_MESSAGE_PARTS];
-
-	// Split the message into parts.
-	size_t begin = 0;
-	while (begin < message.length()) {
-
-		// Find the beginning of the next part.
-		begin = message.find_first_not_of(' ', begin);
-		if (begin == message.npos)
-			break; // Reached the end of the message.
-
-		// Find the end of the part (either the next space or the message end).
-		size_t end = message.find(' ', begin);
-		if (end == message.npos)
-			end = message.length();
-
-		// Ignore tags (parts starting with an '@' sign).
-		if (message[begin] != '@') {
-
-			// Issue a warning if there are too many parts.
-			if (argc == MAX_MESSAGE_PARTS) {
-				log::warn("Message has too many parts: ", message);
-				return;
-			}
-
-			// If the part starts with a ':', treat the rest of the message as
-			// one big part.
-			if (message[begin] == ':') {
-				end = message.length();
-				begin++; // Strip the ':' from the message.
-			}
-
-			// Add the part to the array and null-terminate it.
-			argv[argc++] = message.data() + begin;
-			message[end] = '\0';
-		}
-
-		// Begin the next part at the end of this one.
-		begin = end + (end < message.length());
-	}
-
-	// Pass the message to its handler.
-	handleMessage(argc, argv);
+	char* prefix;
+	int argc = splitMessage(input.data(), begin, end, spaces, argv, prefix);
+	if (argc == -1)
+		return log::warn("Message has too many parts: ", argv[0]);
+	handleMessage(argc, argv, prefix);
 }
 
 /**
  * Handle any type of message. Removes the command from the parameter list, then
- * calls the handler for that command with the remaining parameters.
+ * calls the handler for that command with the remaining parameters. Messages
+ * on registered server links are passed on to handleLinkMessage instead.
  */
-void Client::handleMessage(int argc, char** argv)
+void Client::handleMessage(int argc, char** argv, const char* prefix)
 {
 	// Ignore empty messages.
 	if (argc == 0)
@@ -201,11 +554,26 @@ void Client::handleMessage(int argc, char** argv)
 		{"LUSERS", &Client::handleLusers},
 		{"MOTD", &Client::handleMotd},
 		{"NOTICE", &Client::handleNotice},
+		{"PONG", &Client::handlePong},
+		{"SERVER", &Client::handleServer},
+		{"OPER", &Client::handleOper},
+		{"REHASH", &Client::handleRehash},
+		{"STATS", &Client::handleStats},
+		{"CAP", &Client::handleCap},
+		{"CHATHISTORY", &Client::handleChatHistory},
 	};
 
+	// Keepalive traffic doesn't count as activity for the idle timeout.
+	if (!equalsIgnoreCase(argv[0], "PING") && !equalsIgnoreCase(argv[0], "PONG"))
+		lastMessage = lastActivity;
+
+	// Messages from other servers have their own set of commands.
+	if (!serverName.empty())
+		return handleLinkMessage(prefix, argc, argv);
+
 	// Send the message to the handler for that command.
 	for (const auto& [command, handler]: handlers) {
-		if (matchIgnoreCase(command, argv[0])) {
+		if (equalsIgnoreCase(command, argv[0])) {
 			return (this->*handler)(argc - 1, argv + 1);
 		}
 	}
@@ -222,18 +590,60 @@ void Client::handleMessage(int argc, char** argv)
  */
 void Client::send(const std::string_view& string)
 {
-	output.append(string);
-	ssize_t bytes = 1;
-	const int sendFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
-	while (bytes > 0 && output.find("\r\n") != output.npos) {
-		bytes = ::send(socket, output.data(), output.size(), sendFlags);
-		if (bytes == -1) {
-			if (errno == EAGAIN || errno == ECONNRESET || errno == EPIPE)
-				break;
-			fail("Failed to send to client: ", strerror(errno));
-		}
+	// Users on other servers get their messages through the server link, which
+	// is handled separately for each type of message, and services get the
+	// ones they need as calls. Clients over the SendQ limit get nothing more,
+	// since they're about to be disconnected.
+	if (link != nullptr || service != nullptr || sendQueueFull)
+		return;
+
+	// Complete lines go straight to the socket if nothing else is waiting, so
+	// that the common case doesn't need a buffer at all.
+	std::string_view pending = string;
+	if (output.empty() && pending.ends_with("\r\n"))
+		pending.remove_prefix(writeSocket(pending));
+	if (output.empty() && pending.empty())
+		return;
+
+	// Otherwise, buffer the data in a buffer borrowed from the pool, and send
+	// whatever complete lines the socket will take.
+	BufferPool& pool = server.getBufferPool();
+	pool.acquire(output);
+	output.append(pending);
+	while (output.find("\r\n") != output.npos) {
+		size_t bytes = writeSocket(output);
+		if (bytes == 0)
+			break;
 		output.erase(0, bytes);
 	}
+
+	// Drop the output of clients that fell too far behind. They can't be
+	// disconnected here, since this may run on a fan-out thread, so the event
+	// loop does it instead (see hasFullSendQueue).
+	size_t limit = Config::get().sendQueue;
+	if (limit > 0 && output.size() > limit && !isLink()) {
+		sendQueueFull = true;
+		output.clear();
+	}
+	if (output.empty())
+		pool.release(output);
+}
+
+/**
+ * Write as much data to the client's socket as it takes without blocking.
+ * Returns the number of bytes written, which is zero if the socket is full or
+ * the connection is broken (which is noticed when receiving).
+ */
+size_t Client::writeSocket(std::string_view data)
+{
+	ssize_t bytes = ::send(socket, data.data(), data.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (bytes == -1) {
+		if (errno == EAGAIN || errno == ECONNRESET || errno == EPIPE
+			|| errno == ECONNREFUSED || errno == ETIMEDOUT || errno == EHOSTUNREACH)
+			return 0;
+		fail("Failed to send to client: ", strerror(errno));
+	}
+	return bytes;
 }
 
 /**
@@ -242,32 +652,29 @@ void Client::send(const std::string_view& string)
  */
 void Client::handleRegistrationComplete()
 {
-	// Check that all credentials were received.
-	if (nick.empty() || user.empty() || !isPassValid)
+	// Check that all credentials were received, and that capability
+	// negotiation is over.
+	if (nick.empty() || user.empty() || !isPassValid || negotiatingCaps || isRegistered)
 		return;
 
 	// Update the client's status.
 	isRegistered = true;
-	fullname = nick + "!" + user + "@" + host;
+	server.getTimers().schedule(timer, lastActivity + Config::get().pingInterval * 1000);
 
 	// Send welcome messages.
-	sendNumeric("001", ":Welcome to the ", SERVER_NAME, " Network ", fullname);
+	sendNumeric("001", ":Welcome to the ", SERVER_NAME, " Network ", getFullName());
 	sendNumeric("002", ":Your host is ", SERVER_NAME, ", running version 1.0");
 	sendNumeric("003", ":This server was created ", server.getLaunchTime());
 	sendNumeric("004", ":" SERVER_NAME " Version 1.0");
 
-	// Send feature advertisement messages (at least one is mandatory).
-	const char* features[] = {
-		"CASEMAPPING=ascii",
-		"NICKLEN=" STRINGIFY(NICKLEN),
-		"USERLEN=" STRINGIFY(USERLEN),
-		"TOPICLEN=" STRINGIFY(TOPICLEN),
-		"CHANNELLEN=" STRINGIFY(CHANNELLEN),
-		"KICKLEN=" STRINGIFY(KICKLEN),
-	};
-	for (const char* feature: features)
+	// Send feature advertisement messages (at least one is mandatory). They
+	// depend on the configuration, and are sent again if it changes.
+	for (const std::string& feature: Config::get().getSupportTokens())
 		sendNumeric("005", feature, " :are supported by this server");
 
+	// Introduce the new user to the rest of the network.
+	server.propagate(getIntroduction(), nullptr);
+
 	// Respond as if the LUSERS and MOTD commands had been sent.
 	handleLusers(0, nullptr);
 	handleMotd(0, nullptr);
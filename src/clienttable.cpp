@@ -0,0 +1,47 @@
+#include "clienttable.hpp"
+
+std::vector<ClientTable::Slot> ClientTable::slots;
+uint32_t ClientTable::firstFree = UINT32_MAX;
+
+/**
+ * Add a client to the table, reusing a free slot if there is one, and return
+ * its handle.
+ */
+ClientHandle ClientTable::add(Client& client)
+{
+	uint32_t index = firstFree;
+	if (index == UINT32_MAX) {
+		index = slots.size();
+		slots.push_back({nullptr, 0, UINT32_MAX});
+	} else {
+		firstFree = slots[index].nextFree;
+	}
+	slots[index].client = &client;
+	return {index, slots[index].generation};
+}
+
+/**
+ * Remove a client from the table. Every handle to it stops finding it, since
+ * the generation of its slot changes.
+ */
+void ClientTable::remove(ClientHandle handle)
+{
+	if (find(handle) == nullptr)
+		return;
+	Slot& slot = slots[handle.index];
+	slot.client = nullptr;
+	slot.generation++;
+	slot.nextFree = firstFree;
+	firstFree = handle.index;
+}
+
+/**
+ * Find the client a handle refers to. Returns a null pointer if the client was
+ * removed, or the handle doesn't refer to any client.
+ */
+Client* ClientTable::find(ClientHandle handle)
+{
+	if (handle.index >= slots.size() || slots[handle.index].generation != handle.generation)
+		return nullptr;
+	return slots[handle.index].client;
+}
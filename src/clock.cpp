@@ -0,0 +1,95 @@
+#include <charconv>
+#include <ctime>
+
+#include "clock.hpp"
+
+int64_t Clock::seconds = -1;
+int64_t Clock::milliseconds = 0;
+char Clock::unixString[24];
+char Clock::asctimeString[32];
+char Clock::isoString[32];
+size_t Clock::unixLength = 0;
+size_t Clock::asctimeLength = 0;
+size_t Clock::isoLength = 0;
+
+/**
+ * Sample the current time. Should be called once per iteration of the event
+ * loop, after waking up.
+ */
+void Clock::update()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	milliseconds = now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+	// Rebuild the second-resolution strings only when the second changes.
+	if (now.tv_sec != seconds) {
+		seconds = now.tv_sec;
+		time_t time = now.tv_sec;
+		struct tm local, utc;
+		localtime_r(&time, &local);
+		gmtime_r(&time, &utc);
+		unixLength = std::to_chars(unixString, unixString + sizeof(unixString), seconds).ptr - unixString;
+		asctimeLength = strftime(asctimeString, sizeof(asctimeString), "%a %b %e %H:%M:%S %Y", &local);
+		isoLength = strftime(isoString, sizeof(isoString), "%Y-%m-%dT%H:%M:%S.", &utc);
+	}
+
+	// Fill in the milliseconds of the ISO 8601 timestamp.
+	int ms = now.tv_nsec / 1000000;
+	isoString[isoLength + 0] = '0' + ms / 100;
+	isoString[isoLength + 1] = '0' + ms / 10 % 10;
+	isoString[isoLength + 2] = '0' + ms % 10;
+	isoString[isoLength + 3] = 'Z';
+}
+
+/**
+ * Get the current Unix time, in seconds.
+ */
+int64_t Clock::getUnixTime()
+{
+	if (seconds == -1)
+		update();
+	return seconds;
+}
+
+/**
+ * Get the current Unix time, in milliseconds.
+ */
+int64_t Clock::getMilliseconds()
+{
+	if (seconds == -1)
+		update();
+	return milliseconds;
+}
+
+/**
+ * Get the current Unix time as a decimal string (like "1792352012").
+ */
+std::string_view Clock::getUnixString()
+{
+	if (seconds == -1)
+		update();
+	return {unixString, unixLength};
+}
+
+/**
+ * Get the current local time in the format of asctime() (like "Sun Oct 18
+ * 12:00:00 2026"), without the trailing newline.
+ */
+std::string_view Clock::getAsctime()
+{
+	if (seconds == -1)
+		update();
+	return {asctimeString, asctimeLength};
+}
+
+/**
+ * Get the current UTC time in ISO 8601 format with milliseconds (like
+ * "2026-10-18T12:00:00.000Z"), as used by the IRCv3 server-time tag.
+ */
+std::string_view Clock::getIsoTime()
+{
+	if (seconds == -1)
+		update();
+	return {isoString, isoLength + 4};
+}
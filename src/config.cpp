@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <sstream>
+
+#include "config.hpp"
+#include "filter.hpp"
+#include "log.hpp"
+#include "scan.hpp"
+#include "service.hpp"
+#include "utility.hpp"
+
+// The configuration in effect, and the file it's read from. The path can only
+// be missing if it wasn't given explicitly, in which case the defaults are
+// used.
+static Config current;
+static std::string path = CONFIG_FILE;
+static bool pathGiven = false;
+
+// Numeric settings, with the range of values allowed for each.
+static const struct {
+	const char* key;
+	size_t Config::* field;
+	int64_t min;
+	int64_t max;
+} numbers[] = {
+	{"listen_backlog", &Config::listenBacklog, 1, INT_MAX},
+	{"epoll_batch", &Config::epollBatch, 1, 4096},
+	{"epoll_busy_poll", &Config::epollBusyPoll, 0, INT_MAX},
+	{"fanout_threshold", &Config::fanoutThreshold, 1, INT64_MAX},
+	{"io_buffer_size", &Config::ioBufferSize, 64, 1 << 20},
+	{"io_buffer_max_size", &Config::ioBufferMaxSize, 64, INT64_MAX},
+	{"io_pool_max_free", &Config::ioPoolMaxFree, 0, INT64_MAX},
+	{"io_pool_trim_interval", &Config::ioPoolTrimInterval, 1, INT_MAX},
+	{"sendq", &Config::sendQueue, 0, INT64_MAX},
+	{"recvq", &Config::receiveQueue, 0, INT64_MAX},
+	{"flood_cost", &Config::floodCost, 0, INT_MAX},
+	{"flood_burst", &Config::floodBurst, 0, INT_MAX},
+	{"filter_repeat_count", &Config::filterRepeatCount, 1, INT_MAX},
+	{"filter_repeat_window", &Config::filterRepeatWindow, 1, INT_MAX},
+	{"history_lines", &Config::historyLines, 0, 1000000},
+	{"history_bytes", &Config::historyBytes, 1024, INT64_MAX},
+	{"history_max_replies", &Config::historyMaxReplies, 1, INT_MAX},
+	{"history_spill_size", &Config::historySpillSize, 65536, 1 << 30},
+	{"registration_timeout", &Config::registrationTimeout, 1, INT_MAX},
+	{"ping_interval", &Config::pingInterval, 1, INT_MAX},
+	{"ping_timeout", &Config::pingTimeout, 1, INT_MAX},
+	{"idle_timeout", &Config::idleTimeout, 0, INT_MAX},
+	{"link_retry_interval", &Config::linkRetryInterval, 1, INT_MAX},
+	{"journal_check_interval", &Config::journalCheckInterval, 1, INT_MAX},
+	{"journal_compact_size", &Config::journalCompactSize, 1, INT64_MAX},
+	{"nicklen", &Config::nickLength, 1, NICKLEN},
+	{"userlen", &Config::userLength, 1, USERLEN},
+	{"channellen", &Config::channelLength, 2, INT_MAX},
+	{"topiclen", &Config::topicLength, 0, INT_MAX},
+	{"kicklen", &Config::kickLength, 0, INT_MAX},
+	{"chanlimit", &Config::channelLimit, 1, INT_MAX},
+	{"maxlist", &Config::maxList, 1, INT_MAX},
+	{"who_max_replies", &Config::whoMaxReplies, 1, INT_MAX},
+};
+
+/**
+ * Remove whitespace from both ends of a string.
+ */
+static std::string_view trim(std::string_view string)
+{
+	size_t begin = string.find_first_not_of(" \t\r");
+	if (begin == string.npos)
+		return "";
+	size_t end = string.find_last_not_of(" \t\r");
+	return string.substr(begin, end - begin + 1);
+}
+
+/**
+ * Parse a socket profile, given as a name followed by options. Options are
+ * "nodelay", or one of the numeric options as "option=value". A profile with
+ * the name of an existing one replaces it. Returns an error message, or an
+ * empty string if the profile is valid.
+ */
+static std::string parseProfile(Config& config, const std::string& value)
+{
+	static const struct {
+		const char* option;
+		int SocketProfile::* field;
+	} options[] = {
+		{"notsent_lowat", &SocketProfile::notSentLowat},
+		{"sndbuf", &SocketProfile::sendBuffer},
+		{"rcvbuf", &SocketProfile::receiveBuffer},
+		{"busy_poll", &SocketProfile::busyPoll},
+		{"defer_accept", &SocketProfile::deferAccept},
+	};
+
+	std::istringstream words(value);
+	SocketProfile profile;
+	if (!(words >> profile.name))
+		return "expected a profile name";
+	for (std::string word; words >> word;) {
+		if (word == "nodelay") {
+			profile.noDelay = true;
+			continue;
+		}
+		size_t equals = word.find('=');
+		std::string option = word.substr(0, equals);
+		auto known = std::find_if(std::begin(options), std::end(options),
+			[&] (const auto& entry) { return option == entry.option; });
+		int number;
+		if (known == std::end(options) || equals == word.npos)
+			return "unknown option " + word;
+		if (!parseInt(word.c_str() + equals + 1, number) || number < 0)
+			return "expected a number for " + option;
+		profile.*known->field = number;
+	}
+	std::erase_if(config.profiles, [&] (const SocketProfile& old) { return old.name == profile.name; });
+	config.profiles.push_back(profile);
+	return "";
+}
+
+/**
+ * Apply one "key = value" setting to a configuration. Returns an error message,
+ * or an empty string if the setting is valid. Settings that hold a list
+ * (listen, profile, oper, link_allow, service and filter) are added to the list once per
+ * line.
+ */
+static std::string applySetting(Config& config, std::string_view key, const std::string& value)
+{
+	for (const auto& number: numbers) {
+		if (key != number.key)
+			continue;
+		int64_t parsed;
+		if (!parseInt(value.c_str(), parsed) || parsed < number.min || parsed > number.max) {
+			return "expected a number from " + std::to_string(number.min)
+				+ " to " + std::to_string(number.max);
+		}
+		config.*number.field = parsed;
+		return "";
+	}
+	if (key == "server_name") {
+		config.serverName = value;
+	} else if (key == "link") {
+		config.link = value;
+	} else if (key == "link_password") {
+		config.linkPassword = value;
+	} else if (key == "link_allow") {
+		std::istringstream words(value);
+		std::string name, address, extra;
+		if (!(words >> name >> address) || words >> extra)
+			return "expected a server name and an address";
+		config.linkAllow.emplace_back(name, address);
+	} else if (key == "casemapping") {
+		if (!isKnownCasemapping(value))
+			return "expected \"ascii\" or \"rfc1459\"";
+		config.casemapping = value;
+	} else if (key == "unix_host") {
+		if (value.empty() || !isValidNameString(value))
+			return "expected a host name";
+		config.unixHost = value;
+	} else if (key == "motd_file") {
+		config.motdFile = value;
+	} else if (key == "bot_words") {
+		config.botWords = value;
+	} else if (key == "filter_words") {
+		config.filterWords = value;
+	} else if (key == "history_spill_dir") {
+		config.historySpillDir = value;
+	} else if (key == "filter") {
+		std::istringstream words(value);
+		std::string stage, action, extra;
+		if (!(words >> stage >> action) || words >> extra)
+			return "expected a stage and an action";
+		if (!FilterPipeline::isValidStage(stage, action))
+			return "unknown stage or unsupported action: " + value;
+		config.filters.emplace_back(stage, action);
+	} else if (key == "listen") {
+		std::istringstream words(value);
+		std::string address, profile, extra;
+		if (!(words >> address) || words >> profile >> extra)
+			return "expected an address and an optional profile";
+		config.listen.push_back({address, profile.empty() ? "default" : profile});
+	} else if (key == "profile") {
+		return parseProfile(config, value);
+	} else if (key == "oper") {
+		std::istringstream words(value);
+		std::string name, password, extra;
+		if (!(words >> name >> password) || words >> extra)
+			return "expected a name and a password";
+		config.operators.emplace_back(name, password);
+	} else if (key == "service") {
+		std::istringstream words(value);
+		std::string type, nick, extra;
+		if (!(words >> type >> nick) || words >> extra)
+			return "expected a type and a nickname";
+		if (!Service::isKnownType(type))
+			return "unknown service type " + type;
+		if (nick.length() > NICKLEN || !isValidNameString(nick))
+			return "invalid nickname " + nick;
+		config.services.emplace_back(type, nick);
+	} else if (key == "scan_kernel") {
+		if (!isScanKernelSupported(value))
+			return "unknown kernel, or one this CPU can't run: " + value;
+		config.scanKernel = value;
+	} else if (key == "fanout_threads") {
+		int64_t threads;
+		if (value == "auto")
+			config.fanoutThreads = -1;
+		else if (parseInt(value.c_str(), threads) && threads >= 0 && threads <= 1024)
+			config.fanoutThreads = threads;
+		else
+			return "expected \"auto\" or a number from 0 to 1024";
+	} else {
+		return "unknown setting";
+	}
+	return "";
+}
+
+/**
+ * Read the message of the day from the configured file. If it can't be read,
+ * the message is left empty, and clients are told it's missing.
+ */
+static void loadMotd(Config& config)
+{
+	if (config.motdFile.empty())
+		return;
+	std::ifstream file(config.motdFile);
+	if (!file.is_open())
+		return log::warn("Failed to read the MOTD file ", config.motdFile);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	config.motd = contents.str();
+}
+
+/**
+ * Get the configuration currently in effect.
+ */
+const Config& Config::get()
+{
+	return current;
+}
+
+/**
+ * Set the file the configuration is read from. A file given explicitly must
+ * exist, while the default one is optional.
+ */
+void Config::setPath(std::string_view newPath)
+{
+	path = newPath;
+	pathGiven = true;
+}
+
+/**
+ * Get the file the configuration is read from.
+ */
+const std::string& Config::getPath()
+{
+	return path;
+}
+
+/**
+ * Read the configuration file, and make it the configuration in effect. If the
+ * file has any errors, they're logged, and the current configuration is kept.
+ * Returns false in that case.
+ */
+bool Config::load()
+{
+	// Without a configuration file, the defaults are used.
+	Config config;
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		if (pathGiven) {
+			log::error("Failed to open configuration file ", path);
+			return false;
+		}
+		log::info("No configuration file found, using the defaults");
+		current = config;
+		return true;
+	}
+
+	// Parse the file line by line. Lines starting with '#' are comments. The
+	// default listen address is only used if the file doesn't give any.
+	bool listenGiven = false;
+	std::string line;
+	for (int number = 1; std::getline(file, line); number++) {
+		std::string_view text = trim(line);
+		if (text.empty() || text[0] == '#')
+			continue;
+		size_t equals = text.find('=');
+		if (equals == text.npos) {
+			log::error(path, ":", number, ": Expected \"key = value\"");
+			return false;
+		}
+		std::string_view key = trim(text.substr(0, equals));
+		std::string value(trim(text.substr(equals + 1)));
+		if (key == "listen" && !listenGiven) {
+			config.listen.clear();
+			listenGiven = true;
+		}
+		std::string error = applySetting(config, key, value);
+		if (!error.empty()) {
+			log::error(path, ":", number, ": ", key, ": ", error);
+			return false;
+		}
+	}
+
+	// Check settings that depend on each other.
+	if (config.ioBufferMaxSize < config.ioBufferSize) {
+		log::error(path, ": io_buffer_max_size must be at least io_buffer_size");
+		return false;
+	}
+	for (const ListenAddress& listen: config.listen) {
+		auto matches = [&] (const SocketProfile& profile) { return profile.name == listen.profile; };
+		if (std::none_of(config.profiles.begin(), config.profiles.end(), matches)) {
+			log::error(path, ": Unknown socket profile ", listen.profile, " for ", listen.address);
+			return false;
+		}
+	}
+	for (auto i = config.services.begin(); i != config.services.end(); ++i) {
+		auto sameNick = [&] (const auto& other) { return equalsIgnoreCase(other.second, i->second); };
+		if (std::any_of(config.services.begin(), i, sameNick)) {
+			log::error(path, ": Two services named ", i->second);
+			return false;
+		}
+	}
+	loadMotd(config);
+	current = std::move(config);
+	log::info("Loaded configuration from ", path);
+	return true;
+}
+
+/**
+ * Get the feature tokens advertised to clients in RPL_ISUPPORT replies.
+ */
+std::vector<std::string> Config::getSupportTokens() const
+{
+	std::vector<std::string> tokens = {
+		"CASEMAPPING=" + std::string(getCasemapping()),
+		"NICKLEN=" + std::to_string(nickLength),
+		"USERLEN=" + std::to_string(userLength),
+		"TOPICLEN=" + std::to_string(topicLength),
+		"CHANNELLEN=" + std::to_string(channelLength),
+		"KICKLEN=" + std::to_string(kickLength),
+		"CHANLIMIT=#:" + std::to_string(channelLimit),
+		"WHOX",
+		"EXCEPTS",
+		"CHANMODES=be,k,l,it",
+		"PREFIX=(ov)@+",
+		"MAXLIST=be:" + std::to_string(maxList),
+	};
+	if (historyLines > 0) {
+		tokens.push_back("CHATHISTORY=" + std::to_string(historyMaxReplies));
+		tokens.push_back("MSGREFTYPES=msgid,timestamp");
+	}
+	return tokens;
+}
+
+/**
+ * Get a socket profile by its name. Every listen address has a valid profile,
+ * since that's checked when the configuration is loaded.
+ */
+const SocketProfile& Config::getProfile(std::string_view name) const
+{
+	for (const SocketProfile& profile: profiles)
+		if (profile.name == name)
+			return profile;
+	return profiles.front();
+}
@@ -0,0 +1,110 @@
+#include <csignal>
+
+#include "fanout.hpp"
+
+FanOut::FanOut(size_t threadCount)
+{
+	for (size_t i = 0; i < threadCount; i++)
+		threads.emplace_back(&FanOut::work, this, i + 1);
+}
+
+FanOut::~FanOut()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread: threads)
+		thread.join();
+}
+
+/**
+ * Get the number of worker threads, not counting the calling thread.
+ */
+size_t FanOut::getThreadCount() const
+{
+	return threads.size();
+}
+
+/**
+ * Call task(begin, end) for consecutive ranges that together cover the items
+ * from 0 to count, with one range per thread. Returns when all of them are
+ * done. If any part throws, the first exception is rethrown here.
+ */
+void FanOut::run(size_t count, const std::function<void(size_t, size_t)>& task)
+{
+	if (threads.empty())
+		return task(0, count);
+	{
+		std::lock_guard lock(mutex);
+		this->task = &task;
+		this->count = count;
+		remaining = threads.size();
+		error = nullptr;
+		generation++;
+	}
+	wake.notify_all();
+
+	// Do the first part on this thread, then wait for the workers.
+	std::exception_ptr ownError;
+	try {
+		runPart(0);
+	} catch (...) {
+		ownError = std::current_exception();
+	}
+	std::unique_lock lock(mutex);
+	done.wait(lock, [this] { return remaining == 0; });
+	this->task = nullptr;
+	if (ownError)
+		std::rethrow_exception(ownError);
+	if (error)
+		std::rethrow_exception(error);
+}
+
+/**
+ * Run one part of the current job. Parts are sized so that they differ by at
+ * most one item.
+ */
+void FanOut::runPart(size_t part)
+{
+	size_t parts = threads.size() + 1;
+	size_t begin = count * part / parts;
+	size_t end = count * (part + 1) / parts;
+	if (begin < end)
+		(*task)(begin, end);
+}
+
+/**
+ * The main function of a worker thread, which runs the same part of each job
+ * until the pool is destroyed.
+ */
+void FanOut::work(size_t part)
+{
+	// Signals are left to the event loop, which only lets them in while it
+	// waits for events.
+	sigset_t signals;
+	sigfillset(&signals);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	uint64_t seen = 0;
+	std::unique_lock lock(mutex);
+	while (true) {
+		wake.wait(lock, [&] { return stopping || generation != seen; });
+		if (stopping)
+			return;
+		seen = generation;
+		lock.unlock();
+		std::exception_ptr partError;
+		try {
+			runPart(part);
+		} catch (...) {
+			partError = std::current_exception();
+		}
+		lock.lock();
+		if (partError && !error)
+			error = partError;
+		if (--remaining == 0)
+			done.notify_one();
+	}
+}
@@ -0,0 +1,324 @@
+#include <chrono>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "client.hpp"
+#include "clock.hpp"
+#include "config.hpp"
+#include "filter.hpp"
+#include "utility.hpp"
+
+/**
+ * Find the first control character (a byte below 0x20) in a text, starting
+ * from the given position. Returns std::string_view::npos if there's none.
+ * Messages rarely have any, so the text is checked 16 bytes at a time where
+ * SSE2 is available (which is always, on x86-64).
+ */
+size_t findControlByte(std::string_view text, size_t from)
+{
+	size_t i = from;
+#ifdef __SSE2__
+	const __m128i highest = _mm_set1_epi8(0x1f);
+	for (; i + 16 <= text.size(); i += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i));
+		__m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(bytes, highest), bytes);
+		int mask = _mm_movemask_epi8(isControl);
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for (; i < text.size(); i++)
+		if (static_cast<unsigned char>(text[i]) < 0x20)
+			return i;
+	return text.npos;
+}
+
+/**
+ * Blocks, censors or tags messages containing any of the words in the
+ * filter_words file. The file has the same format as the bot's word list.
+ */
+class WordsStage : public FilterStage
+{
+public:
+	WordsStage(FilterAction action, const std::string& path)
+		: FilterStage("words", action)
+	{
+		if (!path.empty())
+			words.load(path);
+	}
+
+	bool matches(FilterMessage& message) override
+	{
+		return words.matches(message.text);
+	}
+
+	void rewrite(std::string& text) override
+	{
+		words.censor(text);
+	}
+
+private:
+	WordMatcher words;
+};
+
+/**
+ * Blocks or tags a message that a user sends more than filter_repeat_count
+ * times in a row, with no more than filter_repeat_window seconds between
+ * each. Case is ignored when comparing messages. Only a hash of each user's
+ * last message is kept, in a fixed-size table indexed by the user's handle,
+ * so memory use doesn't grow with the number of users. Users that land on the same
+ * slot just reset each other's counts.
+ */
+class RepeatStage : public FilterStage
+{
+public:
+	RepeatStage(FilterAction action, size_t limit, size_t window)
+		: FilterStage("repeat", action)
+		, limit(limit)
+		, window(window * 1000)
+		, slots(4096)
+	{
+	}
+
+	bool matches(FilterMessage& message) override
+	{
+		// Hash the message with FNV-1a, folding uppercase letters.
+		uint64_t hash = 0xcbf29ce484222325;
+		for (char c: message.text)
+			hash = (hash ^ static_cast<unsigned char>(foldChar(c))) * 0x100000001b3;
+
+		// Count the message if it's the same as the sender's last one. Users
+		// are told apart by their handles, so a new user can't take over the
+		// count of one that left, even if it reuses the same memory.
+		ClientHandle sender = message.sender.getHandle();
+		Slot& slot = slots[sender.index % slots.size()];
+		int64_t now = Clock::getMilliseconds();
+		if (slot.client == sender && slot.hash == hash && now - slot.time <= window) {
+			slot.count++;
+		} else {
+			slot.client = sender;
+			slot.hash = hash;
+			slot.count = 1;
+		}
+		slot.time = now;
+		return slot.count > limit;
+	}
+
+private:
+	struct Slot
+	{
+		ClientHandle client;			// The user whose message is in the slot
+		uint64_t hash = 0;				// Hash of the user's last message
+		uint64_t count = 0;				// Number of times the message was sent in a row
+		int64_t time = 0;				// When the message was last sent, in milliseconds
+	};
+
+	uint64_t limit;
+	int64_t window;
+	std::vector<Slot> slots;
+};
+
+/**
+ * Check if a byte is one of the mIRC formatting codes (bold, color, hex color,
+ * reset, monospace, reverse, italic, strikethrough and underline).
+ */
+static bool isFormattingCode(char c)
+{
+	static const std::string_view codes = "\x02\x03\x04\x0f\x11\x16\x1d\x1e\x1f";
+	return codes.find(c) != codes.npos;
+}
+
+/**
+ * Blocks, strips or tags text formatting codes. Other control characters, like
+ * the ones around CTCP messages, are left alone.
+ */
+class FormattingStage : public FilterStage
+{
+public:
+	explicit FormattingStage(FilterAction action)
+		: FilterStage("formatting", action)
+	{
+	}
+
+	bool matches(FilterMessage& message) override
+	{
+		std::string_view text = message.text;
+		for (size_t i = findControlByte(text); i != text.npos; i = findControlByte(text, i + 1))
+			if (isFormattingCode(text[i]))
+				return true;
+		return false;
+	}
+
+	void rewrite(std::string& text) override
+	{
+		// Copy the text up to each formatting code, and skip over the code,
+		// along with the colors that follow a color code.
+		std::string result;
+		size_t copied = 0;
+		for (size_t i = findControlByte(text); i != text.npos; i = findControlByte(text, copied)) {
+			result.append(text, copied, i - copied);
+			copied = i + 1;
+			if (!isFormattingCode(text[i]))
+				result.push_back(text[i]);
+			else if (text[i] == '\x03')
+				copied = skipColors(text, copied, "0123456789", 2);
+			else if (text[i] == '\x04')
+				copied = skipColors(text, copied, "0123456789abcdefABCDEF", 6);
+		}
+		result.append(text, copied);
+		text = std::move(result);
+	}
+
+private:
+	// Skip the "foreground[,background]" colors after a color code, where each
+	// color is up to the given number of digits. Returns the position after
+	// them.
+	static size_t skipColors(std::string_view text, size_t i, std::string_view digits, size_t length)
+	{
+		auto skipColor = [&] (size_t start) {
+			size_t end = start;
+			while (end < text.size() && end - start < length && digits.find(text[end]) != digits.npos)
+				end++;
+			return end;
+		};
+		size_t end = skipColor(i);
+		if (end > i && end + 1 < text.size() && text[end] == ',' && skipColor(end + 1) > end + 1)
+			end = skipColor(end + 1);
+		return end;
+	}
+};
+
+FilterStage::FilterStage(std::string_view name, FilterAction action)
+	: name(name)
+	, action(action)
+{
+}
+
+/**
+ * Change a message that matched the stage. Only called for stages that
+ * support FILTER_REWRITE.
+ */
+void FilterStage::rewrite(std::string&)
+{
+}
+
+/**
+ * Get the name of the stage, as given in the configuration.
+ */
+const std::string& FilterStage::getName() const
+{
+	return name;
+}
+
+/**
+ * Get what the pipeline does with messages the stage matches.
+ */
+FilterAction FilterStage::getAction() const
+{
+	return action;
+}
+
+/**
+ * Build the stages listed in the configuration, replacing the current ones.
+ * Their counters start again from zero.
+ */
+void FilterPipeline::configure(const Config& config)
+{
+	stages.clear();
+	for (const auto& [name, actionName]: config.filters) {
+		FilterAction action;
+		parseAction(actionName, action);
+		if (name == "words")
+			stages.push_back(std::make_unique<WordsStage>(action, config.filterWords));
+		else if (name == "repeat")
+			stages.push_back(std::make_unique<RepeatStage>(action, config.filterRepeatCount, config.filterRepeatWindow));
+		else if (name == "formatting")
+			stages.push_back(std::make_unique<FormattingStage>(action));
+	}
+}
+
+/**
+ * Run a message through each stage in turn. Returns false if a stage blocked
+ * the message, in which case the remaining stages don't see it.
+ */
+bool FilterPipeline::run(FilterMessage& message)
+{
+	using namespace std::chrono;
+	for (const std::unique_ptr<FilterStage>& stage: stages) {
+		auto start = steady_clock::now();
+		bool matched = stage->matches(message);
+		if (matched && stage->getAction() == FILTER_REWRITE)
+			stage->rewrite(message.text);
+		stage->nanoseconds += duration_cast<nanoseconds>(steady_clock::now() - start).count();
+		stage->calls++;
+		if (!matched)
+			continue;
+		stage->hits++;
+		if (stage->getAction() == FILTER_BLOCK) {
+			message.blockedBy = stage->getName();
+			return false;
+		}
+		if (stage->getAction() == FILTER_TAG)
+			message.tags.push_back(stage->getName());
+	}
+	return true;
+}
+
+/**
+ * Check if there are no stages, so messages don't need to be filtered.
+ */
+bool FilterPipeline::isEmpty() const
+{
+	return stages.empty();
+}
+
+/**
+ * Get all stages, in the order messages go through them.
+ */
+const std::vector<std::unique_ptr<FilterStage>>& FilterPipeline::getStages() const
+{
+	return stages;
+}
+
+/**
+ * Check if there's a stage with the given name, and if it supports the given
+ * action. Only the words and formatting stages can rewrite messages.
+ */
+bool FilterPipeline::isValidStage(std::string_view stage, std::string_view actionName)
+{
+	FilterAction action;
+	if (!parseAction(actionName, action))
+		return false;
+	if (stage == "words" || stage == "formatting")
+		return true;
+	return stage == "repeat" && action != FILTER_REWRITE;
+}
+
+/**
+ * Get the action with the given name. Returns false if there's none.
+ */
+bool FilterPipeline::parseAction(std::string_view name, FilterAction& action)
+{
+	for (FilterAction known: {FILTER_BLOCK, FILTER_REWRITE, FILTER_TAG}) {
+		if (name == getActionName(known)) {
+			action = known;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Get the name of an action, as given in the configuration.
+ */
+const char* FilterPipeline::getActionName(FilterAction action)
+{
+	switch (action) {
+		case FILTER_BLOCK: return "block";
+		case FILTER_REWRITE: return "rewrite";
+		case FILTER_TAG: return "tag";
+	}
+	return "";
+}
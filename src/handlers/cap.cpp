@@ -0,0 +1,90 @@
+#include <algorithm>
+
+#include "client.hpp"
+#include "server.hpp"
+#include "utility.hpp"
+
+// The capabilities clients can enable, with their names in CAP messages.
+static const struct {
+	const char* name;
+	Capability capability;
+} capabilityNames[] = {
+	{"batch", CAP_BATCH},
+	{"message-tags", CAP_MESSAGE_TAGS},
+	{"server-time", CAP_SERVER_TIME},
+	{"draft/chathistory", CAP_CHATHISTORY},
+};
+
+/**
+ * Find a capability by its name. Returns 0 if there's no such capability.
+ */
+static uint8_t findCapability(std::string_view name)
+{
+	for (const auto& known: capabilityNames)
+		if (name == known.name)
+			return known.capability;
+	return 0;
+}
+
+/**
+ * Handle a CAP message. Clients list the capabilities with CAP LS, and enable
+ * or disable some of them with CAP REQ, which are then either all acknowledged
+ * or all refused. Using either before registering holds registration off until
+ * the client sends CAP END.
+ */
+void Client::handleCap(int argc, char** argv)
+{
+	if (!checkParams("CAP", false, argc, 1, 2))
+		return;
+
+	std::string_view subcommand = argv[0];
+	std::string_view name = nick.empty() ? "*" : std::string_view(nick);
+	if (equalsIgnoreCase(subcommand, "LS")) {
+		negotiatingCaps = !isRegistered;
+		std::string list;
+		for (const auto& known: capabilityNames)
+			list += (list.empty() ? "" : " ") + std::string(known.name);
+		sendLine(":", server.getHostname(), " CAP ", name, " LS :", list);
+	} else if (equalsIgnoreCase(subcommand, "LIST")) {
+		std::string list;
+		for (const auto& known: capabilityNames)
+			if (hasCapability(known.capability))
+				list += (list.empty() ? "" : " ") + std::string(known.name);
+		sendLine(":", server.getHostname(), " CAP ", name, " LIST :", list);
+	} else if (equalsIgnoreCase(subcommand, "REQ")) {
+		if (argc < 2)
+			return sendNumeric("461", "CAP :Not enough parameters");
+		negotiatingCaps = !isRegistered;
+
+		// Work out the new set of capabilities, refusing the whole request if
+		// any of them is unknown. Names with a '-' in front are disabled.
+		std::string_view request = argv[1];
+		uint8_t enabled = capabilities;
+		bool known = true;
+		while (!request.empty()) {
+			std::string_view item = request.substr(0, request.find(' '));
+			request.remove_prefix(std::min(request.size(), item.size() + 1));
+			if (item.empty())
+				continue;
+			bool disable = item.starts_with('-');
+			uint8_t capability = findCapability(disable ? item.substr(1) : item);
+			if (capability == 0)
+				known = false;
+			else if (disable)
+				enabled &= ~capability;
+			else
+				enabled |= capability;
+		}
+		if (known)
+			capabilities = enabled;
+		sendLine(":", server.getHostname(), " CAP ", name, known ? " ACK :" : " NAK :", argv[1]);
+	} else if (equalsIgnoreCase(subcommand, "END")) {
+		if (negotiatingCaps) {
+			negotiatingCaps = false;
+			handleRegistrationComplete();
+		}
+	} else {
+		log::warn(nick, " CAP: Invalid subcommand: ", subcommand);
+		sendNumeric("410", subcommand, " :Invalid CAP command");
+	}
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <vector>
+
+#include "client.hpp"
+#include "channel.hpp"
+#include "config.hpp"
+#include "history.hpp"
+#include "utility.hpp"
+#include "server.hpp"
+
+// The CHATHISTORY subcommands, and how many references each one takes.
+static const struct {
+	const char* name;
+	HistoryQuery type;
+	int references;
+} subcommands[] = {
+	{"LATEST", HISTORY_LATEST, 1},
+	{"BEFORE", HISTORY_BEFORE, 1},
+	{"AFTER", HISTORY_AFTER, 1},
+	{"BETWEEN", HISTORY_BETWEEN, 2},
+};
+
+/**
+ * Handle a CHATHISTORY message, which fetches the recent messages of a channel
+ * the client is on. The messages are sent as they were broadcast, inside a
+ * batch if the client enabled the batch capability, and with the tags it
+ * enabled. The command only exists for clients that enabled the
+ * draft/chathistory capability.
+ */
+void Client::handleChatHistory(int argc, char** argv)
+{
+	if (!hasCapability(CAP_CHATHISTORY))
+		return sendNumeric("421", "CHATHISTORY :Unknown command");
+	if (!checkParams("CHATHISTORY", true, argc, 3, 5))
+		return;
+
+	// Find the subcommand, and check its parameters.
+	auto sendFail = [&] (const char* code, const char* message) {
+		sendLine(":", server.getHostname(), " FAIL CHATHISTORY ", code, " ", argv[0], " :", message);
+	};
+	const auto* subcommand = std::begin(subcommands);
+	while (subcommand != std::end(subcommands) && !equalsIgnoreCase(subcommand->name, argv[0]))
+		subcommand++;
+	if (subcommand == std::end(subcommands))
+		return sendFail("UNKNOWN_COMMAND", "Unknown subcommand");
+	if (argc != 3 + subcommand->references)
+		return sendFail("NEED_MORE_PARAMS", "Wrong number of parameters");
+	HistoryReference from, to;
+	int limit = 0;
+	if (!HistoryReference::parse(argv[2], from)
+		|| (from.type == HistoryReference::LATEST && subcommand->type != HISTORY_LATEST)
+		|| (subcommand->references == 2 && (!HistoryReference::parse(argv[3], to) || to.type == HistoryReference::LATEST))
+		|| !parseInt(argv[argc - 1], limit) || limit < 0)
+		return sendFail("INVALID_PARAMS", "Invalid message reference or limit");
+
+	// Only channels the client is on have a history it can see.
+	std::string_view target = argv[1];
+	Channel* channel = server.findChannelByName(target);
+	if (channel == nullptr || !isOnChannel(channel) || Config::get().historyLines == 0)
+		return sendFail("INVALID_TARGET", "Messages could not be retrieved");
+
+	// Send the messages. The list is reused between queries.
+	static std::vector<HistoryLine> lines;
+	size_t maxReplies = Config::get().historyMaxReplies;
+	size_t count = limit == 0 ? maxReplies : std::min<size_t>(limit, maxReplies);
+	channel->getHistory().query(subcommand->type, from, to, count, lines);
+	if (!hasCapability(CAP_BATCH)) {
+		for (const HistoryLine& line: lines)
+			sendHistoryLine(line);
+		return;
+	}
+	static uint64_t nextBatch = 0;
+	std::string batch = std::to_string(++nextBatch);
+	sendLine(":", server.getHostname(), " BATCH +", batch, " chathistory ", channel->getName());
+	for (const HistoryLine& line: lines)
+		sendHistoryLine(line, batch);
+	sendLine(":", server.getHostname(), " BATCH -", batch);
+}
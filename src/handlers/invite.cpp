@@ -2,6 +2,7 @@
 #include "channel.hpp"
 #include "utility.hpp"
 #include "server.hpp"
+#include "service.hpp"
 #include "irc.hpp"
 #include <cstring>
 
@@ -50,6 +51,15 @@ void Client::handleInvite(int argc, char** argv)
 	// Add the invited client to the invite list and notify them.
 	channel->addInvited(*invitedClient);
 	sendNumeric("341", invitedName, " ", channelName);
-	invitedClient->sendLine(":", fullname, " INVITE ", invitedName, " ", channelName);
+	invitedClient->sendLine(":", getFullName(), " INVITE ", invitedName, " ", channelName);
+
+	// Users on other servers are notified by their own server.
+	Client* invitedLink = invitedClient->getLink();
+	if (invitedLink != nullptr && invitedLink != link)
+		invitedLink->sendLine(":", getFullName(), " INVITE ", invitedName, " ", channelName);
 	log::info(nick, " invited ", invitedName, " to ", channelName);
+
+	// Services decide for themselves whether to accept.
+	if (Service* service = invitedClient->getService())
+		service->onInvite(*this, *channel);
 }
@@ -2,6 +2,7 @@
 
 #include "client.hpp"
 #include "channel.hpp"
+#include "config.hpp"
 #include "utility.hpp"
 #include "server.hpp"
 #include "irc.hpp"
@@ -19,6 +20,7 @@ void Client::handleJoin(int argc, char** argv)
 		log::warn(nick, " JOIN: User is not registered yet");
 		return sendNumeric("451", ":You have not registered");
 	}
+	std::string fullname = getFullName();
 
 	// If there's a single parameter "0" (without a '#' prefix), then PART all
 	// channels instead.
@@ -29,6 +31,7 @@ void Client::handleJoin(int argc, char** argv)
 		for (Channel* channel: channels) {
 			for (Client* member: channel->allMembers())
 				member->sendLine(":", fullname, " PART ", channel->getName(), " :");
+			server.propagate(":" + fullname + " PART " + std::string(channel->getName()) + " :", link);
 			channel->removeMember(*this);
 			log::info(nick, " left channel ", channel->getName());
 		}
@@ -58,18 +61,36 @@ void Client::handleJoin(int argc, char** argv)
 			channel = server.newChannel(name);
 
 		// Skip if the client is already in the channel.
-		if (channel->findClientByName(nick) != nullptr)
+		if (isOnChannel(channel))
 			continue;
 
+		// Users on other servers were already checked by their own server, and
+		// the checks could disagree while changes are still propagating.
+		bool remote = isRemote();
+
+		// Issue an error if the client has joined too many channels.
+		if (!remote && channels.size() >= Config::get().channelLimit) {
+			log::warn(nick, " JOIN: Cannot join channel, too many channels");
+			sendNumeric("405", name, " :You have joined too many channels");
+			continue;
+		}
+
+		// Issue an error if the client is banned, unless they were invited.
+		if (!remote && channel->isBanned(*this) && !channel->isInvited(*this)) {
+			log::warn(nick, " JOIN: Cannot join channel, client is banned");
+			sendNumeric("474", name, " :Cannot join channel (+b)");
+			continue;
+		}
+
 		// Issue an error message if the key doesn't match.
-		if (channel->getKey() != key) {
+		if (!remote && channel->getKey() != key) {
 			log::warn(nick, " JOIN: Cannot join channel, channel's key not match");
 			sendNumeric("475", name, " :Cannot join channel (+k)");
 			continue;
 		}
 
 		// Issue an error if the channel member limit has been reached.
-		if (channel->isFull()) {
+		if (!remote && channel->isFull()) {
 			log::warn(nick, " JOIN: Cannot join channel, channel member limit has been reached");
 			sendNumeric("471", name, " :Cannot join channel (+l)");
 			continue;
@@ -77,7 +98,7 @@ void Client::handleJoin(int argc, char** argv)
 
 		// Issue an error if the channel is invite-only, and the client hasn't
 		// been invited.
-		if (channel->isInviteOnly() && !channel->isInvited(*this)) {
+		if (!remote && channel->isInviteOnly() && !channel->isInvited(*this)) {
 			log::warn(nick, " JOIN: Cannot join channel, channel is invite-only");
 			sendNumeric("473", name, " :Cannot join channel (+i)");
 			continue;
@@ -85,7 +106,7 @@ void Client::handleJoin(int argc, char** argv)
 
 		// Join the channel.
 		channel->addMember(*this);
-		channels.insert(channel);
+		addChannel(channel);
 
 		// Send a JOIN message to the joining client.
 		sendLine(":", fullname, " JOIN ", name);
@@ -98,6 +119,13 @@ void Client::handleJoin(int argc, char** argv)
 			sendLine("MODE ", channel->getName(), " +o ", nick);
 		}
 
+		// Let other servers know. A new channel is sent along with its creation
+		// time and modes.
+		if (channel->getMemberCount() == 1 && !remote)
+			server.propagateChannelState(*channel);
+		else
+			server.propagate(":" + fullname + " JOIN " + std::string(channel->getName()), link);
+
 		// Send the topic (with timestamp) if there is one.
 		if (channel->hasTopic()) {
 			sendNumeric("332", name, " :", channel->getTopic());
@@ -107,10 +135,8 @@ void Client::handleJoin(int argc, char** argv)
 
 		// Send a list of members in the channel.
 		send(":", server.getHostname(), " 353 ", fullname, " = ", name, " :");
-		for (Client* member: channel->allMembers()) {
-			const char* prefix = channel->isOperator(*member) ? "@" : "";
-			send(prefix, member->nick, " ");
-		}
+		for (const Member& member: channel->allMemberEntries())
+			send(member.getPrefix(), member.client->nick, " ");
 		sendLine(); // Line break at the end of the member list.
 		sendNumeric("366", name, " :End of /NAMES list");
 		log::info("Sent a list of members in the channel");
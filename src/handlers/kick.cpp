@@ -1,5 +1,6 @@
 #include "client.hpp"
 #include "channel.hpp"
+#include "config.hpp"
 #include "utility.hpp"
 #include "server.hpp"
 #include "irc.hpp"
@@ -37,10 +38,12 @@ void Client::handleKick(int argc, char** argv)
 	std::string reason = argc == 3 ? argv[2] : "";
 
 	// Limit the <reason>'s length based on the KICKLEN setting.
-	if (reason.length() > KICKLEN)
-		reason.resize(KICKLEN);
+	size_t kickLength = Config::get().kickLength;
+	if (reason.length() > kickLength)
+		reason.resize(kickLength);
 
 	// Process the list of target clients to kick.
+	std::string fullname = getFullName();
 	char* targetList = argv[1];
 	while (*targetList != '\0') {
 
@@ -58,9 +61,11 @@ void Client::handleKick(int argc, char** argv)
 			member->send("KICK ", channelName, " ", targetName);
 			member->sendLine(" :", reason);
 		}
+		server.propagate(":" + fullname + " KICK " + channelName + " " + targetName + " :" + reason, link);
 
 		// Remove kicked dude.
 		channel->removeMember(*target);
+		target->removeChannel(channel);
 		log::info("KICK: ", nick, " kicked ", targetName, " from ", channelName);
 	}
 }
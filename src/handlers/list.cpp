@@ -29,7 +29,7 @@ void Client::handleList(int argc, char** argv)
 			Channel* channel = server.findChannelByName(channelName);
 			if (channel != nullptr) {
 				send(":", server.getHostname(), " 322 ");
-				send(fullname, " ", channel->getName(), " ");
+				send(getFullName(), " ", channel->getName(), " ");
 				sendLine(channel->getMemberCount(), " :", channel->getTopic());
 			}
 		}
@@ -10,11 +10,12 @@ void Client::handleLusers(int argc, char** argv)
 	if (!checkParams("LUSERS", true, argc, 0, 0))
 		return;
 
-	// Send stats about the number of clients and channels. The server doesn's
-	// support invisible users or networks, so those values are hard-coded.
-	size_t users = server.getClientCount();
+	// Send stats about the number of clients, channels and servers. The server
+	// doesn't support invisible users, so that value is hard-coded.
+	size_t users = server.getClientCount() - server.getLinkCount();
+	size_t localUsers = users - server.getRemoteClientCount();
 	size_t chans = server.getChannelCount();
-	sendNumeric("251", ":There are ", users ," users and 0 invisible on 1 servers");
+	sendNumeric("251", ":There are ", users ," users and 0 invisible on ", server.getServerCount(), " servers");
 	sendNumeric("254", chans, " :channels formed");
-	sendNumeric("255", ":I have ", users, " clients and 1 servers");
+	sendNumeric("255", ":I have ", localUsers, " clients and ", server.getLinkCount(), " servers");
 }
@@ -1,11 +1,29 @@
+#include <algorithm>
 #include <cstring>
 
 #include "client.hpp"
 #include "channel.hpp"
+#include "config.hpp"
 #include "utility.hpp"
 #include "server.hpp"
 #include "irc.hpp"
 
+/**
+ * Send the ban list (mode 'b') or ban exception list (mode 'e') of a channel.
+ */
+void Client::sendListMasks(Channel& channel, char mode)
+{
+	const char* entryNumeric = mode == 'b' ? "367" : "348";
+	for (const ListEntry& entry: channel.getListMasks(mode)) {
+		sendNumeric(entryNumeric, channel.getName(), " ", entry.mask, " ",
+			entry.setBy, " ", entry.setAt);
+	}
+	if (mode == 'b')
+		sendNumeric("368", channel.getName(), " :End of channel ban list");
+	else
+		sendNumeric("349", channel.getName(), " :End of channel exception list");
+}
+
 /**
  * Have the client change the modes for a channel.
  */
@@ -83,25 +101,56 @@ void Client::setChannelMode(Channel& channel, char* mode, char* args)
 					}
 				} break;
 
-				// +o: Give or take operator privileges from a client.
-				case 'o': {
+				// +o/+v: Give or take operator privileges or voice from a
+				// channel member.
+				case 'o':
+				case 'v': {
 					char* target = nextListItem(args);
 					Client* client = server.findClientByName(target);
 					if (client == nullptr) {
 						sendNumeric("401", target, " :No such nick/channel");
 						continue;
 					}
+					if (!channel.isMember(*client)) {
+						sendNumeric("441", target, " ", channel.getName(), " :They aren't on that channel");
+						continue;
+					}
 
 					// Skip if the mode wouldn't change.
-					if ((sign == '+') == channel.isOperator(*client))
+					bool isOp = *mode == 'o';
+					bool hasMode = isOp ? channel.isOperator(*client) : channel.isVoiced(*client);
+					if ((sign == '+') == hasMode)
 						continue;
 					if (sign == '+')
-						channel.addOperator(*client);
+						isOp ? channel.addOperator(*client) : channel.addVoice(*client);
 					if (sign == '-')
-						channel.removeOperator(*client);
+						isOp ? channel.removeOperator(*client) : channel.removeVoice(*client);
 					argsOut += " " + std::string(target);
 				} break;
 
+				// +b/+e: Add or remove a ban or ban exception mask. Without a
+				// mask, list the current masks instead.
+				case 'b':
+				case 'e': {
+					char* mask = nextListItem(args);
+					if (*mask == '\0') {
+						sendListMasks(channel, *mode);
+						continue;
+					}
+					std::string fullMask = Mask::normalize(mask);
+					if (sign == '+') {
+						if (channel.getListMasks(*mode).size() >= Config::get().maxList) {
+							sendNumeric("478", channel.getName(), " ", *mode, " :Channel list is full");
+							continue;
+						}
+						if (!channel.addListMask(*mode, fullMask, nick))
+							continue;
+					} else if (!channel.removeListMask(*mode, fullMask)) {
+						continue;
+					}
+					argsOut += " " + fullMask;
+				} break;
+
 				// Anything else is unrecognized.
 				default: {
 					 sendNumeric("502", ":Unknown MODE flag");
@@ -118,10 +167,17 @@ void Client::setChannelMode(Channel& channel, char* mode, char* args)
 	}
 
 	// Broadcast a message to all other channel members containing only the
-	// modes that were actually applied.
-	if (!modeOut.empty())
+	// modes that were actually applied. Other servers get the arguments as a
+	// comma-separated list, which is how this server parses them.
+	if (!modeOut.empty()) {
+		std::string fullname = getFullName();
 		for (Client* member: channel.allMembers())
 			member->sendLine(":", fullname, " MODE ", channel.getName(), " ", modeOut, argsOut);
+		std::string linkArgs = argsOut;
+		if (!linkArgs.empty())
+			std::replace(linkArgs.begin() + 1, linkArgs.end(), ' ', ',');
+		server.propagate(":" + fullname + " MODE " + std::string(channel.getName()) + " " + modeOut + linkArgs, link);
+	}
 }
 
 /**
@@ -145,10 +201,10 @@ void Client::handleMode(int argc, char** argv)
 		if (argc < 2)
 			return sendNumeric("324", target, " :", channel->getModes());
 
-		// Special case to keep irssi happy: Handle 'b' by sending an empty ban
-		// list for the channel.
-		if (std::strcmp(argv[1], "b") == 0)
-			return sendNumeric("368", target, " :End of channel ban list");
+		// Anyone can view the ban and exception lists, not just operators.
+		const char* query = argv[1] + (argv[1][0] == '+');
+		if (argc == 2 && (std::strcmp(query, "b") == 0 || std::strcmp(query, "e") == 0))
+			return sendListMasks(*channel, *query);
 
 		// Check that the client has channel operator privileges.
 		if (!channel->isOperator(*this))
@@ -168,7 +224,7 @@ void Client::handleMode(int argc, char** argv)
 			return sendNumeric("401", target, " :No such nick/channel");
 
 		// Check that the target matches the client's own nickname.
-		if (client->nick != target)
+		if (client != this)
 			return sendNumeric("502", ":Cant change mode for other users");
 
 		// If no mode string was given, reply with the client's current modes.
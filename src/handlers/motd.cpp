@@ -1,12 +1,13 @@
-#include <cstring>
+#include <algorithm>
 
 #include "client.hpp"
 #include "channel.hpp"
+#include "config.hpp"
 #include "utility.hpp"
 #include "server.hpp"
 #include "irc.hpp"
 
-// The hard-coded message of the day to send.
+// The message of the day to send if no MOTD file is configured.
 static const char* message = R"(
 ██╗██████╗  ██████╗███████╗██╗   ██╗███████╗███████╗███████╗██████╗ 
 ██║██╔══██╗██╔════╝██╔════╝██║   ██║██╔════╝██╔════╝██╔════╝██╔══██╗
@@ -29,12 +30,21 @@ void Client::handleMotd(int argc, char** argv)
 	if (argc == 1)
 		return sendNumeric("402", argv[0], " :No such server");
 
+	// Use the configured MOTD file, if there is one.
+	const Config& config = Config::get();
+	std::string_view text = message;
+	if (!config.motdFile.empty()) {
+		if (config.motd.empty())
+			return sendNumeric("422", ":MOTD File is missing");
+		text = config.motd;
+	}
+
 	// Send the message of the day one line at a time.
 	sendNumeric("375", ":- " SERVER_NAME " Message of the day - ");
-	for (const char* line = message; *line != '\0';) {
-		size_t length = std::strcspn(line, "\n");
-		sendNumeric("372", ":", std::string_view(line, length));
-		line += length + (line[length] == '\n');
+	while (!text.empty()) {
+		size_t length = std::min(text.find('\n'), text.length());
+		sendNumeric("372", ":", text.substr(0, length));
+		text.remove_prefix(length + (length < text.length()));
 	}
 	sendNumeric("376", ":End of /MOTD command.");
 }
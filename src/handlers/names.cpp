@@ -21,11 +21,9 @@ void Client::handleNames(int argc, char** argv)
 		if (channel != nullptr) {
 
 			// List the channel's members.
-			send(":", server.getHostname(), " 353 ", fullname, " = ", channelName, " :");
-			for (Client* member: channel->allMembers()) {
-				const char* prefix = channel->isOperator(*member) ? "@" : "";
-				send(prefix, member->nick, " ");
-			}
+			send(":", server.getHostname(), " 353 ", getFullName(), " = ", channelName, " :");
+			for (const Member& member: channel->allMemberEntries())
+				send(member.getPrefix(), member.client->nick, " ");
 			sendLine(); // End the RPL_NAMREPLY (353) numeric.
 		}
 
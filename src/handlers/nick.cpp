@@ -3,6 +3,7 @@
 
 #include "client.hpp"
 #include "channel.hpp"
+#include "config.hpp"
 #include "utility.hpp"
 #include "server.hpp"
 #include "irc.hpp"
@@ -13,7 +14,7 @@
 bool Client::isValidName(std::string_view name)
 {
 	return !name.empty()
-		&& name.length() <= NICKLEN
+		&& name.length() <= Config::get().nickLength
 		&& isValidNameString(name);
 }
 
@@ -33,7 +34,8 @@ void Client::handleNick(int argc, char** argv)
 
 	// Check that the new nick is valid and not in use.
 	std::string_view newNick = argv[0];
-	if (server.findClientByName(newNick)) {
+	Client* existing = server.findClientByName(newNick);
+	if (existing != nullptr && existing != this) {
 		log::warn(user, " NICK: Nickname is already in use: ", newNick);
 		return sendNumeric("433", newNick, " :Nickname is already in use");
 	}
@@ -45,17 +47,20 @@ void Client::handleNick(int argc, char** argv)
 	// Send a notification of the name change to the client, and to other
 	// channel members.
 	if (isRegistered) {
-		sendLine(":", fullname, " NICK ", newNick);
-		for (Channel* channel: channels)
-			for (Client* member: channel->allMembers())
-				if (member != this)
-					member->sendLine(":", fullname, " NICK ", newNick);
+		std::string message = ":" + getFullName() + " NICK " + std::string(newNick);
+		sendLine(message);
+		server.forEachNeighbour(*this, [&] (Client& neighbour) {
+			neighbour.sendLine(message);
+		});
+		server.propagate(message, link);
 	}
 
 	// Update the nick, and complete registration, if applicable.
 	bool nickAlreadySubmitted = !nick.empty();
+	server.updateNick(*this, newNick);
+	for (Channel* channel: channels)
+		channel->renameMember(*this, newNick);
 	nick = newNick;
-	fullname = nick + "!" + user + "@" + host;
 	if (!nickAlreadySubmitted)
 		handleRegistrationComplete();
 }
@@ -10,12 +10,22 @@
 void Client::handleNotice(int argc, char** argv)
 {
 	// Check registration and parameters, but without sending error messages.
-	if (!isRegistered || argc < 1 || argc > 2)
+	if (!isRegistered || argc != 2)
 		return;
 
-	// Iterate over the list of message targets.
+	// Run messages from local users through the server's filters first.
+	// Messages from other servers were filtered where they came from.
 	char* targetList = argv[0];
 	char* message = argv[1];
+	std::string filtered;
+	if (link == nullptr && service == nullptr && !server.getFilters().isEmpty()) {
+		filtered = message;
+		if (!server.filterMessage(*this, "NOTICE", targetList, filtered))
+			return;
+		message = filtered.data();
+	}
+
+	// Iterate over the list of message targets.
 	while (*targetList != '\0') {
 
 		// Check if the target is a channel.
@@ -30,15 +40,22 @@ void Client::handleNotice(int argc, char** argv)
 			}
 
 			// Check that the sender is a member of the channel.
-			if (!channel->findClientByName(nick)) {
+			if (!isOnChannel(channel)) {
 				log::warn("NOTICE: Client ", nick, " is not a member of channel ", target);
 				continue;
 			}
 
-			// Broadcast the message to all channel members.
-			for (Client* member: channel->allMembers())
-				if (member != this)
-					member->sendLine(":", fullname, " NOTICE ", target, " :", message);
+			// Check that the sender isn't banned (operators are exempt).
+			if (!channel->isOperator(*this) && channel->isBanned(*this)) {
+				log::warn("NOTICE: Client ", nick, " is banned from channel ", target);
+				continue;
+			}
+
+			// Broadcast the message to all channel members, and to the other
+			// servers with members on the channel.
+			std::string line = ":" + getFullName() + " NOTICE " + target + " :" + message;
+			server.sendToMembers(*channel, line, this);
+			server.propagateToChannel(*channel, line, link);
 
 		// Otherwise, the target is another client.
 		} else {
@@ -50,8 +67,13 @@ void Client::handleNotice(int argc, char** argv)
 				continue;
 			}
 
-			// Send the message.
-			client->sendLine(":", fullname, " NOTICE ", target, " :", message);
+			// Send the message, through the server link if the recipient is on
+			// another server.
+			Client* recipientLink = client->getLink();
+			if (recipientLink == nullptr)
+				client->sendLine(":", getFullName(), " NOTICE ", target, " :", message);
+			else if (recipientLink != link)
+				recipientLink->sendLine(":", getFullName(), " NOTICE ", target, " :", message);
 		}
 	}
 }
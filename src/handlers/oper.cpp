@@ -0,0 +1,24 @@
+#include "client.hpp"
+#include "config.hpp"
+#include "log.hpp"
+#include "server.hpp"
+
+/**
+ * Handle an OPER message. The name and password must match one of the oper
+ * entries in the configuration file.
+ */
+void Client::handleOper(int argc, char** argv)
+{
+	if (!checkParams("OPER", true, argc, 2, 2))
+		return;
+
+	for (const auto& [name, password]: Config::get().operators) {
+		if (name == argv[0] && password == argv[1]) {
+			isOper = true;
+			log::info(nick, " OPER: Became an IRC operator as ", name);
+			return sendNumeric("381", ":You are now an IRC operator");
+		}
+	}
+	log::warn(nick, " OPER: Incorrect name or password");
+	sendNumeric("464", ":Password incorrect");
+}
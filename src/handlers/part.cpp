@@ -42,13 +42,15 @@ void Client::handlePart(int argc, char** argv)
 
 		// Leave the channel and send a PART message to the client.
 		channel->removeMember(*this);
-		channels.erase(channel);
+		removeChannel(channel);
+		std::string fullname = getFullName();
 		sendLine(":", fullname, " PART ", channel->getName());
 
 		// Send PART messages to all members of the channel, with the departed
 		// client's nickname as the <source>.
 		for (Client* member: channel->allMembers())
 			member->sendLine(":", fullname, " PART ", channel->getName(), reason);
+		server.propagate(":" + fullname + " PART " + std::string(channel->getName()) + reason, link);
 		log::info(nick, " left channel ", channel->getName());
 	}
 }
@@ -19,6 +19,12 @@ void Client::handlePass(int argc, char** argv)
 		return sendNumeric("462", ":You may not reregister");
 	}
 
+	// A server link gives the link password instead, which is only accepted
+	// along with a SERVER message.
+	isLinkPassValid = server.correctLinkPassword(argv[0]);
+	if (isLinkPassValid && !server.correctPassword(argv[0]))
+		return;
+
 	// Check that the password matches.
 	if (!server.correctPassword(argv[0])) {
 		isPassValid = false;
@@ -0,0 +1,13 @@
+#include "client.hpp"
+#include "log.hpp"
+#include "server.hpp"
+
+/**
+ * Handle a PONG message. Any message from the client already counts as a reply
+ * to a keepalive PING, so there's nothing else to do.
+ */
+void Client::handlePong(int argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+}
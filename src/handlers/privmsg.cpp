@@ -2,6 +2,7 @@
 #include "channel.hpp"
 #include "utility.hpp"
 #include "server.hpp"
+#include "service.hpp"
 #include "irc.hpp"
 #include <cstring>
 
@@ -18,9 +19,19 @@ void Client::handlePrivMsg(int argc, char** argv)
 	if (argc < 2)
 		return sendNumeric("412", " :No text to send");
 
-	// Iterate over the list of message targets.
+	// Run messages from local users through the server's filters first.
+	// Messages from other servers were filtered where they came from.
 	char* targetList = argv[0];
 	char* message = argv[1];
+	std::string filtered;
+	if (link == nullptr && service == nullptr && !server.getFilters().isEmpty()) {
+		filtered = message;
+		if (!server.filterMessage(*this, "PRIVMSG", targetList, filtered))
+			return sendNumeric("404", targetList, " :Cannot send message (blocked by filter)");
+		message = filtered.data();
+	}
+
+	// Iterate over the list of message targets.
 	while (*targetList != '\0') {
 
 		// Check if the target is a channel.
@@ -36,16 +47,25 @@ void Client::handlePrivMsg(int argc, char** argv)
 			}
 
 			// Check that the sender is a member of the channel.
-			if (!channel->findClientByName(nick)) {
+			if (!isOnChannel(channel)) {
 				log::warn("PRIVMSG: Client ", nick, " is not a member of channel ", target);
 				sendNumeric("404", target, " :Cannot send to channel (not a member)");
 				continue;
 			}
 
-			// Broadcast the message to all channel members.
-			for (Client* member: channel->allMembers())
-				if (member != this)
-					member->sendLine(":", fullname, " PRIVMSG ", target, " :", message);
+			// Check that the sender isn't banned (operators are exempt).
+			if (!channel->isOperator(*this) && channel->isBanned(*this)) {
+				log::warn("PRIVMSG: Client ", nick, " is banned from channel ", target);
+				sendNumeric("404", target, " :Cannot send to channel (+b)");
+				continue;
+			}
+
+			// Broadcast the message to all channel members, and to the other
+			// servers with members on the channel.
+			std::string line = ":" + getFullName() + " PRIVMSG " + target + " :" + message;
+			server.sendToMembers(*channel, line, this);
+			server.propagateToChannel(*channel, line, link);
+			server.notifyServices(*channel, *this, message);
 
 		// Otherwise, the target is another client.
 		} else {
@@ -58,8 +78,15 @@ void Client::handlePrivMsg(int argc, char** argv)
 				continue;
 			}
 
-			// Send the message.
-			client->sendLine(":", fullname, " PRIVMSG ", target, " :", message);
+			// Send the message, through the server link if the recipient is on
+			// another server. Services are called with the message instead.
+			Client* recipientLink = client->getLink();
+			if (Service* service = client->getService())
+				service->onPrivateMessage(*this, message);
+			else if (recipientLink == nullptr)
+				client->sendLine(":", getFullName(), " PRIVMSG ", target, " :", message);
+			else if (recipientLink != link)
+				recipientLink->sendLine(":", getFullName(), " PRIVMSG ", target, " :", message);
 		}
 	}
 }
@@ -0,0 +1,22 @@
+#include "client.hpp"
+#include "config.hpp"
+#include "log.hpp"
+#include "server.hpp"
+
+/**
+ * Handle a REHASH message, which makes the server reload its configuration
+ * file. Only IRC operators may use it. The reload happens once the current
+ * batch of events is handled, and operators get a notice with the outcome.
+ */
+void Client::handleRehash(int argc, char** argv)
+{
+	(void) argv;
+	if (!checkParams("REHASH", true, argc, 0, 0))
+		return;
+
+	if (!isOper)
+		return sendNumeric("481", ":Permission Denied- You're not an IRC operator");
+	log::info(nick, " REHASH: Reloading the configuration");
+	sendNumeric("382", Config::getPath(), " :Rehashing");
+	server.requestRehash();
+}
@@ -0,0 +1,45 @@
+#include "client.hpp"
+#include "config.hpp"
+#include "log.hpp"
+#include "server.hpp"
+#include "utility.hpp"
+
+/**
+ * Handle a SERVER message, which registers the connection as a link to another
+ * server (after a PASS message with the link password). Only servers on the
+ * link_allow list can link, and none can if there's no link password.
+ */
+void Client::handleServer(int argc, char** argv)
+{
+	if (!checkParams("SERVER", false, argc, 1, 2))
+		return;
+
+	// Check that the connection isn't already registered.
+	if (isRegistered) {
+		log::warn(nick, " SERVER: Already registered");
+		return sendNumeric("462", ":You may not reregister");
+	}
+
+	// Check the link password.
+	if (Config::get().linkPassword.empty()) {
+		log::warn("SERVER: Refused link, since there's no link password");
+		return server.disconnectClient(*this, "Server links are disabled");
+	}
+	if (!isLinkPassValid) {
+		log::warn("SERVER: Link password is incorrect");
+		return server.disconnectClient(*this, "Incorrect password");
+	}
+
+	// Check that the server name is valid, and that the server isn't already
+	// part of the network.
+	std::string_view name = argv[0];
+	if (name.empty() || !isValidNameString(name)) {
+		log::warn("SERVER: Invalid server name: ", name);
+		return server.disconnectClient(*this, "Invalid server name");
+	}
+	if (!server.isLinkAllowed(name, getHost())) {
+		log::warn("SERVER: ", name, " from ", getHost(), " isn't allowed to link");
+		return server.disconnectClient(*this, "Server not allowed to link");
+	}
+	server.registerLink(*this, name);
+}
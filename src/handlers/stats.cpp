@@ -0,0 +1,27 @@
+#include "client.hpp"
+#include "filter.hpp"
+#include "server.hpp"
+
+/**
+ * Handle a STATS message. The only query is "f", which lists the message
+ * filter stages with how many messages each one checked and matched, and the
+ * time it took. It's only for IRC operators.
+ */
+void Client::handleStats(int argc, char** argv)
+{
+	if (!checkParams("STATS", true, argc, 1, 2))
+		return;
+
+	if (!isOper)
+		return sendNumeric("481", ":Permission Denied- You're not an IRC operator");
+	char query = argv[0][0];
+	if (query == 'f') {
+		for (const auto& stage: server.getFilters().getStages()) {
+			uint64_t average = stage->calls > 0 ? stage->nanoseconds / stage->calls : 0;
+			sendNumeric("249", ":f ", stage->getName(), " ", FilterPipeline::getActionName(stage->getAction()),
+				" calls=", stage->calls, " hits=", stage->hits,
+				" total=", stage->nanoseconds / 1000, "us avg=", average, "ns");
+		}
+	}
+	sendNumeric("219", query, " :End of /STATS report");
+}
@@ -1,5 +1,6 @@
 #include "client.hpp"
 #include "channel.hpp"
+#include "config.hpp"
 #include "utility.hpp"
 #include "server.hpp"
 #include "irc.hpp"
@@ -51,13 +52,16 @@ void Client::handleTopic(int argc, char** argv)
 	std::string topicText = argv[1];
 
 	// Limit the topic's length based on the TOPICLEN setting.
-	if (topicText.length() > TOPICLEN)
-		topicText.resize(TOPICLEN);
+	size_t topicLength = Config::get().topicLength;
+	if (topicText.length() > topicLength)
+		topicText.resize(topicLength);
 
 	// Change the topic.
 	channel->setTopic(topicText, *this);
 
 	// Notify all channel members (including the sender) of the change.
+	std::string fullname = getFullName();
 	for (Client* member: channel->allMembers())
 		member->sendLine(":", fullname, " TOPIC ", channel->getName(), " :", channel->getTopic());
+	server.propagate(":" + fullname + " TOPIC " + std::string(channel->getName()) + " :" + topicText, link);
 }
@@ -2,6 +2,7 @@
 
 #include "client.hpp"
 #include "channel.hpp"
+#include "config.hpp"
 #include "utility.hpp"
 #include "irc.hpp"
 
@@ -30,15 +31,12 @@ void Client::handleUser(int argc, char** argv)
 
 	// Save username and real name
 	bool userAlreadySubmitted = !user.empty() || !realname.empty();
-	user = argv[0];
+	user = std::string_view(argv[0]).substr(0, Config::get().userLength);
 	if (user.length() == 0) {
 		log::warn(nick, " USER: Attempted to register with empty user string");
 		return sendNumeric("461", "USER", " :Not enough parameters");
 	}
-	if (user.length() > USERLEN)
-		user.resize(USERLEN);
 	realname = argv[3];
-	fullname = nick + "!" + user + "@" + host;
 
 	log::info(nick, " registered USER as ", user, " (realname: ", realname, ")");
 	if (!userAlreadySubmitted)
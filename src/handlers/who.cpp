@@ -1,9 +1,54 @@
 #include "client.hpp"
 #include "channel.hpp"
+#include "config.hpp"
 #include "utility.hpp"
 #include "server.hpp"
 #include "irc.hpp"
 #include <cstring>
+#include <vector>
+
+/**
+ * Send a single WHO reply about a client. If WHOX fields were requested, an
+ * RPL_WHOSPCRPL (354) containing only those fields is sent, otherwise a normal
+ * RPL_WHOREPLY (352).
+ */
+void Client::sendWhoReply(Client& client, Channel* channel, std::string_view fields, std::string_view token)
+{
+	// Away status is not implemented, so clients are always "here".
+	std::string_view channelName = channel ? channel->getName() : "*";
+	const char* flags = channel && channel->isOperator(client) ? "H@" : "H";
+
+	// No server networks, so hop count is always zero.
+	if (fields.empty()) {
+		send(":", server.getHostname(), " 352 ", nick, " ", channelName, " ");
+		send(client.user, " ", client.host, " " SERVER_NAME " ", client.nick, " ");
+		return sendLine(flags, " :0 ", client.realname);
+	}
+
+	// WHOX fields are always sent in this order, regardless of the order they
+	// were requested in.
+	send(":", server.getHostname(), " 354 ", nick);
+	for (char field: std::string_view("tcuihsnfdlaor")) {
+		if (fields.find(field) == fields.npos)
+			continue;
+		switch (field) {
+			case 't': send(" ", token.empty() ? "0" : token); break;
+			case 'c': send(" ", channelName); break;
+			case 'u': send(" ", client.user); break;
+			case 'i': send(" ", client.host); break;
+			case 'h': send(" ", client.host); break;
+			case 's': send(" " SERVER_NAME); break;
+			case 'n': send(" ", client.nick); break;
+			case 'f': send(" ", flags); break;
+			case 'd': send(" 0"); break; // Hop count.
+			case 'l': send(" 0"); break; // Idle time.
+			case 'a': send(" 0"); break; // Accounts are not supported.
+			case 'o': send(" n/a"); break; // Neither are operator levels.
+			case 'r': send(" :", client.realname); break;
+		}
+	}
+	sendLine();
+}
 
 /**
  * Handle a WHO message.
@@ -11,34 +56,45 @@
 void Client::handleWho(int argc, char** argv)
 {
 	// Check that the correct number of parameters were given.
-	if (!checkParams("WHO", true, argc, 0, 1))
+	if (!checkParams("WHO", true, argc, 0, 2))
 		return;
 
-	// If the server doesn't support the WHO command with a <mask> parameter, it
-	// can send just an empty list.
-	if (argc == 0) {
-
-		// Send information about each client connected to the server.
-		for (auto& [_, client]: server.allClients()) {
-
-			// Get the name of one channel that this client is on, or '*' if the
-			// client is not joined to any channels.
-			std::string_view channel = "*";
-			if (!client.channels.empty())
-				channel = (*client.channels.begin())->getName();
-
-			// Send some information about the client.
-			send(":", server.getHostname(), " 351 ", nick, " ");
-			send(channel, " ");
-			send(client.user, " ");
-			send(client.host, " ");
-			send(SERVER_NAME " ");
-			send(client.nick, " ");
-			send("H "); // Away status is not implemented.
-			send(":0 "); // No server networks, so hop count is always zero.
-			sendLine(realname);
+	// A missing mask, or the mask "0", matches every client.
+	std::string_view mask = argc > 0 ? argv[0] : "*";
+	if (mask == "0")
+		mask = "*";
+
+	// Parse the optional WHOX field selection ("%<fields>[,<token>]").
+	std::string_view fields, token;
+	if (argc == 2 && argv[1][0] == '%') {
+		fields = argv[1] + 1;
+		size_t comma = fields.find(',');
+		if (comma != fields.npos) {
+			token = fields.substr(comma + 1, 3); // Tokens are at most 3 digits.
+			fields = fields.substr(0, comma);
+		}
+	}
+
+	// For a channel, only the channel's own members are listed.
+	if (Channel::isValidName(mask)) {
+		Channel* channel = server.findChannelByName(mask);
+		if (channel != nullptr)
+			for (Client* member: channel->allMembers())
+				sendWhoReply(*member, channel, fields, token);
+
+	// Otherwise, look up the clients matching the mask in the server's nick
+	// and host indexes. The number of replies is capped, so that wide masks
+	// can't be used to dump the whole server.
+	} else {
+		std::vector<Client*> matches;
+		server.findClientsByMask(mask, matches, Config::get().whoMaxReplies);
+		for (Client* client: matches) {
+			Channel* channel = nullptr;
+			if (!client->channels.empty())
+				channel = client->channels.front();
+			sendWhoReply(*client, channel, fields, token);
 		}
 	}
-	sendNumeric("315", argv[0], " :End of WHO list");
-	log::info(nick, " WHO: Sent some information about the client");
+	sendNumeric("315", mask, " :End of WHO list");
+	log::info(nick, " WHO: Sent information about clients matching ", mask);
 }
@@ -0,0 +1,278 @@
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "channel.hpp"
+#include "client.hpp"
+#include "config.hpp"
+#include "irc.hpp"
+#include "server.hpp"
+#include "service.hpp"
+#include "state.hpp"
+#include "utility.hpp"
+
+// Maximum number of file descriptors passed in a single message (the kernel's
+// limit, SCM_MAX_FD, is 253).
+static constexpr size_t FD_BATCH = 250;
+
+// Milliseconds to wait for the new process to confirm that it took over.
+static constexpr int HANDOVER_TIMEOUT = 10000;
+
+/**
+ * Write a whole buffer to a blocking socket.
+ */
+static void writeAll(int socket, const void* data, size_t size)
+{
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0) {
+		ssize_t written = write(socket, bytes, size);
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written == -1)
+			fail("Failed to write hand-over data: ", strerror(errno));
+		bytes += written;
+		size -= written;
+	}
+}
+
+/**
+ * Read a whole buffer from a blocking socket.
+ */
+static void readAll(int socket, void* data, size_t size)
+{
+	char* bytes = static_cast<char*>(data);
+	while (size > 0) {
+		ssize_t bytesRead = read(socket, bytes, size);
+		if (bytesRead == -1 && errno == EINTR)
+			continue;
+		if (bytesRead == -1)
+			fail("Failed to read hand-over data: ", strerror(errno));
+		if (bytesRead == 0)
+			fail("Hand-over connection closed early");
+		bytes += bytesRead;
+		size -= bytesRead;
+	}
+}
+
+/**
+ * Pass a batch of file descriptors over a Unix socket (using SCM_RIGHTS),
+ * attached to a single byte of ordinary data.
+ */
+static void sendFds(int socket, const int* fds, size_t count)
+{
+	char byte = 0;
+	struct iovec iov = {&byte, 1};
+	alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * FD_BATCH)] = {};
+	struct msghdr message = {};
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+	struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+	std::memcpy(CMSG_DATA(header), fds, sizeof(int) * count);
+	if (sendmsg(socket, &message, 0) != 1)
+		fail("Failed to pass file descriptors: ", strerror(errno));
+}
+
+/**
+ * Receive a batch of file descriptors sent with sendFds. The received file
+ * descriptors are marked close-on-exec, like all the server's sockets.
+ */
+static void receiveFds(int socket, int* fds, size_t count)
+{
+	char byte;
+	struct iovec iov = {&byte, 1};
+	alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * FD_BATCH)] = {};
+	struct msghdr message = {};
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+	if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) != 1)
+		fail("Failed to receive file descriptors: ", strerror(errno));
+	struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+	if (header == nullptr || header->cmsg_type != SCM_RIGHTS
+		|| header->cmsg_len != CMSG_LEN(sizeof(int) * count))
+		fail("Unexpected file descriptor message");
+	std::memcpy(fds, CMSG_DATA(header), sizeof(int) * count);
+}
+
+/**
+ * Hand the whole server over to a new process running the same executable
+ * (which may have been replaced on disk by a newer version). The new process
+ * receives the listening sockets and every client connection over a Unix
+ * socket, along with the serialized state of all clients and channels, and
+ * carries on from where this process left off, so clients don't notice the
+ * restart. Returns true if the new process took over, in which case this
+ * process should exit without closing any connections. If anything fails,
+ * the new process is killed and this one keeps serving.
+ */
+bool Server::handOver()
+{
+	log::info("Handing over to a new server process");
+
+	// Server links aren't handed over. Closing them first tells local users
+	// that the users behind them are gone, and the links are opened again by
+	// whichever server opened them originally.
+	for (Client* link: std::vector<Client*>(links))
+		disconnectClient(*link, "Server restarting");
+	journal.flush();
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) == -1) {
+		log::error("Hand-over failed: socketpair(): ", strerror(errno));
+		return false;
+	}
+
+	// Start the new process. Only its end of the socket pair survives exec,
+	// since all other sockets are close-on-exec.
+	pid_t pid = fork();
+	if (pid == -1) {
+		log::error("Hand-over failed: fork(): ", strerror(errno));
+		close(sockets[0]);
+		close(sockets[1]);
+		return false;
+	}
+	if (pid == 0) {
+		fcntl(sockets[1], F_SETFD, 0);
+		setenv(HANDOVER_ENV, std::to_string(sockets[1]).c_str(), 1);
+		std::string configPath = Config::getPath();
+		if (configPath != CONFIG_FILE)
+			execl("/proc/self/exe", "ircserv", "-c", configPath.c_str(), port.c_str(), password.c_str(), nullptr);
+		else
+			execl("/proc/self/exe", "ircserv", port.c_str(), password.c_str(), nullptr);
+		_exit(EXIT_FAILURE);
+	}
+	close(sockets[1]);
+
+	try {
+		// Serialize the state of all clients. Clients are referred to by their
+		// index in the list of passed file descriptors, which starts with the
+		// listening sockets.
+		StateWriter out;
+		std::vector<int> fds;
+		std::unordered_map<const Client*, int64_t> indexes;
+		out.writeString(launchTime);
+		out.writeInt(listeners.size());
+		for (const Listener& listener: listeners) {
+			fds.push_back(listener.fd);
+			out.writeString(listener.address);
+		}
+		std::vector<Client*> saved;
+		for (auto& [fd, client]: clients)
+			if (fd >= 0 && !client.isDisconnected())
+				saved.push_back(&client);
+		out.writeInt(saved.size());
+		for (Client* client: saved) {
+			indexes[client] = indexes.size();
+			fds.push_back(client->getSocket());
+			out.writeString(client->getHost());
+			client->saveState(out);
+		}
+
+		// Services are started again by the new process, so only their
+		// nicknames are saved, to restore their places on channels.
+		out.writeInt(services.size());
+		for (const std::unique_ptr<Service>& service: services) {
+			indexes[&service->getClient()] = indexes.size();
+			out.writeString(service->getClient().getNick());
+		}
+
+		// Serialize the state of all channels.
+		out.writeInt(channels.size());
+		for (auto& [_, channel]: channels) {
+			out.writeString(channel.getName());
+			out.writeInt(channel.isDormant());
+			channel.saveState(out, indexes);
+		}
+
+		// Send the state, then the file descriptors.
+		const std::string& data = out.getData();
+		int64_t header[2] = {static_cast<int64_t>(data.size()), static_cast<int64_t>(fds.size())};
+		writeAll(sockets[0], header, sizeof(header));
+		writeAll(sockets[0], data.data(), data.size());
+		for (size_t i = 0; i < fds.size(); i += FD_BATCH)
+			sendFds(sockets[0], &fds[i], std::min(FD_BATCH, fds.size() - i));
+
+		// Wait for the new process to confirm that it took over.
+		struct pollfd pollFd = {sockets[0], POLLIN, 0};
+		char reply = 0;
+		if (poll(&pollFd, 1, HANDOVER_TIMEOUT) != 1 || read(sockets[0], &reply, 1) != 1 || reply != 'K')
+			fail("New process didn't confirm the hand-over");
+
+	// Give up on the new process if anything went wrong.
+	} catch (...) {
+		log::error("Hand-over failed, continuing with the current process");
+		kill(pid, SIGKILL);
+		waitpid(pid, nullptr, 0);
+		close(sockets[0]);
+		return false;
+	}
+	close(sockets[0]);
+	handedOver = true;
+	log::info("Hand-over complete, process ", pid, " took over");
+	return true;
+}
+
+/**
+ * Take over the state and connections of a previous server process, sent by
+ * handOver() over the given socket. Must be called before the event loop.
+ */
+void Server::resume(int socket)
+{
+	log::info("Resuming the state of a previous server process");
+
+	// Receive the state and the file descriptors.
+	int64_t header[2];
+	readAll(socket, header, sizeof(header));
+	std::string data(header[0], '\0');
+	readAll(socket, data.data(), data.size());
+	std::vector<int> fds(header[1]);
+	for (size_t i = 0; i < fds.size(); i += FD_BATCH)
+		receiveFds(socket, &fds[i], std::min(FD_BATCH, fds.size() - i));
+
+	// Restore the listening sockets, then the clients and services.
+	StateReader in(data);
+	launchTime = in.readString();
+	for (int64_t count = in.readInt(); count > 0; count--)
+		listeners.push_back({std::string(in.readString()), "default", fds.at(listeners.size())});
+	std::vector<Client*> restored;
+	for (int64_t count = in.readInt(); count > 0; count--) {
+		int fd = fds.at(listeners.size() + restored.size());
+		Client& client = newClient(fd, in.readString());
+		client.restoreState(in);
+		restored.push_back(&client);
+	}
+
+	// Start the services, and match them up with the saved ones. Services that
+	// were removed from the configuration in the meantime are left out of the
+	// channels.
+	openServices();
+	for (int64_t count = in.readInt(); count > 0; count--) {
+		Client* service = findClientByName(in.readString());
+		restored.push_back(service != nullptr && service->getService() != nullptr ? service : nullptr);
+	}
+
+	// Restore the channels.
+	for (int64_t count = in.readInt(); count > 0; count--) {
+		std::string name(in.readString());
+		Channel& channel = channels.try_emplace(foldCase(name), name, &journal).first->second;
+		channel.setDormant(in.readInt());
+		channel.restoreState(in, restored);
+	}
+	if (!in.isAtEnd())
+		fail("Unexpected data at the end of the hand-over state");
+
+	// Let the previous process know it can exit.
+	writeAll(socket, "K", 1);
+	close(socket);
+	log::info("Resumed ", clients.size(), " clients and ", channels.size(), " channels");
+}
@@ -0,0 +1,506 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "clock.hpp"
+#include "config.hpp"
+#include "history.hpp"
+#include "log.hpp"
+#include "utility.hpp"
+
+// Identifies a history segment file, and the version of its format.
+static constexpr char SEGMENT_MAGIC[8] = {'i', 'r', 'c', 'h', 'i', 's', 't', '1'};
+
+// Longest tags added to a line: "@time=" with a 24-character timestamp, and
+// ";msgid=" with up to 16 hex digits, followed by a space.
+static constexpr size_t MAX_TAG_LENGTH = 6 + 24 + 7 + 16 + 1;
+
+// In place of a record's length, marks the end of the data before the segment
+// wraps around to the start.
+static constexpr uint32_t WRAP_MARKER = UINT32_MAX;
+
+// The ID for the next message. It's kept at or above the time in microseconds,
+// so IDs keep increasing across restarts.
+static uint64_t nextMsgid = 0;
+
+// The start of a segment file, followed by its data area. Positions count
+// bytes ever written, and the data is at the position modulo the capacity.
+struct SegmentHeader
+{
+	char magic[8];
+	uint64_t capacity;		// Size of the data area
+	uint64_t head;			// Position of the oldest record
+	uint64_t tail;			// Position after the newest record
+};
+
+// A message in a segment, followed by its line, padded to a multiple of 8
+// bytes so that every record is aligned.
+struct SegmentRecord
+{
+	uint32_t length;		// Length of the line, or WRAP_MARKER
+	uint32_t tagLength;
+	uint64_t msgid;
+	int64_t time;
+};
+
+/**
+ * A channel's older messages, in a file mapped into memory and used as a ring
+ * of records. New records overwrite the oldest ones once the file is full.
+ * Since the mapping is shared, the file is up to date as soon as a record is
+ * written, without any further I/O. The positions of the records are kept in
+ * memory too, so that any of them can be found without reading the others.
+ */
+class HistorySegment
+{
+public:
+	HistorySegment(const std::string& path, size_t capacity)
+		: path(path), capacity(capacity & ~size_t(7))
+	{
+		// Make the file the right size for the capacity.
+		int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd == -1) {
+			log::warn("Failed to open history segment ", path, ": ", strerror(errno));
+			return;
+		}
+		size_t size = sizeof(SegmentHeader) + this->capacity;
+		struct stat status;
+		if (fstat(fd, &status) == -1 || (static_cast<size_t>(status.st_size) != size && ftruncate(fd, size) == -1)) {
+			log::warn("Failed to resize history segment ", path, ": ", strerror(errno));
+			close(fd);
+			return;
+		}
+		void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (mapping == MAP_FAILED) {
+			log::warn("Failed to map history segment ", path, ": ", strerror(errno));
+			return;
+		}
+		header = static_cast<SegmentHeader*>(mapping);
+		data = static_cast<char*>(mapping) + sizeof(SegmentHeader);
+
+		// Start over if the file is new, or doesn't look like a segment of
+		// this capacity.
+		if (std::memcmp(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0
+			|| header->capacity != this->capacity || header->head > header->tail
+			|| header->tail - header->head > this->capacity || header->head % 8 != 0) {
+			std::memcpy(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+			header->capacity = this->capacity;
+			header->head = 0;
+			header->tail = 0;
+		}
+		findRecords();
+	}
+
+	~HistorySegment()
+	{
+		if (header != nullptr)
+			munmap(header, sizeof(SegmentHeader) + capacity);
+	}
+
+	HistorySegment(const HistorySegment&) = delete;
+	HistorySegment& operator=(const HistorySegment&) = delete;
+
+	/**
+	 * Check whether the segment is usable, or failed to open.
+	 */
+	bool isOpen() const
+	{
+		return header != nullptr;
+	}
+
+	/**
+	 * Check whether this is the segment for a file and capacity.
+	 */
+	bool isFor(const std::string& otherPath, size_t otherCapacity) const
+	{
+		return path == otherPath && capacity == (otherCapacity & ~size_t(7));
+	}
+
+	/**
+	 * Add a message as the newest record, removing the oldest records to make
+	 * room. Records that don't fit before the end of the data area start over
+	 * at the beginning, leaving a marker where they would have been.
+	 */
+	void append(const HistoryLine& line)
+	{
+		size_t size = getRecordSize(line.line.size());
+		if (size > capacity)
+			return;
+		size_t skip;
+		while (true) {
+			size_t offset = header->tail % capacity;
+			skip = offset + size > capacity ? capacity - offset : 0;
+			if (header->tail + skip + size - header->head <= capacity)
+				break;
+			if (header->head == header->tail)
+				header->head = header->tail = 0;
+			else
+				removeOldest();
+		}
+		if (skip > 0) {
+			std::memcpy(data + header->tail % capacity, &WRAP_MARKER, sizeof(WRAP_MARKER));
+			header->tail += skip;
+		}
+		char* record = data + header->tail % capacity;
+		SegmentRecord fields = {static_cast<uint32_t>(line.line.size()), line.tagLength, line.msgid, line.time};
+		std::memcpy(record, &fields, sizeof(fields));
+		std::memcpy(record + sizeof(fields), line.line.data(), line.line.size());
+		positions.push_back(header->tail);
+		header->tail += size;
+	}
+
+	/**
+	 * Get the number of messages in the segment.
+	 */
+	size_t getCount() const
+	{
+		return positions.size();
+	}
+
+	/**
+	 * Get a message by its index, counting from the oldest. The line points
+	 * into the mapped file.
+	 */
+	HistoryLine getLine(size_t index) const
+	{
+		const char* record = data + positions[index] % capacity;
+		SegmentRecord fields;
+		std::memcpy(&fields, record, sizeof(fields));
+		return {fields.msgid, fields.time, fields.tagLength, {record + sizeof(fields), fields.length}};
+	}
+
+private:
+	/**
+	 * Get the size of the record for a line of the given length.
+	 */
+	static size_t getRecordSize(size_t length)
+	{
+		return (sizeof(SegmentRecord) + length + 7) & ~size_t(7);
+	}
+
+	/**
+	 * Find the records in the file, when it's opened. A marker can be in the
+	 * last 8 bytes of the data area, so only the length is read before
+	 * checking for one. If a record doesn't fit, the file was damaged, and
+	 * the records from there on are dropped.
+	 */
+	void findRecords()
+	{
+		for (uint64_t position = header->head; position < header->tail;) {
+			size_t offset = position % capacity;
+			uint32_t length;
+			std::memcpy(&length, data + offset, sizeof(length));
+			if (length == WRAP_MARKER) {
+				position += capacity - offset;
+				continue;
+			}
+			SegmentRecord fields;
+			if (offset + getRecordSize(length) > capacity
+				|| (std::memcpy(&fields, data + offset, sizeof(fields)), fields.tagLength > length)) {
+				header->tail = position;
+				break;
+			}
+			positions.push_back(position);
+			position += getRecordSize(length);
+		}
+	}
+
+	/**
+	 * Remove the oldest record, or the marker at the end of the data.
+	 */
+	void removeOldest()
+	{
+		size_t offset = header->head % capacity;
+		uint32_t length;
+		std::memcpy(&length, data + offset, sizeof(length));
+		if (length != WRAP_MARKER)
+			positions.pop_front();
+		header->head += length == WRAP_MARKER ? capacity - offset : getRecordSize(length);
+		header->head = std::min(header->head, header->tail);
+	}
+
+	std::string path;						// Path of the segment file
+	size_t capacity;						// Size of the data area
+	SegmentHeader* header = nullptr;		// The mapped file, if it could be opened
+	char* data = nullptr;					// The data area, after the header
+	std::deque<uint64_t> positions;			// Positions of the records, oldest first
+};
+
+/**
+ * Parse a timestamp in the ISO 8601 format used by server-time, such as
+ * "2024-01-31T12:34:56.789Z", into Unix milliseconds.
+ */
+static bool parseTimestamp(std::string_view string, int64_t& time)
+{
+	struct tm utc = {};
+	int consumed = 0;
+	std::string copy(string);
+	if (sscanf(copy.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%n", &utc.tm_year, &utc.tm_mon, &utc.tm_mday,
+		&utc.tm_hour, &utc.tm_min, &utc.tm_sec, &consumed) != 6)
+		return false;
+	std::string_view rest = string.substr(consumed);
+	int milliseconds = 0;
+	if (rest.starts_with('.')) {
+		auto [end, error] = std::from_chars(rest.data() + 1, rest.data() + rest.size(), milliseconds);
+		if (error != std::errc() || end != rest.data() + 4)
+			return false;
+		rest.remove_prefix(4);
+	}
+	if (rest != "Z")
+		return false;
+	utc.tm_year -= 1900;
+	utc.tm_mon -= 1;
+	time = static_cast<int64_t>(timegm(&utc)) * 1000 + milliseconds;
+	return true;
+}
+
+/**
+ * Parse a CHATHISTORY message reference: "*", "msgid=<id>" or
+ * "timestamp=<time>".
+ */
+bool HistoryReference::parse(std::string_view string, HistoryReference& reference)
+{
+	reference = HistoryReference();
+	if (string == "*")
+		return true;
+	if (string.starts_with("msgid=")) {
+		reference.type = MSGID;
+		const char* end = string.data() + string.size();
+		auto [last, error] = std::from_chars(string.data() + 6, end, reference.msgid, 16);
+		return error == std::errc() && last == end;
+	}
+	if (string.starts_with("timestamp=")) {
+		reference.type = TIMESTAMP;
+		return parseTimestamp(string.substr(10), reference.time);
+	}
+	return false;
+}
+
+/**
+ * Create the history for a channel.
+ */
+History::History(std::string_view channelName)
+	: name(foldCase(channelName))
+{
+}
+
+/**
+ * Add a message to the history, tagged with the current time and a new
+ * message ID, and return the tagged line. The line must not end in "\r\n",
+ * which is added. Lines are still tagged when history_lines is 0, but they're
+ * not kept after the next message.
+ */
+HistoryLine History::add(std::string_view line)
+{
+	nextMsgid = std::max(nextMsgid, static_cast<uint64_t>(Clock::getMilliseconds()) * 1000);
+	const Config& config = Config::get();
+	Entry& entry = push(config, line.size() + MAX_TAG_LENGTH);
+	entry.msgid = nextMsgid++;
+	entry.time = Clock::getMilliseconds();
+
+	// Build the line in the entry's buffer, which usually has room for it.
+	char msgid[16];
+	char* msgidEnd = std::to_chars(msgid, msgid + sizeof(msgid), entry.msgid, 16).ptr;
+	entry.line.assign("@time=");
+	entry.line += Clock::getIsoTime();
+	entry.line += ";msgid=";
+	entry.line.append(msgid, msgidEnd);
+	entry.line += ' ';
+	entry.tagLength = entry.line.size();
+	entry.line += line;
+	entry.line += "\r\n";
+	if (&entry != &scratch)
+		bytes += entry.line.size();
+	return {entry.msgid, entry.time, entry.tagLength, entry.line};
+}
+
+/**
+ * Make room in the ring for a message of about the given length, and return
+ * the entry for it. The ring grows until it has history_lines entries, and
+ * older messages are removed to stay within history_lines and history_bytes.
+ */
+History::Entry& History::push(const Config& config, size_t length)
+{
+	if (config.historyLines == 0) {
+		while (count > 0)
+			evict();
+		entries.clear();
+		return scratch;
+	}
+	while (count > 0 && (count >= config.historyLines || bytes + length > config.historyBytes))
+		evict();
+
+	// Put the oldest message first before resizing the ring, which happens
+	// when it's full but below the limit, or history_lines was lowered.
+	if (count == entries.size() || entries.size() > config.historyLines) {
+		std::rotate(entries.begin(), entries.begin() + first, entries.end());
+		first = 0;
+		entries.resize(std::min(count + 1, config.historyLines));
+	}
+	count++;
+	return entries[(first + count - 1) % entries.size()];
+}
+
+/**
+ * Remove the oldest message from the ring, moving it to the channel's segment
+ * file if there is one.
+ */
+void History::evict()
+{
+	Entry& oldest = entries[first];
+	if (HistorySegment* spill = getSegment(Config::get()))
+		spill->append({oldest.msgid, oldest.time, oldest.tagLength, oldest.line});
+	bytes -= oldest.line.size();
+	first = (first + 1) % entries.size();
+	count--;
+}
+
+/**
+ * Get the segment file for the channel, opening it if history_spill_dir or
+ * history_spill_size changed. Returns a null pointer if older messages aren't
+ * kept, or the file can't be used.
+ */
+HistorySegment* History::getSegment(const Config& config)
+{
+	if (config.historySpillDir.empty()) {
+		segment.reset();
+		return nullptr;
+	}
+
+	// Segment files are named after the channel in hex, since channel names
+	// can have characters that aren't allowed in file names.
+	std::string path = config.historySpillDir + "/";
+	for (unsigned char c: name) {
+		path += "0123456789abcdef"[c >> 4];
+		path += "0123456789abcdef"[c & 15];
+	}
+	path += ".hist";
+	if (segment == nullptr || !segment->isFor(path, config.historySpillSize))
+		segment = std::make_shared<HistorySegment>(path, config.historySpillSize);
+	return segment->isOpen() ? segment.get() : nullptr;
+}
+
+/**
+ * Find the messages for a CHATHISTORY query, up to `limit` of them, and put
+ * them in a list, oldest first. The messages in the segment file come before
+ * those in the ring, and message IDs and times both increase through them, so
+ * the references are found by binary search, and only the messages that are
+ * returned are read. The lines point into the history, so they're only valid
+ * until the next message is added.
+ */
+void History::query(HistoryQuery type, const HistoryReference& from, const HistoryReference& to,
+	size_t limit, std::vector<HistoryLine>& result)
+{
+	result.clear();
+	HistorySegment* spill = getSegment(Config::get());
+	size_t spilled = spill != nullptr ? spill->getCount() : 0;
+	auto getLine = [&] (size_t index) -> HistoryLine {
+		if (index < spilled)
+			return spill->getLine(index);
+		const Entry& entry = entries[(first + index - spilled) % entries.size()];
+		return {entry.msgid, entry.time, entry.tagLength, entry.line};
+	};
+
+	// Find where a reference falls in the history: the index of the first
+	// message at or after it (findBefore), or the first message after it
+	// (findAfter).
+	auto search = [&] (const HistoryReference& reference, bool inclusive) {
+		size_t low = 0;
+		size_t high = spilled + count;
+		while (low < high) {
+			size_t middle = low + (high - low) / 2;
+			HistoryLine line = getLine(middle);
+			bool past = reference.type == HistoryReference::MSGID
+				? (inclusive ? line.msgid >= reference.msgid : line.msgid > reference.msgid)
+				: (inclusive ? line.time >= reference.time : line.time > reference.time);
+			if (past)
+				high = middle;
+			else
+				low = middle + 1;
+		}
+		return low;
+	};
+	auto findBefore = [&] (const HistoryReference& reference) { return search(reference, true); };
+	auto findAfter = [&] (const HistoryReference& reference) { return search(reference, false); };
+
+	// Pick the range of messages, and whether the limit keeps the latest or
+	// the earliest of them.
+	size_t begin = 0;
+	size_t end = spilled + count;
+	bool keepLatest = true;
+	switch (type) {
+		case HISTORY_LATEST: {
+			if (from.type != HistoryReference::LATEST)
+				begin = findAfter(from);
+		} break;
+		case HISTORY_BEFORE: {
+			end = findBefore(from);
+		} break;
+		case HISTORY_AFTER: {
+			begin = findAfter(from);
+			keepLatest = false;
+		} break;
+		case HISTORY_BETWEEN: {
+			if (findAfter(from) <= findBefore(to)) {
+				begin = findAfter(from);
+				end = findBefore(to);
+				keepLatest = false;
+			} else {
+				begin = findAfter(to);
+				end = findBefore(from);
+			}
+		} break;
+	}
+	end = std::max(begin, end);
+	if (end - begin > limit) {
+		if (keepLatest)
+			begin = end - limit;
+		else
+			end = begin + limit;
+	}
+	for (size_t i = begin; i < end; i++)
+		result.push_back(getLine(i));
+}
+
+/**
+ * Serialize the messages in the ring for handing them over to a new server
+ * process. The segment file is left for the new process to open.
+ */
+void History::saveState(StateWriter& out) const
+{
+	out.writeInt(count);
+	for (size_t i = 0; i < count; i++) {
+		const Entry& entry = entries[(first + i) % entries.size()];
+		out.writeInt(entry.msgid);
+		out.writeInt(entry.time);
+		out.writeInt(entry.tagLength);
+		out.writeString(entry.line);
+	}
+}
+
+/**
+ * Restore the messages in the ring from a previous server process. New message
+ * IDs continue after the restored ones.
+ */
+void History::restoreState(StateReader& in)
+{
+	entries.clear();
+	first = 0;
+	bytes = 0;
+	count = in.readInt();
+	for (size_t i = 0; i < count; i++) {
+		Entry& entry = entries.emplace_back();
+		entry.msgid = in.readInt();
+		entry.time = in.readInt();
+		entry.tagLength = in.readInt();
+		entry.line = in.readString();
+		bytes += entry.line.size();
+		nextMsgid = std::max(nextMsgid, entry.msgid + 1);
+	}
+}
@@ -0,0 +1,89 @@
+#include <unordered_map>
+
+#include "interned.hpp"
+
+// Hash and comparison that let the table be searched with a string_view,
+// without making a std::string first.
+struct StringHash
+{
+	using is_transparent = void;
+	size_t operator()(std::string_view string) const { return std::hash<std::string_view>()(string); }
+};
+
+// All interned strings, with the number of handles to each one.
+static std::unordered_map<std::string, size_t, StringHash, std::equal_to<>> table;
+
+InternedString::InternedString(std::string_view string)
+{
+	*this = string;
+}
+
+InternedString::InternedString(const InternedString& other)
+	: entry(other.entry)
+{
+	if (entry)
+		entry->second++;
+}
+
+InternedString& InternedString::operator=(const InternedString& other)
+{
+	if (other.entry)
+		other.entry->second++;
+	release();
+	entry = other.entry;
+	return *this;
+}
+
+InternedString& InternedString::operator=(std::string_view string)
+{
+	Entry* newEntry = nullptr;
+	if (!string.empty()) {
+		auto found = table.find(string);
+		if (found == table.end())
+			found = table.emplace(string, 0).first;
+		newEntry = &*found;
+		newEntry->second++;
+	}
+	release();
+	entry = newEntry;
+	return *this;
+}
+
+InternedString::~InternedString()
+{
+	release();
+}
+
+/**
+ * Drop the handle's reference to its string, removing the string from the
+ * table if nothing else refers to it.
+ */
+void InternedString::release()
+{
+	if (entry && --entry->second == 0)
+		table.erase(table.find(entry->first));
+	entry = nullptr;
+}
+
+InternedString::operator std::string_view() const
+{
+	return entry ? std::string_view(entry->first) : std::string_view();
+}
+
+bool InternedString::empty() const
+{
+	return entry == nullptr;
+}
+
+size_t InternedString::size() const
+{
+	return entry ? entry->first.size() : 0;
+}
+
+/**
+ * Get the number of distinct strings in the table.
+ */
+size_t InternedString::getTableSize()
+{
+	return table.size();
+}
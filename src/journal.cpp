@@ -0,0 +1,203 @@
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.hpp"
+#include "irc.hpp"
+#include "journal.hpp"
+#include "log.hpp"
+#include "utility.hpp"
+
+// Identifies a snapshot file, and the version of its format.
+static constexpr std::string_view SNAPSHOT_MAGIC = "ircserv-channels-1";
+
+/**
+ * A read-only memory mapping of a whole file. Files that don't exist or are
+ * empty give an empty mapping.
+ */
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& path)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+			return;
+		struct stat status;
+		if (fstat(fd, &status) == 0 && status.st_size > 0) {
+			void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+			if (data != MAP_FAILED)
+				contents = std::string_view(static_cast<char*>(data), status.st_size);
+		}
+		close(fd);
+	}
+
+	~MappedFile()
+	{
+		if (!contents.empty())
+			munmap(const_cast<char*>(contents.data()), contents.size());
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	std::string_view contents;	// The mapped file contents
+};
+
+/**
+ * Write any pending records before closing the journal.
+ */
+Journal::~Journal()
+{
+	flush();
+	safeClose(fd);
+}
+
+/**
+ * Open the journal file for appending, creating it if needed.
+ */
+void Journal::open(std::string_view journalFile, std::string_view snapshotFile)
+{
+	journalPath = journalFile;
+	snapshotPath = snapshotFile;
+	fd = ::open(journalPath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		log::warn("Failed to open journal ", journalPath, ": ", strerror(errno),
+			" (channel state won't be saved)");
+		return;
+	}
+	struct stat status;
+	if (fstat(fd, &status) == 0)
+		size = status.st_size;
+}
+
+/**
+ * Check if the journal is open, meaning that changes are being saved.
+ */
+bool Journal::isOpen() const
+{
+	return fd != -1;
+}
+
+/**
+ * Append all pending records to the journal file. Called once per iteration
+ * of the event loop. Appending to a regular file only copies the data into
+ * the page cache, so this doesn't wait for the disk.
+ */
+void Journal::flush()
+{
+	const std::string& data = pending.getData();
+	if (fd == -1 || data.empty())
+		return;
+	ssize_t written = write(fd, data.data(), data.size());
+	if (written != static_cast<ssize_t>(data.size()))
+		log::error("Failed to write journal ", journalPath, ": ", strerror(errno));
+	else
+		size += written;
+	pending.clear();
+}
+
+/**
+ * Check if the journal has grown large enough that it should be compacted.
+ */
+bool Journal::needsCompaction() const
+{
+	return fd != -1 && size >= Config::get().journalCompactSize;
+}
+
+/**
+ * Replace the snapshot with a new one containing the current state of all
+ * channels, and empty the journal. The new snapshot is written to a temporary
+ * file which is then renamed over the old one, so there's always a complete
+ * snapshot on disk. If the server dies before the journal is emptied, the old
+ * records are replayed on top of the new snapshot, which gives the same result
+ * since every record sets a value rather than modifying one.
+ */
+void Journal::compact(const StateWriter& snapshot)
+{
+	if (fd == -1)
+		return;
+
+	// Records that haven't been written yet are already part of the snapshot.
+	pending.clear();
+
+	// Write the snapshot to a temporary file.
+	std::string temporaryPath = snapshotPath + ".tmp";
+	int snapshotFd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (snapshotFd == -1) {
+		log::error("Failed to create snapshot ", temporaryPath, ": ", strerror(errno));
+		return;
+	}
+	StateWriter header;
+	header.writeString(SNAPSHOT_MAGIC);
+	const std::string& data = snapshot.getData();
+	bool ok = write(snapshotFd, header.getData().data(), header.getData().size())
+			== static_cast<ssize_t>(header.getData().size())
+		&& write(snapshotFd, data.data(), data.size()) == static_cast<ssize_t>(data.size())
+		&& fsync(snapshotFd) == 0;
+	close(snapshotFd);
+	if (!ok || rename(temporaryPath.c_str(), snapshotPath.c_str()) == -1) {
+		log::error("Failed to write snapshot ", snapshotPath, ": ", strerror(errno));
+		unlink(temporaryPath.c_str());
+		return;
+	}
+
+	// Start over with an empty journal.
+	if (ftruncate(fd, 0) == -1)
+		log::error("Failed to truncate journal ", journalPath, ": ", strerror(errno));
+	else
+		size = 0;
+	log::info("Compacted journal into snapshot ", snapshotPath, " (", data.size(), " bytes)");
+}
+
+/**
+ * Load the saved channel state. The snapshot is read directly from a memory
+ * mapping, and then every record in the journal is replayed. An incomplete
+ * record at the end of the journal (from the server dying in the middle of a
+ * write) is cut off, so that new records are appended after the last complete
+ * one.
+ */
+void Journal::load(const std::function<void(StateReader&)>& loadSnapshot,
+	const std::function<void(StateReader&)>& replayRecord)
+{
+	// Load the snapshot.
+	MappedFile snapshot(snapshotPath);
+	if (!snapshot.contents.empty()) {
+		try {
+			StateReader in(snapshot.contents);
+			if (in.readString() != SNAPSHOT_MAGIC)
+				fail("Unrecognized snapshot format");
+			loadSnapshot(in);
+		} catch (std::exception&) {
+			log::error("Failed to load snapshot ", snapshotPath);
+		}
+	}
+
+	// Replay the journal.
+	MappedFile journal(journalPath);
+	StateReader in(journal.contents);
+	size_t validSize = 0;
+	size_t records = 0;
+	while (!in.isAtEnd()) {
+		std::string_view record;
+		try {
+			record = in.readString();
+		} catch (std::exception&) {
+			log::warn("Discarding incomplete record at the end of journal ", journalPath);
+			if (fd != -1 && ftruncate(fd, validSize) == 0)
+				size = validSize;
+			break;
+		}
+		validSize = in.getOffset();
+		try {
+			StateReader recordReader(record);
+			replayRecord(recordReader);
+			records++;
+		} catch (std::exception&) {
+			log::warn("Skipping invalid record in journal ", journalPath);
+		}
+	}
+	log::info("Replayed ", records, " records from journal ", journalPath);
+}
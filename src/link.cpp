@@ -0,0 +1,668 @@
+#include <arpa/inet.h>
+#include <cstring>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "channel.hpp"
+#include "client.hpp"
+#include "clock.hpp"
+#include "config.hpp"
+#include "irc.hpp"
+#include "mask.hpp"
+#include "server.hpp"
+#include "utility.hpp"
+
+// Approximate maximum length of the lists of members or masks sent in a single
+// burst message, to keep lines well below the usual IRC line length.
+static constexpr size_t BURST_LIST_LENGTH = 400;
+
+/**
+ * Put a message received from another server back together, so that it can be
+ * passed on to other servers unchanged. The last parameter is always sent as a
+ * trailing parameter.
+ */
+static std::string joinMessage(const char* prefix, int argc, char** argv)
+{
+	std::string line;
+	if (prefix != nullptr)
+		line = ":" + std::string(prefix) + " ";
+	for (int i = 0; i < argc; i++)
+		line += std::string(i == argc - 1 && i > 0 ? ":" : "") + argv[i] + (i < argc - 1 ? " " : "");
+	return line;
+}
+
+/**
+ * Open the link to the server given by the link setting of the configuration.
+ * The connection is made in the background, and registered like any other
+ * client once it's established. If anything fails, the link is retried after
+ * link_retry_interval seconds.
+ */
+void Server::connectLink()
+{
+	// Split the target into a host and a port.
+	size_t colon = linkTarget.rfind(':');
+	std::string host = linkTarget.substr(0, colon);
+	std::string port = colon == linkTarget.npos ? "6667" : linkTarget.substr(colon + 1);
+	log::info("Linking to server at ", host, ":", port);
+
+	// Start connecting to the server.
+	struct addrinfo hints = {};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo* ai = nullptr;
+	int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &ai);
+	int fd = -1;
+	if (status != 0) {
+		log::warn("Failed to resolve ", host, ": ", gai_strerror(status));
+	} else {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd != -1 && connect(fd, ai->ai_addr, ai->ai_addrlen) == -1 && errno != EINPROGRESS) {
+			log::warn("Failed to connect to ", linkTarget, ": ", strerror(errno));
+			safeClose(fd);
+		}
+	}
+	if (fd == -1) {
+		if (ai != nullptr)
+			freeaddrinfo(ai);
+		return timers.schedule(linkTimer, Clock::getMilliseconds() + Config::get().linkRetryInterval * 1000);
+	}
+
+	// Register the connection, and send the credentials for the link. They're
+	// sent as soon as the connection is established.
+	const struct sockaddr_in* address = reinterpret_cast<const struct sockaddr_in*>(ai->ai_addr);
+	char peerHost[INET_ADDRSTRLEN];
+	inet_ntop(AF_INET, &address->sin_addr, peerHost, sizeof(peerHost));
+	Client& link = newClient(fd, peerHost);
+	freeaddrinfo(ai);
+	watchSocket(fd);
+	link.startLink();
+	sendLinkCredentials(link);
+}
+
+/**
+ * Check if a string matches the link password. Always false if no link
+ * password is configured, since links are refused then.
+ */
+bool Server::correctLinkPassword(std::string_view pass)
+{
+	const std::string& linkPassword = Config::get().linkPassword;
+	return !linkPassword.empty() && linkPassword == pass;
+}
+
+/**
+ * Check if a server with the given name, connecting from the given address, is
+ * on the link_allow list.
+ */
+bool Server::isLinkAllowed(std::string_view name, std::string_view host)
+{
+	for (const auto& [allowedName, allowedHost]: Config::get().linkAllow)
+		if (Mask(allowedName).matches(name) && Mask(allowedHost).matches(host))
+			return true;
+	return false;
+}
+
+/**
+ * Send the messages that register a connection as a server link.
+ */
+void Server::sendLinkCredentials(Client& link)
+{
+	link.sendLine("PASS :", Config::get().linkPassword);
+	link.sendLine("SERVER ", getHostname(), " :", SERVER_NAME);
+}
+
+/**
+ * Complete the registration of a server link, after the other server sent its
+ * credentials. Both servers then send each other everything they know about
+ * the network (the burst), and keep each other up to date from then on.
+ */
+void Server::registerLink(Client& link, std::string_view name)
+{
+	// The network must stay a tree, so each server can only be linked once.
+	if (name == getHostname() || servers.contains(std::string(name))) {
+		log::warn("Rejected link from ", name, ": Server already exists");
+		return disconnectClient(link, "Server " + std::string(name) + " already exists");
+	}
+
+	// Reply with this server's credentials, unless this server opened the link.
+	if (!link.isOutgoingLink())
+		sendLinkCredentials(link);
+	link.finishLink(name);
+	log::info("Linked to server ", name);
+
+	// Let the rest of the network know about the new server, then send the
+	// state of the network to it.
+	propagate(":" + std::string(getHostname()) + " SERVER " + std::string(name) + " :" SERVER_NAME, &link);
+	servers[std::string(name)] = &link;
+	links.push_back(&link);
+	sendBurst(link);
+}
+
+/**
+ * Send all servers, users and channels that aren't behind a link to the other
+ * end of the link.
+ */
+void Server::sendBurst(Client& link)
+{
+	for (auto& [name, via]: servers)
+		if (via != &link)
+			link.sendLine(":", getHostname(), " SERVER ", name, " :", SERVER_NAME);
+	for (auto& [fd, client]: clients)
+		if (client.hasRegistered() && client.getLink() != &link && !client.isDisconnected())
+			link.sendLine(client.getIntroduction());
+	for (auto& [name, channel]: channels)
+		sendChannelState(link, channel);
+}
+
+/**
+ * Send the state of a channel to a server link: the creation time, modes and
+ * members not behind the link (SJOIN), the ban and exception lists (BMASK),
+ * and the topic (TBURST). The receiving server decides which modes to keep by
+ * comparing creation times. Channels without any members to send are skipped.
+ */
+void Server::sendChannelState(Client& link, Channel& channel)
+{
+	// Build the mode string, including the key and limit.
+	std::string modes = "+";
+	std::string modeArgs;
+	if (channel.isInviteOnly())
+		modes += "i";
+	if (channel.isTopicRestricted())
+		modes += "t";
+	if (channel.hasKey()) {
+		modes += "k";
+		modeArgs += " " + std::string(channel.getKey());
+	}
+	if (channel.getMemberLimit() < INT_MAX) {
+		modes += "l";
+		modeArgs += " " + std::to_string(channel.getMemberLimit());
+	}
+	std::string header = "SJOIN " + std::to_string(channel.getCreationTime()) + " "
+		+ std::string(channel.getName()) + " " + modes + modeArgs + " :";
+
+	// Send the members, split into several messages for big channels.
+	std::string members;
+	bool sentMembers = false;
+	for (const Member& member: channel.allMemberEntries()) {
+		if (member.client->getLink() == &link)
+			continue;
+		if (!members.empty())
+			members += " ";
+		members += member.getPrefix();
+		members += member.client->getNick();
+		if (members.length() >= BURST_LIST_LENGTH) {
+			link.sendLine(header, members);
+			members.clear();
+			sentMembers = true;
+		}
+	}
+	if (!members.empty())
+		link.sendLine(header, members);
+	else if (!sentMembers)
+		return;
+
+	// Send the ban and exception lists.
+	std::string bmask = "BMASK " + std::to_string(channel.getCreationTime()) + " "
+		+ std::string(channel.getName()) + " ";
+	for (char mode: {'b', 'e'}) {
+		std::string masks;
+		for (const ListEntry& entry: channel.getListMasks(mode)) {
+			masks += (masks.empty() ? "" : " ") + entry.mask;
+			if (masks.length() >= BURST_LIST_LENGTH) {
+				link.sendLine(bmask, mode, " :", masks);
+				masks.clear();
+			}
+		}
+		if (!masks.empty())
+			link.sendLine(bmask, mode, " :", masks);
+	}
+
+	// Send the topic, along with the nickname of whoever set it.
+	if (channel.hasTopic()) {
+		std::string_view setter = channel.getTopicChange();
+		setter = setter.substr(0, setter.find(' '));
+		link.sendLine("TBURST ", channel.getCreationTime(), " ", channel.getName(), " ",
+			setter, " :", channel.getTopic());
+	}
+}
+
+/**
+ * Send the state of a channel to all linked servers.
+ */
+void Server::propagateChannelState(Channel& channel)
+{
+	for (Client* link: links)
+		sendChannelState(*link, channel);
+}
+
+/**
+ * Forget everything behind a server link that was closed: the users behind it
+ * quit, and the servers behind it are removed from the network.
+ */
+void Server::removeLink(Client& link, std::string_view reason)
+{
+	log::info("Lost link to server ", link.getServerName(), ": ", reason);
+	std::erase(links, &link);
+
+	// Users behind the link quit, with the two servers as the reason, like on
+	// other IRC networks.
+	std::string split = std::string(getHostname()) + " " + std::string(link.getServerName());
+	for (auto& [fd, client]: clients)
+		if (client.getLink() == &link)
+			disconnectClient(client, split);
+
+	// Servers behind the link are gone.
+	for (auto i = servers.begin(); i != servers.end();) {
+		if (i->second == &link) {
+			propagate("SQUIT " + i->first + " :" + std::string(reason), &link);
+			i = servers.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+/**
+ * Add a server that was introduced by a server link. Returns false if the
+ * server is already part of the network, which would make a loop.
+ */
+bool Server::addRemoteServer(std::string_view name, Client& link)
+{
+	if (name == getHostname() || servers.contains(std::string(name)))
+		return false;
+	servers[std::string(name)] = &link;
+	return true;
+}
+
+/**
+ * Remove a server that was reached through a server link. Returns false if
+ * there was no such server behind the link.
+ */
+bool Server::removeRemoteServer(std::string_view name, Client& link)
+{
+	auto found = servers.find(std::string(name));
+	if (found == servers.end() || found->second != &link)
+		return false;
+	servers.erase(found);
+	return true;
+}
+
+/**
+ * Create a user on another server, introduced by a server link. Remote users
+ * are kept with the local clients, but under negative keys, since they don't
+ * have a connection.
+ */
+Client& Server::newRemoteClient(Client& link, std::string_view nick, std::string_view user,
+	std::string_view host, std::string_view realname)
+{
+	int key = nextRemoteKey--;
+	Client& client = clients.insert({key, Client(*this, -1, host)}).first->second;
+	client.acquireHandle();
+	hosts.insert({foldCase(host), &client});
+	client.setRemote(link, nick, user, realname);
+	remoteClientCount++;
+	return client;
+}
+
+/**
+ * Remove a user from the network. If the user is on another server, that
+ * server is told to disconnect it (unless the request came from there).
+ * Services on this server can't be killed, since they only go away when
+ * they're removed from the configuration. Another server that has a service
+ * with the same nickname keeps its own too, and kills this one on its side.
+ */
+void Server::killClient(Client& target, std::string_view reason, const Client* from)
+{
+	if (target.getService() != nullptr) {
+		log::warn("Not killing service ", target.getNick(), ": ", reason);
+		return;
+	}
+	Client* link = target.getLink();
+	if (link != nullptr && link != from)
+		link->sendLine("KILL ", target.getNick(), " :", reason);
+	disconnectClient(target, "Killed (" + std::string(reason) + ")");
+}
+
+/**
+ * Send a message to all linked servers, except the one it came from.
+ */
+void Server::propagate(std::string_view line, const Client* except)
+{
+	for (Client* link: links)
+		if (link != except)
+			link->sendLine(line);
+}
+
+/**
+ * Send a message for a channel to the linked servers that have members on the
+ * channel, except the one it came from. The channel keeps count of its members
+ * behind each link, so this doesn't depend on the size of the channel.
+ */
+void Server::propagateToChannel(Channel& channel, std::string_view line, const Client* except)
+{
+	for (const ChannelLink& entry: channel.getLinks())
+		if (entry.link != except)
+			entry.link->sendLine(line);
+}
+
+/**
+ * Get the number of servers in the network, including this one.
+ */
+size_t Server::getServerCount() const
+{
+	return servers.size() + 1;
+}
+
+/**
+ * Get the number of servers directly linked to this one.
+ */
+size_t Server::getLinkCount() const
+{
+	return links.size();
+}
+
+/**
+ * Get the number of users on other servers.
+ */
+size_t Server::getRemoteClientCount() const
+{
+	return remoteClientCount;
+}
+
+/**
+ * Handle a message from a linked server. Messages from users behind the link
+ * (with a nick!user@host prefix) are handled just as if the user had sent them
+ * to this server, which applies them here and passes them on to any other
+ * servers. Other messages maintain the state of the network.
+ */
+void Client::handleLinkMessage(const char* prefix, int argc, char** argv)
+{
+	if (argc == 0)
+		return;
+
+	// Handle messages from users.
+	if (prefix != nullptr && std::strchr(prefix, '!') != nullptr) {
+
+		// Check that the user is actually behind this link.
+		std::string_view sourceNick(prefix, std::strchr(prefix, '!') - prefix);
+		Client* source = server.findClientByName(sourceNick);
+		if (source == nullptr || source->link != this) {
+			log::warn("Ignoring ", argv[0], " from unknown user ", prefix, " on link ", serverName);
+			return;
+		}
+
+		// Nickname changes need to handle collisions.
+		if (equalsIgnoreCase(argv[0], "NICK"))
+			return handleRemoteNick(*source, argc - 1, argv + 1);
+
+		// Other commands are handled by the usual handlers.
+		static const char* userCommands[] = {
+			"JOIN", "PART", "KICK", "MODE", "TOPIC", "INVITE", "PRIVMSG", "NOTICE", "QUIT",
+		};
+		for (const char* command: userCommands)
+			if (equalsIgnoreCase(command, argv[0]))
+				return source->handleMessage(argc, argv);
+		log::warn("Ignoring unexpected ", argv[0], " from ", prefix, " on link ", serverName);
+		return;
+	}
+
+	// Handle messages from servers.
+	using Handler = void (Client::*)(int, char**);
+	static const std::pair<const char*, Handler> handlers[] = {
+		{"PING", &Client::handlePing},
+		{"PONG", &Client::handlePong},
+		{"ERROR", &Client::handleError},
+		{"SERVER", &Client::handleRemoteServer},
+		{"SQUIT", &Client::handleSquit},
+		{"NICK", &Client::handleRemoteUser},
+		{"SJOIN", &Client::handleSjoin},
+		{"BMASK", &Client::handleBmask},
+		{"TBURST", &Client::handleTburst},
+		{"KILL", &Client::handleKill},
+	};
+	for (const auto& [command, handler]: handlers)
+		if (equalsIgnoreCase(command, argv[0]))
+			return (this->*handler)(argc - 1, argv + 1);
+	log::warn("Ignoring unknown command ", argv[0], " on link ", serverName);
+}
+
+/**
+ * Handle an ERROR message, which a server sends before closing the link.
+ */
+void Client::handleError(int argc, char** argv)
+{
+	std::string_view reason = argc > 0 ? argv[0] : "";
+	log::warn("Link ", serverName, " closed by the other server: ", reason);
+	server.disconnectClient(*this, reason);
+}
+
+/**
+ * Handle a SERVER message introducing a server behind the link. If the server
+ * is already known, the link would create a loop in the network, so it's
+ * closed instead.
+ */
+void Client::handleRemoteServer(int argc, char** argv)
+{
+	if (argc < 1)
+		return;
+	if (!server.addRemoteServer(argv[0], *this)) {
+		log::warn("Server ", argv[0], " introduced twice, closing link ", serverName);
+		return server.disconnectClient(*this, "Server " + std::string(argv[0]) + " already exists");
+	}
+	log::info("Server ", argv[0], " joined the network behind ", serverName);
+	server.propagate(":" + std::string(server.getHostname()) + " SERVER " + argv[0] + " :" SERVER_NAME, this);
+}
+
+/**
+ * Handle a SQUIT message, which removes a server behind the link.
+ */
+void Client::handleSquit(int argc, char** argv)
+{
+	if (argc < 1 || !server.removeRemoteServer(argv[0], *this))
+		return;
+	log::info("Server ", argv[0], " left the network");
+	server.propagate(joinMessage(nullptr, argc + 1, argv - 1), this);
+}
+
+/**
+ * Handle a NICK message introducing a user behind the link, with the format
+ * "NICK <nick> <hops> <user> <host> :<realname>". If the nickname is already
+ * in use, both users are killed, since there's no way to tell which one should
+ * keep it, unless the one here is a service (see killClient). The other
+ * server does the same when it sees the collision. Users whose nickname isn't
+ * valid here (such as one longer than this server's nicklen) are killed too,
+ * so that the other server doesn't think they're still on the network.
+ */
+void Client::handleRemoteUser(int argc, char** argv)
+{
+	if (argc < 5)
+		return;
+	if (!isValidName(argv[0])) {
+		log::warn("Invalid nickname ", argv[0], " on link ", serverName);
+		return sendLine("KILL ", argv[0], " :Invalid nickname");
+	}
+	Client* existing = server.findClientByName(argv[0]);
+	if (existing != nullptr) {
+		log::warn("Nick collision for ", argv[0], " on link ", serverName);
+		sendLine("KILL ", argv[0], " :Nick collision");
+		return server.killClient(*existing, "Nick collision", this);
+	}
+	server.newRemoteClient(*this, argv[0], argv[2], argv[3], argv[4]);
+	server.propagate(joinMessage(nullptr, argc + 1, argv - 1), this);
+}
+
+/**
+ * Handle a nickname change by a user behind the link. Collisions kill both
+ * users, and invalid nicknames kill the user, just like when a user is
+ * introduced.
+ */
+void Client::handleRemoteNick(Client& source, int argc, char** argv)
+{
+	if (argc < 1)
+		return;
+	if (!isValidName(argv[0])) {
+		log::warn("Invalid nickname ", argv[0], " on link ", serverName);
+		sendLine("KILL ", argv[0], " :Invalid nickname");
+		return server.disconnectClient(source, "Invalid nickname");
+	}
+	Client* existing = server.findClientByName(argv[0]);
+	if (existing != nullptr && existing != &source) {
+		log::warn("Nick collision for ", argv[0], " on link ", serverName);
+		sendLine("KILL ", argv[0], " :Nick collision");
+		server.disconnectClient(source, "Nick collision");
+		return server.killClient(*existing, "Nick collision", this);
+	}
+	char command[] = "NICK";
+	char* nickArgv[] = {command, argv[0]};
+	source.handleMessage(2, nickArgv);
+}
+
+/**
+ * Handle an SJOIN message, which adds members behind the link to a channel,
+ * with the format "SJOIN <ts> <channel> <modes> [<mode args>] :<members>".
+ * The members have their status prefixes (@ or +). If the channel is newer
+ * here than on the other server, this server's modes and member status are
+ * cleared and replaced by the other server's. If it's newer on the other
+ * server, only the members are added, without their status. If both are the
+ * same age, the modes are merged. The other server makes the same decision
+ * the other way around, so both end up with the same state.
+ */
+void Client::handleSjoin(int argc, char** argv)
+{
+	int64_t time;
+	if (argc < 4 || !parseInt(argv[0], time) || !Channel::isValidName(argv[1]))
+		return;
+	std::string_view hostname = server.getHostname();
+
+	// Find or create the channel, and compare creation times.
+	Channel* channel = server.findChannelByName(argv[1]);
+	if (channel == nullptr) {
+		channel = server.newChannel(argv[1]);
+		channel->setCreationTime(time);
+	} else if (time < channel->getCreationTime()) {
+		log::info("Channel ", argv[1], " is older on ", serverName, ", taking its modes");
+		for (const Member& member: channel->allMemberEntries()) {
+			if (member.flags & MEMBER_OPERATOR)
+				for (Client* local: channel->allMembers())
+					local->sendLine(":", hostname, " MODE ", argv[1], " -o ", member.client->getNick());
+			if (member.flags & MEMBER_VOICE)
+				for (Client* local: channel->allMembers())
+					local->sendLine(":", hostname, " MODE ", argv[1], " -v ", member.client->getNick());
+		}
+		channel->resetModes();
+		channel->setCreationTime(time);
+	}
+	bool keepModes = time == channel->getCreationTime();
+
+	// Apply the modes.
+	int modeArg = 3;
+	for (const char* mode = argv[2]; keepModes && *mode != '\0'; mode++) {
+		if (*mode == 'i')
+			channel->setInviteOnly(true);
+		else if (*mode == 't')
+			channel->setTopicRestricted(true);
+		else if (*mode == 'k' && modeArg < argc - 1 && !channel->hasKey())
+			channel->setKey(argv[modeArg++]);
+		else if (*mode == 'l' && modeArg < argc - 1) {
+			int limit;
+			if (parseInt(argv[modeArg++], limit) && limit > 0 && channel->getMemberLimit() == INT_MAX)
+				channel->setMemberLimit(limit);
+		}
+	}
+
+	// Add the members, and tell local members about them.
+	char* memberList = argv[argc - 1];
+	while (*memberList != '\0') {
+		char* end = std::strchr(memberList, ' ');
+		if (end != nullptr)
+			*end = '\0';
+		std::string_view name = memberList;
+		memberList = end != nullptr ? end + 1 : memberList + name.length();
+		bool op = name.starts_with('@');
+		name.remove_prefix(op);
+		bool voice = name.starts_with('+');
+		name.remove_prefix(voice);
+		Client* member = server.findClientByName(name);
+		if (member == nullptr || member->link != this || channel->isMember(*member))
+			continue;
+		channel->addMember(*member);
+		member->addChannel(channel);
+		for (Client* local: channel->allMembers())
+			local->sendLine(":", member->getFullName(), " JOIN ", channel->getName());
+		if (op && keepModes) {
+			channel->addOperator(*member);
+			for (Client* local: channel->allMembers())
+				local->sendLine(":", hostname, " MODE ", channel->getName(), " +o ", member->nick);
+		}
+		if (voice && keepModes) {
+			channel->addVoice(*member);
+			for (Client* local: channel->allMembers())
+				local->sendLine(":", hostname, " MODE ", channel->getName(), " +v ", member->nick);
+		}
+	}
+
+	// Pass the message on. The other servers make their own decisions based on
+	// the creation time.
+	server.propagate(joinMessage(nullptr, argc + 1, argv - 1), this);
+}
+
+/**
+ * Handle a BMASK message, which adds masks to a channel's ban or exception
+ * list, with the format "BMASK <ts> <channel> <b|e> :<masks>". The masks are
+ * ignored if the channel is older here than on the other server.
+ */
+void Client::handleBmask(int argc, char** argv)
+{
+	int64_t time;
+	if (argc < 4 || !parseInt(argv[0], time))
+		return;
+	Channel* channel = server.findChannelByName(argv[1]);
+	char mode = argv[2][0];
+	if (channel == nullptr || channel->getCreationTime() != time || (mode != 'b' && mode != 'e'))
+		return;
+	char* masks = argv[3];
+	while (*masks != '\0') {
+		char* end = std::strchr(masks, ' ');
+		if (end != nullptr)
+			*end = '\0';
+		if (*masks != '\0')
+			channel->addListMask(mode, masks, serverName);
+		masks = end != nullptr ? end + 1 : masks + std::strlen(masks);
+	}
+	server.propagate(joinMessage(nullptr, argc + 1, argv - 1), this);
+}
+
+/**
+ * Handle a TBURST message, which sets a channel's topic, with the format
+ * "TBURST <ts> <channel> <setter> :<topic>". The topic is only taken if the
+ * channel doesn't have one yet, and isn't older here than on the other server.
+ */
+void Client::handleTburst(int argc, char** argv)
+{
+	int64_t time;
+	if (argc < 4 || !parseInt(argv[0], time))
+		return;
+	Channel* channel = server.findChannelByName(argv[1]);
+	if (channel == nullptr || channel->getCreationTime() != time || channel->hasTopic())
+		return;
+	channel->setTopic(argv[3], argv[2]);
+	for (Client* member: channel->allMembers())
+		member->sendLine(":", argv[2], " TOPIC ", channel->getName(), " :", channel->getTopic());
+	server.propagate(joinMessage(nullptr, argc + 1, argv - 1), this);
+}
+
+/**
+ * Handle a KILL message, which removes a user from the network (after a nick
+ * collision).
+ */
+void Client::handleKill(int argc, char** argv)
+{
+	if (argc < 1)
+		return;
+	Client* target = server.findClientByName(argv[0]);
+	if (target == nullptr)
+		return;
+	std::string_view reason = argc > 1 ? argv[1] : "";
+	log::info("Killing ", argv[0], " on request of ", serverName, ": ", reason);
+	server.killClient(*target, reason, this);
+}
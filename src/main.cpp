@@ -5,9 +5,12 @@
 #include <iostream>
 #include <signal.h>
 #include <string>
+#include <unistd.h>
+#include <vector>
 
 #include "bot.hpp"
 #include "client.hpp"
+#include "config.hpp"
 #include "irc.hpp"
 #include "log.hpp"
 #include "server.hpp"
@@ -15,17 +18,27 @@
 
 int main(int argc, char** argv)
 {
+	// Use another configuration file if one was given.
+	if (argc >= 3 && std::strcmp(argv[1], "-c") == 0) {
+		Config::setPath(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+
 	// Check that two arguments were given.
 	if (argc != 3 && argc != 4) {
-		printf("usage: ./ircserv <port> <password> [botname]\n");
+		printf("usage: ./ircserv [-c config] <port> <password> [botname[,botname...]]\n");
+		printf("       (for the bot, <port> can also be the path of a Unix-domain socket)\n");
 		return EXIT_FAILURE;
 	}
 	char* port = argv[1];
 	char* password = argv[2];
 
-	// Check that the first argument is a valid port number.
+	// Check that the first argument is a valid port number. The bot can also
+	// connect through a Unix-domain socket, given as a path.
 	int portInt;
-	if (!parseInt(argv[1], portInt) || portInt < 0 || portInt > PORT_MAX) {
+	bool isPath = argc == 4 && std::strchr(port, '/') != nullptr;
+	if (!isPath && (!parseInt(argv[1], portInt) || portInt < 0 || portInt > PORT_MAX)) {
 		log::error("invalid port number: '", port, "'");
 		return EXIT_FAILURE;
 	}
@@ -38,26 +51,58 @@ int main(int argc, char** argv)
 		}
 	}
 
-	// Check if the bot option was passed.
-	char* botName = nullptr;
+	// Check if the bot option was passed. Several bots, separated by commas,
+	// can share one process.
+	std::vector<std::string> botNames;
 	if (argc == 4) {
-		botName = argv[3];
-		if (!Client::isValidName(botName)) {
-			log::error("invalid bot name: '", botName, "'");
+		for (char* list = argv[3]; *list != '\0';) {
+			char* botName = nextListItem(list);
+			if (!Client::isValidName(botName)) {
+				log::error("invalid bot name: '", botName, "'");
+				return EXIT_FAILURE;
+			}
+			botNames.push_back(botName);
+		}
+		if (botNames.empty()) {
+			log::error("no bot name given");
 			return EXIT_FAILURE;
 		}
 	}
 
-	// Start the server.
+	// Start the server. The bot reads the same configuration file.
 	try {
+		if (!Config::load())
+			return EXIT_FAILURE;
+
 		// Start a normal server.
-		if (botName == nullptr) {
+		if (botNames.empty()) {
 			Server server(port, password);
-			server.eventLoop(port);
+
+			// If this process was started by a hot restart, take over the
+			// state and connections of the previous process first. Until
+			// that's confirmed, the previous process still owns the
+			// connections and socket files, so if it fails, exit without
+			// letting the destructors close the connections or remove files.
+			if (const char* handover = std::getenv(HANDOVER_ENV)) {
+				int socket = std::atoi(handover);
+				unsetenv(HANDOVER_ENV);
+				try {
+					server.resume(socket);
+				} catch (std::exception& error) {
+					log::error("Failed to take over from the previous process: ", error.what());
+					std::cout.flush();
+					_exit(EXIT_FAILURE);
+				}
+
+			// Otherwise, load the channel state saved on disk.
+			} else {
+				server.loadChannels();
+			}
+			server.eventLoop();
 
 		// Start the bot.
 		} else {
-			Bot bot(botName);
+			Bot bot(botNames);
 			bot.run(port, password);
 		}
 	} catch (std::exception& error) {
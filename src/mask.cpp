@@ -0,0 +1,307 @@
+#include <algorithm>
+
+#include "mask.hpp"
+#include "utility.hpp"
+
+/**
+ * Compile a mask from a wildcard pattern.
+ */
+Mask::Mask(std::string_view pattern)
+	: pattern(pattern)
+{
+	// Fold the pattern, merging runs of '*' since they match the same thing.
+	for (char c: pattern)
+		if (c != '*' || folded.empty() || folded.back() != '*')
+			folded.push_back(foldChar(c));
+	hasWildcards = folded.find_first_of("*?") != folded.npos;
+	anchoredBegin = !folded.starts_with('*');
+	anchoredEnd = !folded.ends_with('*');
+
+	// Split the pattern into the literal segments between '*'s.
+	size_t begin = 0;
+	while (begin <= folded.length()) {
+		size_t end = std::min(folded.find('*', begin), folded.length());
+		if (end > begin) {
+			segments.push_back({begin, end - begin});
+			literalLength += end - begin;
+		}
+		begin = end + 1;
+	}
+}
+
+/**
+ * Expand a partial mask into a full nick!user@host mask, the way ban masks are
+ * usually given: "nick" becomes "nick!*@*", "user@host" becomes "*!user@host"
+ * and "nick!user" becomes "nick!user@*".
+ */
+std::string Mask::normalize(std::string_view pattern)
+{
+	std::string full(pattern);
+	size_t bang = full.find('!');
+	size_t at = full.find('@');
+	if (bang == full.npos && at == full.npos)
+		full += "!*@*";
+	else if (bang == full.npos)
+		full.insert(0, "*!");
+	else if (at == full.npos)
+		full += "@*";
+	return full;
+}
+
+/**
+ * Check if a string matches the mask. Each segment is placed at the leftmost
+ * position where it fits, which is always correct when segments are separated
+ * by '*', so there's no backtracking and no exponential worst case.
+ */
+bool Mask::matches(std::string_view string) const
+{
+	// Fast path for masks without any wildcards.
+	if (!hasWildcards) {
+		if (string.length() != folded.length())
+			return false;
+		for (size_t i = 0; i < string.length(); i++)
+			if (foldChar(string[i]) != folded[i])
+				return false;
+		return true;
+	}
+
+	// The string must be at least as long as the literal parts of the mask.
+	if (string.length() < literalLength)
+		return false;
+
+	// A mask with '?' but no '*' must match the whole string exactly.
+	if (anchoredBegin && anchoredEnd && segments.size() == 1)
+		return string.length() == literalLength && matchSegment(segments[0], string.data());
+
+	// Match the anchored first and last segments against the start and end of
+	// the string.
+	auto first = segments.begin();
+	auto last = segments.end();
+	size_t begin = 0;
+	size_t end = string.length();
+	if (anchoredBegin && first != last) {
+		if (!matchSegment(*first, string.data()))
+			return false;
+		begin = first++->length;
+	}
+	if (anchoredEnd && first != last) {
+		end -= (last - 1)->length;
+		if (end < begin || !matchSegment(*--last, string.data() + end))
+			return false;
+	}
+
+	// Find each of the remaining segments, from left to right.
+	for (; first != last; ++first) {
+		size_t found = findSegment(*first, string, begin, end);
+		if (found == string.npos)
+			return false;
+		begin = found + first->length;
+	}
+	return true;
+}
+
+/**
+ * Check if a segment matches the characters at the start of a string. The
+ * string must have at least as many characters as the segment.
+ */
+bool Mask::matchSegment(const Segment& segment, const char* string) const
+{
+	const char* literal = folded.data() + segment.begin;
+	for (size_t i = 0; i < segment.length; i++)
+		if (literal[i] != '?' && literal[i] != foldChar(string[i]))
+			return false;
+	return true;
+}
+
+/**
+ * Find the leftmost position of a segment within string[begin, end). Returns
+ * npos if the segment doesn't occur in that range.
+ */
+size_t Mask::findSegment(const Segment& segment, std::string_view string, size_t begin, size_t end) const
+{
+	const char head = folded[segment.begin];
+	for (size_t i = begin; i + segment.length <= end; i++)
+		if ((head == '?' || head == foldChar(string[i])) && matchSegment(segment, &string[i]))
+			return i;
+	return string.npos;
+}
+
+/**
+ * Get the pattern that the mask was compiled from.
+ */
+std::string_view Mask::getPattern() const
+{
+	return pattern;
+}
+
+/**
+ * Get the casefolded literal characters at the start of the mask, up to the
+ * first wildcard.
+ */
+std::string_view Mask::getPrefix() const
+{
+	return std::string_view(folded).substr(0, folded.find_first_of("*?"));
+}
+
+/**
+ * Get the casefolded literal characters at the end of the mask, after the last
+ * wildcard.
+ */
+std::string_view Mask::getSuffix() const
+{
+	size_t wildcard = folded.find_last_of("*?");
+	if (wildcard == folded.npos)
+		return folded;
+	return std::string_view(folded).substr(wildcard + 1);
+}
+
+/**
+ * Copy a set of masks. The indexes point into the list of masks, so they can't
+ * be copied as they are, and are rebuilt instead.
+ */
+MaskSet::MaskSet(const MaskSet& other)
+{
+	for (const Mask& mask: other.masks)
+		add(mask.getPattern());
+}
+
+/**
+ * Assign a set of masks, rebuilding the indexes (see the copy constructor).
+ */
+MaskSet& MaskSet::operator=(const MaskSet& other)
+{
+	if (this != &other) {
+		clear();
+		for (const Mask& mask: other.masks)
+			add(mask.getPattern());
+	}
+	return *this;
+}
+
+/**
+ * Add a mask to the set. Returns false if the same mask was already added.
+ */
+bool MaskSet::add(std::string_view pattern)
+{
+	std::string key = foldCase(pattern);
+	if (byPattern.contains(key))
+		return false;
+	const Mask& mask = masks.emplace_back(pattern);
+	byPattern.insert({key, std::prev(masks.end())});
+
+	// File the mask under the most specific index it fits in.
+	std::string_view suffix = mask.getSuffix();
+	if (mask.getPrefix().length() == key.length())
+		literals.insert({key, &mask});
+	else if (suffix.length() >= SUFFIX_KEY_LENGTH)
+		bySuffix[std::string(suffix.substr(suffix.length() - SUFFIX_KEY_LENGTH))].push_back(&mask);
+	else
+		others.push_back(&mask);
+	return true;
+}
+
+/**
+ * Remove a mask from the set. Returns false if there was no such mask.
+ */
+bool MaskSet::remove(std::string_view pattern)
+{
+	auto found = byPattern.find(foldCase(pattern));
+	if (found == byPattern.end())
+		return false;
+	const Mask* mask = &*found->second;
+
+	// Remove the mask from whichever index it was filed under.
+	std::string_view suffix = mask->getSuffix();
+	if (mask->getPrefix().length() == found->first.length()) {
+		literals.erase(found->first);
+	} else {
+		bool bucketed = suffix.length() >= SUFFIX_KEY_LENGTH;
+		std::string key(suffix.substr(suffix.length() - std::min(suffix.length(), SUFFIX_KEY_LENGTH)));
+		std::vector<const Mask*>& list = bucketed ? bySuffix[key] : others;
+		list.erase(std::find(list.begin(), list.end(), mask));
+		if (bucketed && list.empty())
+			bySuffix.erase(key);
+	}
+	masks.erase(found->second);
+	byPattern.erase(found);
+	return true;
+}
+
+/**
+ * Check if the set contains a specific mask (not whether a string matches any
+ * of the masks).
+ */
+bool MaskSet::contains(std::string_view pattern) const
+{
+	return byPattern.contains(foldCase(pattern));
+}
+
+/**
+ * Find a mask in the set that matches a string. Returns a null pointer if none
+ * of the masks match.
+ */
+const Mask* MaskSet::match(std::string_view string) const
+{
+	if (masks.empty())
+		return nullptr;
+
+	// Try the masks without wildcards.
+	std::string folded = foldCase(string);
+	if (!literals.empty()) {
+		auto found = literals.find(folded);
+		if (found != literals.end())
+			return found->second;
+	}
+
+	// Try the masks that end with the same characters as the string.
+	if (!bySuffix.empty() && folded.length() >= SUFFIX_KEY_LENGTH) {
+		auto key = folded.substr(folded.length() - SUFFIX_KEY_LENGTH);
+		auto found = bySuffix.find(key);
+		if (found != bySuffix.end())
+			for (const Mask* mask: found->second)
+				if (mask->matches(folded))
+					return mask;
+	}
+
+	// Try everything else.
+	for (const Mask* mask: others)
+		if (mask->matches(folded))
+			return mask;
+	return nullptr;
+}
+
+/**
+ * Get all the masks in the set, in the order they were added.
+ */
+const std::list<Mask>& MaskSet::allMasks() const
+{
+	return masks;
+}
+
+/**
+ * Get the number of masks in the set.
+ */
+size_t MaskSet::size() const
+{
+	return masks.size();
+}
+
+/**
+ * Check if the set has no masks.
+ */
+bool MaskSet::isEmpty() const
+{
+	return masks.empty();
+}
+
+/**
+ * Remove all masks from the set.
+ */
+void MaskSet::clear()
+{
+	masks.clear();
+	byPattern.clear();
+	literals.clear();
+	bySuffix.clear();
+	others.clear();
+}
@@ -0,0 +1,287 @@
+#include <cstdint>
+#include <utility>
+
+#include "client.hpp"
+#include "memberlist.hpp"
+
+/**
+ * Get the NAMES prefix for a member's highest status ("@" or "+"), or an empty
+ * string if the member has no status.
+ */
+const char* Member::getPrefix() const
+{
+	if (flags & MEMBER_OPERATOR)
+		return "@";
+	if (flags & MEMBER_VOICE)
+		return "+";
+	return "";
+}
+
+/**
+ * Get an iterator to the first member.
+ */
+MemberList::Iterator MemberList::begin() const
+{
+	return {entries.data()};
+}
+
+/**
+ * Get an iterator past the last member.
+ */
+MemberList::Iterator MemberList::end() const
+{
+	return {entries.data() + memberCount};
+}
+
+/**
+ * Get all members along with their status flags.
+ */
+std::span<const Member> MemberList::allMembers() const
+{
+	return {entries.data(), memberCount};
+}
+
+/**
+ * Get all entries, including invited clients that aren't members.
+ */
+std::span<const Member> MemberList::allEntries() const
+{
+	return entries;
+}
+
+/**
+ * Check if a client is a member.
+ */
+bool MemberList::isMember(const Client* client) const
+{
+	return findEntry(client) < memberCount;
+}
+
+/**
+ * Make a client a member. If the client was invited, their entry is moved to
+ * the member part of the list, keeping its flags.
+ */
+void MemberList::addMember(Client* client)
+{
+	size_t index = findEntry(client);
+	if (index == SIZE_MAX)
+		index = addEntry(client);
+	if (index >= memberCount)
+		swapEntries(index, memberCount++);
+}
+
+/**
+ * Remove a client from the list entirely, including from the invite list.
+ */
+void MemberList::removeMember(Client* client)
+{
+	size_t index = findEntry(client);
+	if (index == SIZE_MAX)
+		return;
+	if (index < memberCount) {
+		swapEntries(index, --memberCount);
+		index = memberCount;
+	}
+	removeEntry(index);
+}
+
+/**
+ * Get the number of members.
+ */
+size_t MemberList::getMemberCount() const
+{
+	return memberCount;
+}
+
+/**
+ * Get the status flags of a client, or zero if the client isn't on the list.
+ */
+uint8_t MemberList::getFlags(const Client* client) const
+{
+	size_t index = findEntry(client);
+	return index == SIZE_MAX ? 0 : entries[index].flags;
+}
+
+/**
+ * Set status flags for a client. Returns false if the client isn't on the list.
+ */
+bool MemberList::setFlags(const Client* client, uint8_t flags)
+{
+	size_t index = findEntry(client);
+	if (index == SIZE_MAX)
+		return false;
+	entries[index].flags |= flags;
+	return true;
+}
+
+/**
+ * Clear status flags for a client, if the client is on the list.
+ */
+void MemberList::clearFlags(const Client* client, uint8_t flags)
+{
+	size_t index = findEntry(client);
+	if (index != SIZE_MAX)
+		entries[index].flags &= ~flags;
+}
+
+/**
+ * Clear status flags for every client on the list.
+ */
+void MemberList::clearFlagsForAll(uint8_t flags)
+{
+	for (Member& entry: entries)
+		entry.flags &= ~flags;
+}
+
+/**
+ * Add a client to the invite list.
+ */
+void MemberList::addInvited(Client* client)
+{
+	size_t index = findEntry(client);
+	if (index == SIZE_MAX)
+		index = addEntry(client);
+	entries[index].flags |= MEMBER_INVITED;
+}
+
+/**
+ * Remove a client from the invite list. Clients that aren't members are dropped
+ * from the list entirely.
+ */
+void MemberList::removeInvited(Client* client)
+{
+	size_t index = findEntry(client);
+	if (index == SIZE_MAX)
+		return;
+	entries[index].flags &= ~MEMBER_INVITED;
+	if (index >= memberCount)
+		removeEntry(index);
+}
+
+/**
+ * Clear the invite list.
+ */
+void MemberList::clearInvited()
+{
+	while (entries.size() > memberCount)
+		removeEntry(entries.size() - 1);
+	clearFlagsForAll(MEMBER_INVITED);
+}
+
+/**
+ * Find the hash table slot that refers to a client's entry. Returns SIZE_MAX if
+ * the client isn't on the list.
+ */
+size_t MemberList::findSlot(ClientHandle handle) const
+{
+	if (slots.empty())
+		return SIZE_MAX;
+	size_t mask = slots.size() - 1;
+	size_t slot = hash(handle) & mask;
+	for (; slots[slot] != EMPTY; slot = (slot + 1) & mask)
+		if (entries[slots[slot]].handle == handle)
+			return slot;
+	return SIZE_MAX;
+}
+
+/**
+ * Find the index of a client's entry. Returns SIZE_MAX if the client isn't on
+ * the list.
+ */
+size_t MemberList::findEntry(const Client* client) const
+{
+	size_t slot = findSlot(client->getHandle());
+	return slot == SIZE_MAX ? SIZE_MAX : slots[slot];
+}
+
+/**
+ * Append a new entry (with no flags) for a client, and return its index. The
+ * hash table is grown so that it's never more than half full, unless removing
+ * the disconnected clients makes enough room.
+ */
+size_t MemberList::addEntry(Client* client)
+{
+	if (2 * (entries.size() + 1) > slots.size()) {
+		removeDisconnected();
+		if (2 * (entries.size() + 1) > slots.size())
+			rehash(slots.empty() ? 16 : 2 * slots.size());
+	}
+	ClientHandle handle = client->getHandle();
+	size_t mask = slots.size() - 1;
+	size_t slot = hash(handle) & mask;
+	while (slots[slot] != EMPTY)
+		slot = (slot + 1) & mask;
+	slots[slot] = entries.size();
+	entries.push_back({client, handle, 0});
+	return entries.size() - 1;
+}
+
+/**
+ * Remove the entry at some index, by swapping it with the last entry. The
+ * entries following its hash table slot are shifted back to fill the gap, so
+ * that no tombstones are needed.
+ */
+void MemberList::removeEntry(size_t index)
+{
+	swapEntries(index, entries.size() - 1);
+	size_t mask = slots.size() - 1;
+	size_t hole = findSlot(entries.back().handle);
+	for (size_t slot = (hole + 1) & mask; slots[slot] != EMPTY; slot = (slot + 1) & mask) {
+		size_t home = hash(entries[slots[slot]].handle) & mask;
+		if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+			slots[hole] = slots[slot];
+			hole = slot;
+		}
+	}
+	slots[hole] = EMPTY;
+	entries.pop_back();
+}
+
+/**
+ * Remove the invited clients that disconnected since they were invited. Only
+ * the entries after the members need to be checked, and removing an entry
+ * moves the last one into its place, which was already checked.
+ */
+void MemberList::removeDisconnected()
+{
+	for (size_t i = entries.size(); i-- > memberCount;)
+		if (ClientTable::find(entries[i].handle) == nullptr)
+			removeEntry(i);
+}
+
+/**
+ * Swap two entries, updating the hash table to match.
+ */
+void MemberList::swapEntries(size_t a, size_t b)
+{
+	if (a == b)
+		return;
+	slots[findSlot(entries[a].handle)] = b;
+	slots[findSlot(entries[b].handle)] = a;
+	std::swap(entries[a], entries[b]);
+}
+
+/**
+ * Rebuild the hash table with a new number of slots (a power of two).
+ */
+void MemberList::rehash(size_t capacity)
+{
+	slots.assign(capacity, EMPTY);
+	size_t mask = capacity - 1;
+	for (size_t i = 0; i < entries.size(); i++) {
+		size_t slot = hash(entries[i].handle) & mask;
+		while (slots[slot] != EMPTY)
+			slot = (slot + 1) & mask;
+		slots[slot] = i;
+	}
+}
+
+/**
+ * Hash a client handle (Fibonacci hashing, so that clients in neighbouring
+ * slots of the client table don't land in neighbouring slots here).
+ */
+size_t MemberList::hash(ClientHandle handle)
+{
+	uint64_t value = static_cast<uint64_t>(handle.generation) << 32 | handle.index;
+	return (value * 0x9E3779B97F4A7C15) >> 32;
+}
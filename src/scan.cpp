@@ -0,0 +1,220 @@
+#include <algorithm>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+#include "irc.hpp"
+#include "scan.hpp"
+
+/**
+ * Write the offsets of the bits set in a mask, plus a base offset, to a list,
+ * moving the end of the list past them.
+ */
+static inline void appendOffsets(uint32_t*& offsets, size_t base, uint64_t mask)
+{
+	while (mask != 0) {
+		*offsets++ = base + __builtin_ctzll(mask);
+		mask &= mask - 1;
+	}
+}
+
+/**
+ * Find the delimiters in the part of a buffer from the given position on, one
+ * byte at a time. This is the whole scan where there's no vector instructions,
+ * and the tail of it otherwise.
+ */
+static void scanTail(std::string_view buffer, size_t from, uint32_t*& lineEnds, uint32_t*& spaces)
+{
+	for (size_t i = from; i < buffer.size(); i++) {
+		if (buffer[i] == ' ')
+			*spaces++ = i;
+		else if (buffer[i] == '\n' && i > 0 && buffer[i - 1] == '\r')
+			*lineEnds++ = i - 1;
+	}
+}
+
+/**
+ * Find the delimiters in a buffer one byte at a time.
+ */
+static void scanScalar(std::string_view buffer, uint32_t*& lineEnds, uint32_t*& spaces)
+{
+	scanTail(buffer, 0, lineEnds, spaces);
+}
+
+#ifdef __x86_64__
+/**
+ * Find the delimiters in a buffer 16 bytes at a time. Each block is compared
+ * with '\n', '\r' and ' ' at once, giving a bit mask of where each of them is.
+ * A line ends at a '\n' whose previous bit is set in the '\r' mask, which for
+ * the first byte of a block is the last bit of the previous block's mask.
+ */
+static void scanSse2(std::string_view buffer, uint32_t*& lineEnds, uint32_t*& spaces)
+{
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i carriageReturn = _mm_set1_epi8('\r');
+	const __m128i space = _mm_set1_epi8(' ');
+	uint32_t carry = 0;
+	size_t i = 0;
+	for (; i + 16 <= buffer.size(); i += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer.data() + i));
+		uint32_t newlineMask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline));
+		uint32_t returnMask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, carriageReturn));
+		uint32_t spaceMask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space));
+		uint32_t lineEndMask = newlineMask & (returnMask << 1 | carry);
+		carry = returnMask >> 15;
+
+		// The offsets of the '\n' bits are one past their '\r'. The base
+		// wraps around for the first block, but its lowest bit is never set.
+		appendOffsets(lineEnds, i - 1, lineEndMask);
+		appendOffsets(spaces, i, spaceMask);
+	}
+	scanTail(buffer, i, lineEnds, spaces);
+}
+
+/**
+ * Find the delimiters in a buffer 32 bytes at a time, the same way as
+ * scanSse2. Only used on CPUs that have AVX2.
+ */
+__attribute__((target("avx2")))
+static void scanAvx2(std::string_view buffer, uint32_t*& lineEnds, uint32_t*& spaces)
+{
+	const __m256i newline = _mm256_set1_epi8('\n');
+	const __m256i carriageReturn = _mm256_set1_epi8('\r');
+	const __m256i space = _mm256_set1_epi8(' ');
+	uint64_t carry = 0;
+	size_t i = 0;
+	for (; i + 32 <= buffer.size(); i += 32) {
+		__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer.data() + i));
+		uint64_t newlineMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)));
+		uint64_t returnMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, carriageReturn)));
+		uint64_t spaceMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)));
+		uint64_t lineEndMask = newlineMask & (returnMask << 1 | carry);
+		carry = returnMask >> 31;
+		appendOffsets(lineEnds, i - 1, lineEndMask);
+		appendOffsets(spaces, i, spaceMask);
+	}
+	scanTail(buffer, i, lineEnds, spaces);
+}
+#endif
+
+// The scanning kernels, fastest first, and whether the CPU can run each one.
+// "auto" picks the first one that it can.
+static const struct ScanKernel {
+	const char* name;
+	void (*scan)(std::string_view buffer, uint32_t*& lineEnds, uint32_t*& spaces);
+	bool (*isSupported)();
+} kernels[] = {
+#ifdef __x86_64__
+	{"avx2", scanAvx2, [] { __builtin_cpu_init(); return __builtin_cpu_supports("avx2") != 0; }},
+	{"sse2", scanSse2, [] { return true; }},
+#endif
+	{"scalar", scanScalar, [] { return true; }},
+};
+
+/**
+ * Find a scanning kernel by its name, or the best one for this CPU if the name
+ * is "auto". Returns nullptr if there's no such kernel, or the CPU can't run
+ * it.
+ */
+static const ScanKernel* findKernel(std::string_view name)
+{
+	for (const ScanKernel& kernel: kernels)
+		if ((name == "auto" || name == kernel.name) && kernel.isSupported())
+			return &kernel;
+	return nullptr;
+}
+
+// The kernel used by scanDelimiters.
+static const ScanKernel* current = findKernel("auto");
+
+/**
+ * Find the line ends and spaces in a buffer of received data, in one pass over
+ * it. The delimiters are replaced with the ones found. There can't be more
+ * spaces than bytes, or more line ends than half of them, so the kernels write
+ * to storage of that size without checking for room.
+ */
+void scanDelimiters(std::string_view buffer, Delimiters& delimiters)
+{
+	size_t size = buffer.size();
+	if (delimiters.storage.size() < size + size / 2 + 1)
+		delimiters.storage.resize(size + size / 2 + 1);
+	uint32_t* spaces = delimiters.storage.data();
+	uint32_t* lineEnds = spaces + size;
+	current->scan(buffer, lineEnds, spaces);
+	delimiters.spaces = {delimiters.storage.data(), spaces};
+	delimiters.lineEnds = {delimiters.storage.data() + size, lineEnds};
+}
+
+/**
+ * Split the message between two offsets of a buffer into parts, using the
+ * spaces found by scanDelimiters. Each part is null-terminated in place, and
+ * added to argv, which must have room for MAX_MESSAGE_PARTS parts. Runs of
+ * spaces count as one, and tags (parts starting with an '@' sign) are ignored.
+ * The first other part is the source prefix if it starts with a ':', and any
+ * later one starting with a ':' is the rest of the message, spaces included.
+ * Returns the number of parts, or -1 if there were too many.
+ */
+int splitMessage(char* buffer, size_t begin, size_t end, std::span<const uint32_t> spaces,
+	char** argv, char*& prefix)
+{
+	int argc = 0;
+	prefix = nullptr;
+	buffer[end] = '\0';
+	auto space = std::lower_bound(spaces.begin(), spaces.end(), begin);
+	while (begin < end) {
+
+		// Find the end of the part (either the next space or the message end).
+		size_t partEnd = space != spaces.end() && *space < end ? *space++ : end;
+		char* part = buffer + begin;
+		buffer[partEnd] = '\0';
+		begin = partEnd + 1;
+
+		// Skip empty parts between consecutive spaces, and tags.
+		if (part == buffer + partEnd || *part == '@')
+			continue;
+		if (*part == ':' && argc == 0 && prefix == nullptr) {
+			prefix = part + 1;
+			continue;
+		}
+		if (argc == MAX_MESSAGE_PARTS)
+			return -1;
+
+		// If the part starts with a ':', treat the rest of the message as one
+		// big part, putting back the spaces that were replaced.
+		if (*part == ':') {
+			if (partEnd < end)
+				buffer[partEnd] = ' ';
+			argv[argc++] = part + 1;
+			break;
+		}
+		argv[argc++] = part;
+	}
+	return argc;
+}
+
+/**
+ * Check whether a scanning kernel exists and can run on this CPU. The kernels
+ * are "avx2", "sse2" and "scalar", or "auto" for the best of them.
+ */
+bool isScanKernelSupported(std::string_view name)
+{
+	return findKernel(name) != nullptr;
+}
+
+/**
+ * Choose the kernel used for scanning received data. Unsupported kernels are
+ * ignored.
+ */
+void selectScanKernel(std::string_view name)
+{
+	if (const ScanKernel* kernel = findKernel(name))
+		current = kernel;
+}
+
+/**
+ * Get the name of the kernel used for scanning received data.
+ */
+const char* getScanKernelName()
+{
+	return current->name;
+}
@@ -1,149 +1,507 @@
+#include <algorithm>
 #include <arpa/inet.h>
 #include <csignal>
 #include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <netdb.h>
+#include <netinet/tcp.h>
+#include <span>
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
 
 #include "channel.hpp"
+#include "clock.hpp"
 #include "client.hpp"
+#include "config.hpp"
 #include "irc.hpp"
 #include "log.hpp"
+#include "mask.hpp"
+#include "scan.hpp"
 #include "server.hpp"
+#include "service.hpp"
 #include "utility.hpp"
 
+// Parameters for busy-polling an epoll instance (added in Linux 6.9), which
+// older system headers don't have.
+#ifndef EPIOCSPARAMS
+struct epoll_params
+{
+	uint32_t busy_poll_usecs;
+	uint16_t busy_poll_budget;
+	uint8_t prefer_busy_poll;
+	uint8_t pad;
+};
+#define EPIOCSPARAMS _IOW(0x8A, 0x01, struct epoll_params)
+#endif
+
+// Prefix of listen addresses that are paths of Unix-domain sockets.
+static constexpr std::string_view UNIX_PREFIX = "unix:";
+
+/**
+ * Check if a listener accepts connections on a Unix-domain socket.
+ */
+static bool isUnixListener(const Listener& listener)
+{
+	return listener.address.starts_with(UNIX_PREFIX);
+}
+
+/**
+ * Remove the socket file of a Unix-domain listener, so that the path doesn't
+ * look like a server is still listening there.
+ */
+static void removeSocketFile(const Listener& listener)
+{
+	if (isUnixListener(listener))
+		unlink(listener.address.c_str() + UNIX_PREFIX.length());
+}
+
+/**
+ * Set an integer socket option. Returns false if the kernel refused it.
+ */
+static bool setOption(int fd, int level, int option, int value)
+{
+	return setsockopt(fd, level, option, &value, sizeof(value)) == 0;
+}
+
+/**
+ * Apply the options of a socket profile that belong on a listening socket. The
+ * buffer sizes are inherited by accepted connections, and only count for the
+ * TCP window scale if they're set before the connection is established.
+ */
+static void applyListenerProfile(int fd, const SocketProfile& profile, std::string_view address)
+{
+	bool applied = setOption(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, profile.deferAccept);
+	if (profile.sendBuffer > 0)
+		applied &= setOption(fd, SOL_SOCKET, SO_SNDBUF, profile.sendBuffer);
+	if (profile.receiveBuffer > 0)
+		applied &= setOption(fd, SOL_SOCKET, SO_RCVBUF, profile.receiveBuffer);
+	if (!applied)
+		log::warn("Socket profile ", profile.name, " not fully applied to ", address, ": ", strerror(errno));
+}
+
+/**
+ * Apply the options of a socket profile that belong on each accepted
+ * connection. Returns false if the kernel refused any of them.
+ */
+static bool applyConnectionProfile(int fd, const SocketProfile& profile)
+{
+	bool applied = true;
+	if (profile.noDelay)
+		applied &= setOption(fd, IPPROTO_TCP, TCP_NODELAY, 1);
+	if (profile.notSentLowat > 0)
+		applied &= setOption(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, profile.notSentLowat);
+	if (profile.busyPoll > 0)
+		applied &= setOption(fd, SOL_SOCKET, SO_BUSY_POLL, profile.busyPoll);
+	return applied;
+}
+
+/**
+ * Get the number of threads to use for delivering messages to large channels,
+ * in addition to the event loop thread.
+ */
+static size_t getFanOutThreads()
+{
+	int64_t threads = Config::get().fanoutThreads;
+	if (threads >= 0)
+		return threads;
+	unsigned cpus = std::thread::hardware_concurrency();
+	return cpus > 1 ? cpus - 1 : 0;
+}
+
 Server::Server(const char* port, const char* password)
-	: port(port), password(password)
+	: port(port), password(password), fanout(getFanOutThreads())
 {
 	if (*password == '\0')
 		log::info("Starting server with no password");
 	else
 		log::info("Starting server with password '", password, "'");
-	launchTime = getTimeString();
+	launchTime = Clock::getAsctime();
+
+	const Config& config = Config::get();
+
+	// Names are indexed by their folded forms, so the casemapping can't change
+	// once the first one is added.
+	setCasemapping(config.casemapping);
+
+	// Start saving channel state, and check the journal size periodically.
+	journal.open(JOURNAL_FILE, SNAPSHOT_FILE);
+	compactionTimer.callback = [this] { compactJournal(false); };
+	timers.schedule(compactionTimer, Clock::getMilliseconds() + config.journalCheckInterval * 1000);
+
+	// Free I/O buffers left over from bursts of traffic, once they're unused.
+	bufferTimer.callback = [this] { trimBuffers(); };
+	timers.schedule(bufferTimer, Clock::getMilliseconds() + config.ioPoolTrimInterval * 1000);
+
+	// Set up the message filters.
+	filters.configure(config);
+
+	// Choose how received data is split into messages.
+	selectScanKernel(config.scanKernel);
+	log::info("Scanning received data with the ", getScanKernelName(), " kernel");
+
+	// Link to another server, if one was configured.
+	linkTarget = config.link;
+	linkTimer.callback = [this] { connectLink(); };
 }
 
 Server::~Server()
 {
+	// After a hot restart, the connections live on in the new process, so the
+	// clients must not be told that the server is shutting down.
 	log::info("Closing connection");
 	for (auto& [fd, client]: clients) {
-		client.sendLine("ERROR :Server is shutting down");
-		close(fd);
+		if (!handedOver)
+			client.sendLine("ERROR :Server is shutting down");
+		if (fd >= 0)
+			close(fd);
+	}
+	for (Listener& listener: listeners) {
+		if (!handedOver)
+			removeSocketFile(listener);
+		safeClose(listener.fd);
 	}
-	safeClose(serverFd);
 	safeClose(epollFd);
 }
 
 /**
- * Create a socket file descriptor for listening for incoming connections.
+ * Create a Unix-domain socket for listening for incoming connections, at the
+ * given path. A socket file left behind by a server that didn't exit cleanly
+ * is replaced, but one that a running server still accepts connections on is
+ * not.
  */
-int Server::createListenSocket(const char* port)
+static int createUnixListenSocket(const std::string& path)
 {
+	struct sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.length() >= sizeof(address.sun_path))
+		fail("Socket path is too long: ", path);
+	path.copy(address.sun_path, path.length());
+	struct sockaddr* sockaddr = reinterpret_cast<struct sockaddr*>(&address);
+
+	// Check for an existing socket file.
+	struct stat info;
+	if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+		int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		bool inUse = probe != -1 && connect(probe, sockaddr, sizeof(address)) == 0;
+		safeClose(probe);
+		if (inUse)
+			fail("Socket ", path, " is already in use");
+		unlink(path.c_str());
+	}
+
+	// Create, bind, and start listening.
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1)
+		fail("socket() failed: ", strerror(errno));
+	if (bind(fd, sockaddr, sizeof(address)) == -1 || listen(fd, Config::get().listenBacklog) == -1) {
+		int error = errno;
+		close(fd);
+		fail("Failed to listen on ", path, ": ", strerror(error));
+	}
+	return fd;
+}
+
+/**
+ * Create a socket file descriptor for listening for incoming connections, on
+ * an address given as "host" or "host:port". Without a port, the one given on
+ * the command line is used. Addresses starting with "unix:" are paths of
+ * Unix-domain sockets instead, which don't use socket profiles.
+ */
+int Server::createListenSocket(const std::string& address, const SocketProfile& profile)
+{
+	if (address.starts_with(UNIX_PREFIX))
+		return createUnixListenSocket(address.substr(UNIX_PREFIX.length()));
+
 	struct addrinfo *ai = nullptr;
+	int fd = -1;
 
 	try {
+		// Split the address into a host and a port.
+		size_t colon = address.rfind(':');
+		std::string host = address.substr(0, colon);
+		std::string service = colon == address.npos ? port : address.substr(colon + 1);
+
 		// Get address info for the listening socket.
 		struct addrinfo hints = {};
 		hints.ai_family   = AF_INET;		// IPv4 only (not IPv6).
 		hints.ai_socktype = SOCK_STREAM;	// TCP only (not UDP).
 		hints.ai_flags = AI_PASSIVE;   		// Accept any connections.
-		int status = getaddrinfo(nullptr, port, &hints, &ai);
+		int status = getaddrinfo(host.c_str(), service.c_str(), &hints, &ai);
 		if (status != 0)
-			fail("getaddrinfo() failed: ", gai_strerror(status));
+			fail("getaddrinfo() failed for ", address, ": ", gai_strerror(status));
 
 		// Create the listening socket.
-		serverFd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
-		if (serverFd == -1)
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd == -1)
 			fail("socket() failed: ", strerror(errno));
 
 		// Allow reuse of the same port in successive runs of the server. Avoids
 		// the "address already in use" error when bind() is called.
 		int opt = 1;
-		if (setsockopt(serverFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1)
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1)
 			fail("setsockopt() failed:", strerror(errno));
 
-		// Bind the socket.
-		if (bind(serverFd, ai->ai_addr, ai->ai_addrlen) == -1)
-			fail("bind failed: ", strerror(errno));
+		// Bind the socket, and set the options of its socket profile.
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen) == -1)
+			fail("bind failed for ", address, ": ", strerror(errno));
+		applyListenerProfile(fd, profile, address);
 
 		// Start listening for incoming connections.
-		if (listen(serverFd, MAX_BACKLOG) == -1)
+		if (listen(fd, Config::get().listenBacklog) == -1)
 			fail("listen failed: ", strerror(errno));
 		freeaddrinfo(ai);
 	
 	// Free resources if any of the preceding syscalls failed.
 	} catch (...) {
-		freeaddrinfo(ai);
+		if (ai != nullptr)
+			freeaddrinfo(ai);
+		safeClose(fd);
 		throw; // Rethrow the same exception.
 	}
-	return serverFd;
+	return fd;
 }
 
-void Server::eventLoop(const char* port)
+/**
+ * Make the listening sockets match the configured addresses. Sockets for
+ * addresses that were removed are closed, which doesn't affect the
+ * connections accepted through them, and sockets are opened for new
+ * addresses. The remaining sockets get the new backlog (calling listen() again
+ * on a listening socket changes it) and socket profile. Connections that are
+ * already open keep the options they were accepted with.
+ */
+void Server::openListeners()
 {
-	// Install a signal handler for SIGINT, so that the server can be shut down
-	// gracefully with Ctrl + C.
-	static volatile sig_atomic_t caughtSignal;
-	struct sigaction sa = {};
-	sa.sa_handler = [] (int signal) { caughtSignal = signal; };
-	sigaction(SIGINT, &sa, nullptr);
+	const Config& config = Config::get();
+	for (auto i = listeners.begin(); i != listeners.end();) {
+		auto found = std::find_if(config.listen.begin(), config.listen.end(),
+			[&] (const ListenAddress& listen) { return listen.address == i->address; });
+		if (found == config.listen.end()) {
+			log::info("Stopped listening on ", i->address);
+			epoll_ctl(epollFd, EPOLL_CTL_DEL, i->fd, nullptr);
+			close(i->fd);
+			removeSocketFile(*i);
+			i = listeners.erase(i);
+		} else {
+			i->profile = found->profile;
+			i->warned = false;
+			if (!isUnixListener(*i))
+				applyListenerProfile(i->fd, config.getProfile(i->profile), i->address);
+			listen(i->fd, config.listenBacklog);
+			++i;
+		}
+	}
+	for (const auto& [address, profile]: config.listen) {
+		auto found = std::find_if(listeners.begin(), listeners.end(),
+			[&] (const Listener& listener) { return listener.address == address; });
+		if (found != listeners.end())
+			continue;
+		int fd = createListenSocket(address, config.getProfile(profile));
+		listeners.push_back({address, profile, fd});
+		struct epoll_event epollEvent = {};
+		epollEvent.events = EPOLLIN;
+		epollEvent.data.fd = fd;
+		if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &epollEvent) == -1)
+			fail("Failed to add listening socket to epoll: ", strerror(errno));
+		if (isUnixListener(listeners.back()))
+			log::info("Listening on ", address);
+		else
+			log::info("Listening on ", address, " (", profile, " profile)");
+	}
+}
 
-	// Create epoll.
-	struct epoll_event epollEvent, events[MAX_EVENTS];
+/**
+ * Make the running services match the configured ones. Services that were
+ * removed quit, the remaining ones reload their settings, and new ones are
+ * started. A service whose nickname is taken by a user isn't started, but is
+ * tried again on the next rehash.
+ */
+void Server::openServices()
+{
+	const auto& wanted = Config::get().services;
+	std::erase_if(services, [&] (const std::unique_ptr<Service>& service) {
+		std::pair<std::string, std::string> entry(service->getType(), service->getClient().getNick());
+		if (std::find(wanted.begin(), wanted.end(), entry) != wanted.end())
+			return false;
+		log::info("Stopped service ", entry.second);
+		disconnectClient(service->getClient(), "Service stopped");
+		return true;
+	});
+	for (const std::unique_ptr<Service>& service: services)
+		service->reload();
+	for (const auto& [type, nick]: wanted) {
+		Client* existing = findClientByName(nick);
+		if (existing != nullptr && existing->getService() != nullptr)
+			continue;
+		if (existing != nullptr) {
+			log::warn("Nickname ", nick, " is in use, service not started");
+			continue;
+		}
 
-	// Create listen socket.
-	serverFd = createListenSocket(port);
-	if (serverFd == -1)
-		fail("Failed to create server socket: ", strerror(errno));
+		// The pseudo-client is kept with the other clients, under a negative
+		// key like users on other servers, since it has no connection.
+		std::unique_ptr<Service> service = Service::create(*this, type);
+		int key = nextRemoteKey--;
+		Client& client = clients.insert({key, Client(*this, -1, getHostname())}).first->second;
+		client.acquireHandle();
+		hosts.insert({foldCase(client.getHost()), &client});
+		client.setService(*service, nick);
+		service->attach(client);
+		services.push_back(std::move(service));
+		propagate(client.getIntroduction(), nullptr);
+		log::info("Started ", type, " service ", nick);
+	}
+}
+
+/**
+ * Call the services on a channel with a message sent to it. Messages from
+ * services aren't passed on, so services can't get into a loop answering each
+ * other.
+ */
+void Server::notifyServices(Channel& channel, Client& from, std::string_view text)
+{
+	if (from.getService() != nullptr)
+		return;
+	for (const std::unique_ptr<Service>& service: services)
+		if (service->getClient().isOnChannel(&channel))
+			service->onChannelMessage(from, channel, text);
+}
 
-	// Create epoll instance for serverFD.
-	epollFd = epoll_create1(0);
+/**
+ * Run a PRIVMSG or NOTICE from a local user through the message filters,
+ * which may change its text. Returns false if the message is blocked.
+ * Operators get a notice about messages that a stage tagged.
+ */
+bool Server::filterMessage(Client& sender, std::string_view command, std::string_view targets, std::string& text)
+{
+	FilterMessage message{sender, command, targets, std::move(text), {}, {}};
+	bool allowed = filters.run(message);
+	text = std::move(message.text);
+	if (!allowed) {
+		log::info("Filter ", message.blockedBy, " blocked ", command, " from ", sender.getNick(), " to ", targets);
+		return false;
+	}
+	if (!message.tags.empty()) {
+		std::string stages;
+		for (const std::string& tag: message.tags)
+			stages += (stages.empty() ? "" : ", ") + tag;
+		noticeOperators("Filter (" + stages + ") tagged " + std::string(command) + " from "
+			+ std::string(sender.getNick()) + " to " + std::string(targets) + ": " + text);
+	}
+	return true;
+}
+
+/**
+ * Get the filters that messages from local users go through.
+ */
+const FilterPipeline& Server::getFilters() const
+{
+	return filters;
+}
+
+/**
+ * Set how long epoll_wait busy-polls the network devices of the sockets it
+ * watches before going to sleep. This trades CPU time for latency.
+ */
+void Server::setBusyPoll()
+{
+	struct epoll_params params = {};
+	params.busy_poll_usecs = Config::get().epollBusyPoll;
+	params.busy_poll_budget = params.busy_poll_usecs > 0 ? 8 : 0;
+	if (ioctl(epollFd, EPIOCSPARAMS, &params) == -1)
+		log::warn("Failed to set epoll busy-polling: ", strerror(errno));
+}
+
+void Server::eventLoop()
+{
+	// Install a signal handler for SIGINT, so that the server can be shut down
+	// gracefully with Ctrl + C. SIGUSR2 hands the server over to a freshly
+	// started copy of the executable (see handOver), and SIGHUP reloads the
+	// configuration file. The signals are blocked except while waiting for
+	// events, so one that arrives while events are handled is still seen by
+	// the next wait, which returns right away.
+	static volatile sig_atomic_t caughtSignals;
+	struct sigaction sa = {};
+	sa.sa_handler = [] (int signal) { caughtSignals = caughtSignals | 1 << signal; };
+	sigemptyset(&sa.sa_mask);
+	for (int signal: {SIGINT, SIGUSR2, SIGHUP})
+		sigaddset(&sa.sa_mask, signal);
+	for (int signal: {SIGINT, SIGUSR2, SIGHUP})
+		sigaction(signal, &sa, nullptr);
+	sigset_t waitMask;
+	pthread_sigmask(SIG_BLOCK, &sa.sa_mask, &waitMask);
+	for (int signal: {SIGINT, SIGUSR2, SIGHUP})
+		sigdelset(&waitMask, signal);
+
+	// Create epoll instance.
+	std::vector<struct epoll_event> events;
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
 	if (epollFd == -1)
 		fail("Failed to create epoll instance: ", strerror(errno));
 
-	// Add server fd socket to epoll.
-	epollEvent.events = EPOLLIN;
-	epollEvent.data.fd = serverFd;
-	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, serverFd, &epollEvent) == -1)
-		fail("Failed to add server socket to epoll: ", strerror(errno));
+	// Add any listening sockets and clients that were inherited from a
+	// previous process, then open the listening sockets that are missing.
+	for (Listener& listener: listeners) {
+		struct epoll_event epollEvent = {};
+		epollEvent.events = EPOLLIN;
+		epollEvent.data.fd = listener.fd;
+		if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listener.fd, &epollEvent) == -1)
+			fail("Failed to add listening socket to epoll: ", strerror(errno));
+	}
+	for (auto& [fd, client]: clients)
+		if (fd >= 0)
+			watchSocket(fd);
+	openListeners();
+	openServices();
+	if (Config::get().epollBusyPoll > 0)
+		setBusyPoll();
+
+	// Open the link to another server, if there is one.
+	if (!linkTarget.empty())
+		connectLink();
 
 	// Begin the event loop.
-	log::info("Listening on port ", port);
 	while (true) {
 
-		// Poll available events.
-		int numberOfReadyEvents = epoll_wait(epollFd, events, MAX_EVENTS, -1);
-		if (numberOfReadyEvents == -1) {
-			if (errno == EINTR && caughtSignal == SIGINT) {
-				std::fprintf(stderr, "\r"); // Just to avoid printing ^C.
-				log::info("Interrupted by user");
-				break;
-			}
+		// Poll available events, waking up in time for the next timer.
+		int timeout = timers.getTimeout(Clock::getMilliseconds());
+		events.resize(Config::get().epollBatch);
+		int numberOfReadyEvents = epoll_pwait(epollFd, events.data(), events.size(), timeout, &waitMask);
+		if (numberOfReadyEvents == -1 && errno != EINTR)
 			fail("Failed to wait for events: ", strerror(errno));
+
+		// Act on the signals caught while waiting. Since they're blocked
+		// outside of the wait, the flags can't change while this runs.
+		int signals = caughtSignals;
+		caughtSignals = 0;
+		if (signals & 1 << SIGINT) {
+			std::fprintf(stderr, "\r"); // Just to avoid printing ^C.
+			log::info("Interrupted by user");
+			compactJournal(true);
+			break;
 		}
+		if (signals & 1 << SIGHUP)
+			rehash();
+		if ((signals & 1 << SIGUSR2) && handOver())
+			break;
+		if (numberOfReadyEvents == -1)
+			continue;
+
+		// Sample the clock once for everything handled in this iteration.
+		Clock::update();
 
 		// Loop over pending events.
 		for (int i = 0; i < numberOfReadyEvents; ++i) {
 			int fd = events[i].data.fd;
 
 			// Accept a new client.
-			if (fd == serverFd) {
-
-				// Open a new client connection.
-				struct sockaddr_in address;
-				struct sockaddr* sockaddr = reinterpret_cast<struct sockaddr*>(&address);
-				socklen_t length = sizeof(address);
-				int clientFd = accept(serverFd, sockaddr, &length);
-				if (clientFd == -1)
-					fail("Failed to accept connection: ", strerror(errno));
-
-				// Register the connection with epoll.
-				Client& client = newClient(clientFd, inet_ntoa(address.sin_addr));
-				epollEvent.events = EPOLLIN | EPOLLOUT | EPOLLET;
-				epollEvent.data.fd = clientFd;
-				if (epoll_ctl(epollFd, EPOLL_CTL_ADD, clientFd, &epollEvent) == -1)
-					fail("Failed to add client socket to epoll: ", strerror(errno));
-				log::info("Client connected: ", client.getHost());
+			auto isListener = [fd] (const Listener& listener) { return listener.fd == fd; };
+			auto listener = std::find_if(listeners.begin(), listeners.end(), isListener);
+			if (listener != listeners.end()) {
+				acceptClient(*listener);
 
 			// Exchange data with a client.
 			} else {
@@ -160,14 +518,27 @@ void Server::eventLoop(const char* port)
 			}
 		}
 
+		// Reload the configuration if an operator asked for it. This waits
+		// until all events are handled, since listening sockets may be closed.
+		if (rehashPending)
+			rehash();
+
+		// Run any expired timers (keepalive pings and timeouts).
+		timers.advance(Clock::getMilliseconds());
+
 		// Remove any clients that were disconnected during the last iteration
 		// of the event loop. It's important not to do this in the middle of the
 		// send/receive part of the event loop, when the socket is still
-		// actively used.
+		// actively used. Clients that went over the SendQ limit are
+		// disconnected here too, since the limit can be hit on any thread.
 		for (auto i = clients.begin(); i != clients.end();) {
+			if (i->second.hasFullSendQueue())
+				disconnectClient(i->second, "SendQ exceeded");
 			if (i->second.isDisconnected()) {
-				close(i->first);
-				log::info("Client disconnected: ", i->second.getHost());
+				if (i->first >= 0) {
+					close(i->first);
+					log::info("Client disconnected: ", i->second.getHost());
+				}
 				i = clients.erase(i);
 			} else {
 				++i;
@@ -177,14 +548,140 @@ void Server::eventLoop(const char* port)
 		// Clean up channels that were left empty at the end of the last
 		// iteration of the event loop.
 		for (auto i = channels.begin(); i != channels.end();) {
-			if (i->second.isEmpty()) {
+			if (i->second.isEmpty() && !i->second.isDormant()) {
 				log::info("Removed empty channel ", i->second.getName());
+				journal.record(JOURNAL_REMOVE, i->first);
 				i = channels.erase(i);
 			} else {
 				++i;
 			}
 		}
+
+		// Save this iteration's changes to channel state.
+		journal.flush();
+	}
+}
+
+/**
+ * Accept a new client connection on a listening socket. TCP connections get
+ * the options of the listener's socket profile. Connections on Unix-domain
+ * sockets come from this machine, so they all get the configured trusted host
+ * instead of an address.
+ */
+void Server::acceptClient(Listener& listener)
+{
+	// Open a new client connection.
+	struct sockaddr_storage address;
+	struct sockaddr* sockaddr = reinterpret_cast<struct sockaddr*>(&address);
+	socklen_t length = sizeof(address);
+	int clientFd = accept4(listener.fd, sockaddr, &length, SOCK_CLOEXEC);
+	if (clientFd == -1)
+		fail("Failed to accept connection: ", strerror(errno));
+
+	// Find out the client's host, and set the socket options.
+	const Config& config = Config::get();
+	char text[INET_ADDRSTRLEN];
+	std::string_view host = config.unixHost;
+	if (!isUnixListener(listener)) {
+		const struct sockaddr_in* inet = reinterpret_cast<const struct sockaddr_in*>(&address);
+		host = inet_ntop(AF_INET, &inet->sin_addr, text, sizeof(text));
+		const SocketProfile& profile = config.getProfile(listener.profile);
+		if (!applyConnectionProfile(clientFd, profile) && !listener.warned) {
+			log::warn("Socket profile ", profile.name, " not fully applied to connections on ",
+				listener.address, ": ", strerror(errno));
+			listener.warned = true;
+		}
 	}
+
+	// Register the connection with epoll. The host text is interned, so it's
+	// stored once per address, however many connections come from it.
+	Client& client = newClient(clientFd, host);
+	watchSocket(clientFd);
+	log::info("Client connected: ", client.getHost());
+}
+
+/**
+ * Ask for the configuration to be reloaded at the end of the current iteration
+ * of the event loop.
+ */
+void Server::requestRehash()
+{
+	rehashPending = true;
+}
+
+/**
+ * Reload the configuration file without dropping any connections. New limits
+ * apply from now on, and clients are sent the RPL_ISUPPORT tokens that
+ * changed. Client timers pick up new timeouts the next time they expire. If
+ * the file has errors, the current configuration stays in effect.
+ */
+void Server::rehash()
+{
+	rehashPending = false;
+	log::info("Reloading the configuration");
+	Config previous = Config::get();
+	if (!Config::load())
+		return noticeOperators("Failed to reload " + Config::getPath() + ", see the server log");
+	const Config& config = Config::get();
+	if (config.serverName != previous.serverName || config.fanoutThreads != previous.fanoutThreads
+		|| config.casemapping != previous.casemapping)
+		log::warn("Changes to server_name, fanout_threads and casemapping take effect after a restart");
+
+	// Open and close listening sockets. If an address can't be used, the
+	// remaining ones are still tried on the next rehash.
+	try {
+		openListeners();
+	} catch (const std::exception&) {
+		log::error("Failed to open all listening sockets");
+	}
+
+	if (config.epollBusyPoll != previous.epollBusyPoll)
+		setBusyPoll();
+	openServices();
+	filters.configure(config);
+	if (config.scanKernel != previous.scanKernel) {
+		selectScanKernel(config.scanKernel);
+		log::info("Scanning received data with the ", getScanKernelName(), " kernel");
+	}
+
+	// Restart the periodic timers with their new intervals.
+	int64_t now = Clock::getMilliseconds();
+	timers.schedule(compactionTimer, now + config.journalCheckInterval * 1000);
+	timers.schedule(bufferTimer, now + config.ioPoolTrimInterval * 1000);
+
+	// Follow a changed link target. A link that's already open is kept, and
+	// the new target is used if it's lost.
+	if (config.link != linkTarget) {
+		linkTarget = config.link;
+		linkTimer.cancel();
+		bool linked = std::any_of(clients.begin(), clients.end(), [] (const auto& entry) {
+			return entry.second.isOutgoingLink() && !entry.second.isDisconnected();
+		});
+		if (!linked && !linkTarget.empty())
+			connectLink();
+	}
+
+	// Advertise the features that changed to everyone already registered.
+	std::vector<std::string> oldTokens = previous.getSupportTokens();
+	std::vector<std::string> changed;
+	for (std::string& token: config.getSupportTokens())
+		if (std::find(oldTokens.begin(), oldTokens.end(), token) == oldTokens.end())
+			changed.push_back(std::move(token));
+	for (auto& [fd, client]: clients)
+		if (fd >= 0 && client.hasRegistered())
+			for (const std::string& token: changed)
+				client.sendNumeric("005", token, " :are supported by this server");
+	noticeOperators("Reloaded " + Config::getPath());
+}
+
+/**
+ * Send a server notice to all local IRC operators.
+ */
+void Server::noticeOperators(std::string_view text)
+{
+	for (auto& [fd, client]: clients)
+		if (fd >= 0 && client.isIrcOperator())
+			client.sendLine(":", getHostname(), " NOTICE ", client.getNick(), " :*** ", text);
 }
 
 /**
@@ -203,38 +700,108 @@ bool Server::correctPassword(std::string_view pass)
  */
 void Server::disconnectClient(Client& client, std::string_view reason)
 {
+	// Ignore clients that are already on their way out.
+	if (client.isDisconnected())
+		return;
+
 	// Send an ERROR message to the disconnected client, with the reason for the
 	// disconnection.
 	client.sendLine("ERROR :", reason);
 
 	// Send QUIT messages to let other clients know the client disconnected.
-	// The <source> of the message is the disconnected client. Also remove the
-	// client from all channels it's a part of.
-	for (Channel* channel: client.allChannels()) {
-		for (Client* member: channel->allMembers())
-			member->sendLine(":", client.getFullName(), " QUIT :", reason);
+	// The <source> of the message is the disconnected client. Each client
+	// sharing channels with the disconnected client gets only one QUIT.
+	std::string quit = ":" + client.getFullName() + " QUIT :" + std::string(reason);
+	forEachNeighbour(client, [&] (Client& neighbour) {
+		neighbour.sendLine(quit);
+	});
+
+	// Let the rest of the network know too. If the client is a server link,
+	// everything behind it is gone as well.
+	if (client.hasRegistered())
+		propagate(quit, client.getLink());
+	if (!client.getServerName().empty())
+		removeLink(client, reason);
+	if (client.isOutgoingLink() && !linkTarget.empty())
+		timers.schedule(linkTimer, Clock::getMilliseconds() + Config::get().linkRetryInterval * 1000);
+	if (client.isRemote())
+		remoteClientCount--;
+
+	// Remove the client from all channels it's a part of. Invite lists are
+	// left alone, since they notice that the client's handle went stale.
+	for (Channel* channel: client.allChannels())
 		channel->removeMember(client);
-	}
 	client.clearChannels();
 
+	// Remove the client from the nick and host indexes, so that its nickname is
+	// immediately available again.
+	updateNick(client, "");
+	auto [first, last] = hosts.equal_range(foldCase(client.getHost()));
+	for (auto i = first; i != last; ++i) {
+		if (i->second == &client) {
+			hosts.erase(i);
+			break;
+		}
+	}
+
 	// Unsubscribe from epoll events for the client connection.
-	epoll_ctl(epollFd, EPOLL_CTL_DEL, client.getSocket(), nullptr);
+	if (client.getSocket() >= 0)
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, client.getSocket(), nullptr);
 
 	// Mark the client as disconnected. The connection is actually closed before
 	// the next iteration of the event loop.
 	client.setDisconnected();
 }
 
+/**
+ * Call a function once for each client that shares at least one channel with
+ * some client, not including the client itself. Instead of collecting the
+ * neighbours into a temporary set, each visited client is stamped with the
+ * epoch of the current fan-out, so duplicates are skipped with one comparison.
+ */
+void Server::forEachNeighbour(Client& client, const std::function<void(Client&)>& function)
+{
+	uint64_t epoch = ++neighbourEpoch;
+	client.markVisited(epoch);
+	for (Channel* channel: client.allChannels())
+		for (Client* member: channel->allMembers())
+			if (member->markVisited(epoch))
+				function(*member);
+}
+
+/**
+ * Send a message to all local members of a channel, except for one client, and
+ * add it to the channel's history. Members get it with the tags they enabled
+ * (its time with server-time, and also its ID with message-tags). In large
+ * channels the members are split between the fan-out threads. Each member is
+ * only touched by one thread, and everything is queued before this returns, so
+ * each member still gets its messages in the order they were sent.
+ */
+void Server::sendToMembers(Channel& channel, std::string_view line, const Client* except)
+{
+	HistoryLine message = channel.getHistory().add(line);
+	std::span<const Member> members = channel.allMemberEntries();
+	auto sendRange = [&] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			Client* member = members[i].client;
+			if (member != except)
+				member->sendHistoryLine(message);
+		}
+	};
+	if (members.size() >= Config::get().fanoutThreshold)
+		fanout.run(members.size(), sendRange);
+	else
+		sendRange(0, members.size());
+}
+
 /**
  * Find a specific channel by its name. Returns a null pointer if there's no
- * channel by that name.
+ * channel by that name. Names are compared using the server's casemapping.
  */
 Channel* Server::findChannelByName(std::string_view name)
 {
-	for (auto& [channelName, channel]: channels)
-		if (channel.getName() == name)
-			return &channel;
-	return nullptr;
+	auto found = channels.find(foldCase(name));
+	return found != channels.end() ? &found->second : nullptr;
 }
 
 /**
@@ -243,7 +810,70 @@ Channel* Server::findChannelByName(std::string_view name)
 Channel* Server::newChannel(const std::string& name)
 {
 	log::info("Creating new channel ", name);
-	return &channels.insert({name, Channel(name)}).first->second;
+	Channel* channel = &channels.insert({foldCase(name), Channel(name, &journal)}).first->second;
+	journal.record(JOURNAL_CREATE, name, channel->getCreationTime());
+	return channel;
+}
+
+/**
+ * Load the channel state saved by a previous run of the server. The loaded
+ * channels are dormant, meaning they're kept around without any members until
+ * someone joins them again.
+ */
+void Server::loadChannels()
+{
+	if (!journal.isOpen())
+		return;
+	journal.load(
+		[this] (StateReader& in) {
+			for (int64_t count = in.readInt(); count > 0; count--) {
+				std::string name(in.readString());
+				channels.try_emplace(foldCase(name), name, &journal).first->second.restoreSnapshot(in);
+			}
+		},
+		[this] (StateReader& in) {
+			JournalRecord type = static_cast<JournalRecord>(in.readInt());
+			std::string name(in.readString());
+			if (type == JOURNAL_REMOVE)
+				channels.erase(foldCase(name));
+			else
+				channels.try_emplace(foldCase(name), name, &journal).first->second.replay(type, in);
+		});
+	for (auto& [name, channel]: channels)
+		channel.setDormant(true);
+	log::info("Loaded ", channels.size(), " saved channels");
+}
+
+/**
+ * Write a new snapshot of all channels and empty the journal, if the journal
+ * has grown large enough (or always, if `force` is true). Keeps checking
+ * journal_check_interval seconds.
+ */
+void Server::compactJournal(bool force)
+{
+	if (journal.isOpen() && (force || journal.needsCompaction())) {
+		StateWriter snapshot;
+		snapshot.writeInt(channels.size());
+		for (auto& [_, channel]: channels) {
+			snapshot.writeString(channel.getName());
+			channel.saveSnapshot(snapshot);
+		}
+		journal.compact(snapshot);
+	}
+	timers.schedule(compactionTimer, Clock::getMilliseconds() + Config::get().journalCheckInterval * 1000);
+}
+
+/**
+ * Free the I/O buffers that weren't needed since the last check, and log the
+ * pool's statistics if anything was freed.
+ */
+void Server::trimBuffers()
+{
+	if (size_t freed = buffers.trim()) {
+		log::info("Freed ", freed, " unused I/O buffers (", buffers.getInUseCount(), " in use, peak ",
+			buffers.getPeakCount(), ", ", buffers.getFreeCount(), " free)");
+	}
+	timers.schedule(bufferTimer, Clock::getMilliseconds() + Config::get().ioPoolTrimInterval * 1000);
 }
 
 /**
@@ -251,39 +881,97 @@ Channel* Server::newChannel(const std::string& name)
  */
 Client& Server::newClient(int fd, std::string_view host)
 {
-	return clients.insert({fd, Client(*this, fd, host)}).first->second;
+	Client& client = clients.insert({fd, Client(*this, fd, host)}).first->second;
+	client.acquireHandle();
+	hosts.insert({foldCase(host), &client});
+	client.startTimer();
+	return client;
+}
+
+/**
+ * Register a client socket with epoll.
+ */
+void Server::watchSocket(int fd)
+{
+	struct epoll_event epollEvent = {};
+	epollEvent.events = EPOLLIN | EPOLLOUT | EPOLLET;
+	epollEvent.data.fd = fd;
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &epollEvent) == -1)
+		fail("Failed to add client socket to epoll: ", strerror(errno));
 }
 
 /**
  * Find a specific client by their nickname. Returns a null pointer if there's
- * no client by that nickname.
+ * no client by that nickname. Nicknames are compared using the server's
+ * casemapping.
  */
 Client* Server::findClientByName(std::string_view name)
 {
-	for (auto& [fd, client]: clients)
-		if (client.getNick() == name)
-			return &client;
-	return nullptr;
+	auto found = nicks.find(foldCase(name));
+	return found != nicks.end() ? found->second : nullptr;
 }
 
 /**
- * Get a text timestamp of when the server was started.
+ * Update the nick index when a client changes their nickname. Must be called
+ * before the client's nickname is actually changed. An empty nickname removes
+ * the client from the index.
  */
-std::string Server::getLaunchTime()
+void Server::updateNick(Client& client, std::string_view newNick)
 {
-	return launchTime;
+	auto found = nicks.find(foldCase(client.getNick()));
+	if (found != nicks.end() && found->second == &client)
+		nicks.erase(found);
+	if (!newNick.empty())
+		nicks[foldCase(newNick)] = &client;
 }
 
 /**
- * Get the current time as a string.
+ * Collect the clients whose nickname or host matches a wildcard mask, stopping
+ * after `limit` results. Only the index range sharing the mask's literal prefix
+ * is scanned, so masks like "nick*" or "10.0.*" don't touch every client.
+ */
+void Server::findClientsByMask(std::string_view pattern, std::vector<Client*>& result, size_t limit)
+{
+	// Masks without wildcards are plain lookups.
+	Mask mask(pattern);
+	std::string prefix(mask.getPrefix());
+	if (prefix.length() == pattern.length()) {
+		Client* byNick = findClientByName(prefix);
+		if (byNick != nullptr)
+			result.push_back(byNick);
+		auto [first, last] = hosts.equal_range(prefix);
+		for (auto i = first; i != last && result.size() < limit; ++i)
+			if (i->second != byNick)
+				result.push_back(i->second);
+		return;
+	}
+
+	// Scan the nick index, starting from the literal prefix of the mask.
+	for (auto i = nicks.lower_bound(prefix); i != nicks.end(); ++i) {
+		if (result.size() >= limit)
+			return;
+		if (!i->first.starts_with(prefix))
+			break;
+		if (mask.matches(i->first))
+			result.push_back(i->second);
+	}
+
+	// Then scan the host index, skipping clients already matched by nick.
+	for (auto i = hosts.lower_bound(prefix); i != hosts.end(); ++i) {
+		if (result.size() >= limit || !i->first.starts_with(prefix))
+			return;
+		std::string_view nick = i->second->getNick();
+		if (!nick.empty() && mask.matches(i->first) && !mask.matches(nick))
+			result.push_back(i->second);
+	}
+}
+
+/**
+ * Get a text timestamp of when the server was started.
  */
-std::string Server::getTimeString()
+std::string Server::getLaunchTime()
 {
-	time_t _tm = time(NULL);
-	struct tm* curtime = localtime(&_tm);
-	std::string timeString = asctime(curtime);
-	timeString.pop_back(); // Remove newline.
-	return timeString;
+	return launchTime;
 }
 
 /**
@@ -302,11 +990,32 @@ size_t Server::getChannelCount() const
 	return channels.size();
 }
 
+/**
+ * Get the timer wheel that drives the server's timeouts.
+ */
+TimerWheel& Server::getTimers()
+{
+	return timers;
+}
+
+/**
+ * Get the pool that clients borrow their I/O buffers from.
+ */
+BufferPool& Server::getBufferPool()
+{
+	return buffers;
+}
+
 /**
  * Get the hostname for the server.
  */
 std::string_view Server::getHostname()
 {
+	// The name can be set explicitly, which is needed to link several servers
+	// on the same machine.
+	if (hostname.empty())
+		hostname = Config::get().serverName;
+
 	// If we haven't found out the hostname yet, read it from /etc/hostname, or
 	// use a default value.
 	if (hostname.empty()) {
@@ -0,0 +1,103 @@
+#include <vector>
+
+#include "channel.hpp"
+#include "client.hpp"
+#include "service.hpp"
+#include "wordfilter.hpp"
+
+// Types of services that can be started from the configuration file.
+static const struct {
+	const char* type;
+	std::unique_ptr<Service> (*create)(Server& server);
+} types[] = {
+	{"badwords", [] (Server& server) -> std::unique_ptr<Service> { return std::make_unique<WordFilterService>(server); }},
+};
+
+/**
+ * Create a service of the given type. Returns a null pointer if there's no
+ * such type.
+ */
+std::unique_ptr<Service> Service::create(Server& server, std::string_view type)
+{
+	for (const auto& entry: types)
+		if (type == entry.type)
+			return entry.create(server);
+	return nullptr;
+}
+
+/**
+ * Check if there's a type of service with the given name.
+ */
+bool Service::isKnownType(std::string_view type)
+{
+	for (const auto& entry: types)
+		if (type == entry.type)
+			return true;
+	return false;
+}
+
+Service::Service(Server& server, std::string_view type)
+	: server(server)
+	, type(type)
+{
+}
+
+/**
+ * Give the service the pseudo-client it acts through.
+ */
+void Service::attach(Client& newClient)
+{
+	client = &newClient;
+}
+
+/**
+ * Get the service's pseudo-client.
+ */
+Client& Service::getClient() const
+{
+	return *client;
+}
+
+/**
+ * Get the name of the service's type, as given in the configuration.
+ */
+const std::string& Service::getType() const
+{
+	return type;
+}
+
+void Service::onInvite(Client&, Channel& channel)
+{
+	join(channel.getName());
+}
+
+void Service::onChannelMessage(Client&, Channel&, std::string_view)
+{
+}
+
+void Service::onPrivateMessage(Client&, std::string_view)
+{
+}
+
+/**
+ * Have the service join a channel, just as if its pseudo-client had sent a
+ * JOIN message.
+ */
+void Service::join(std::string_view channel)
+{
+	std::string name(channel);
+	char* argv[] = {name.data()};
+	client->handleJoin(1, argv);
+}
+
+/**
+ * Have the service send a PRIVMSG to a channel or user, just as if its
+ * pseudo-client had sent it.
+ */
+void Service::sendMessage(std::string_view target, std::string_view text)
+{
+	std::string targetCopy(target);
+	std::string textCopy(text);
+	char* argv[] = {targetCopy.data(), textCopy.data()};
+	client->handlePrivMsg(2, argv);
+}
@@ -0,0 +1,28 @@
+#include "channel.hpp"
+#include "config.hpp"
+#include "log.hpp"
+#include "wordfilter.hpp"
+
+WordFilterService::WordFilterService(Server& server)
+	: Service(server, "badwords")
+{
+	reload();
+}
+
+/**
+ * Load the word list again. If it can't be read, the current words are kept.
+ */
+void WordFilterService::reload()
+{
+	if (!words.load(Config::get().botWords))
+		log::warn("Keeping the previous word list");
+}
+
+/**
+ * Scold the sender of a channel message that has any of the bad words in it.
+ */
+void WordFilterService::onChannelMessage(Client&, Channel& channel, std::string_view text)
+{
+	if (words.matches(text))
+		sendMessage(channel.getName(), "NO, BAD WORD!");
+}
@@ -0,0 +1,89 @@
+#include <cstring>
+
+#include "state.hpp"
+#include "utility.hpp"
+
+/**
+ * Append an integer (in host byte order, since the state is only ever read
+ * back on the same machine).
+ */
+void StateWriter::writeInt(int64_t value)
+{
+	data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/**
+ * Append a string, prefixed with its length.
+ */
+void StateWriter::writeString(std::string_view string)
+{
+	writeInt(string.length());
+	data.append(string);
+}
+
+/**
+ * Get the serialized state.
+ */
+const std::string& StateWriter::getData() const
+{
+	return data;
+}
+
+/**
+ * Discard the serialized state, so that the writer can be reused.
+ */
+void StateWriter::clear()
+{
+	data.clear();
+}
+
+/**
+ * Make a reader for some serialized state. The data is not copied, so it must
+ * outlive the reader.
+ */
+StateReader::StateReader(std::string_view data)
+	: data(data)
+{
+}
+
+/**
+ * Read an integer.
+ */
+int64_t StateReader::readInt()
+{
+	int64_t value;
+	if (data.length() - offset < sizeof(value))
+		fail("Truncated state data");
+	std::memcpy(&value, data.data() + offset, sizeof(value));
+	offset += sizeof(value);
+	return value;
+}
+
+/**
+ * Read a string. The returned view points into the reader's data.
+ */
+std::string_view StateReader::readString()
+{
+	uint64_t length = readInt();
+	if (data.length() - offset < length)
+		fail("Truncated state data");
+	std::string_view string = data.substr(offset, length);
+	offset += length;
+	return string;
+}
+
+/**
+ * Check if all the data has been read.
+ */
+bool StateReader::isAtEnd() const
+{
+	return offset == data.length();
+}
+
+/**
+ * Get the current read position, as a number of bytes from the start.
+ */
+size_t StateReader::getOffset() const
+{
+	return offset;
+}
@@ -0,0 +1,169 @@
+#include <algorithm>
+
+#include "timerwheel.hpp"
+
+/**
+ * Copy a timer. The copy is not scheduled, and has no callback.
+ */
+Timer::Timer(const Timer&)
+{
+}
+
+/**
+ * Assigning a timer doesn't change anything, for the same reason as copying.
+ */
+Timer& Timer::operator=(const Timer&)
+{
+	return *this;
+}
+
+/**
+ * Destroying a timer cancels it.
+ */
+Timer::~Timer()
+{
+	cancel();
+}
+
+/**
+ * Check if the timer is currently scheduled.
+ */
+bool Timer::isScheduled() const
+{
+	return next != nullptr;
+}
+
+/**
+ * Cancel the timer, if it's scheduled.
+ */
+void Timer::cancel()
+{
+	if (next == nullptr)
+		return;
+	prev->next = next;
+	next->prev = prev;
+	prev = next = nullptr;
+	if (count != nullptr)
+		--*count;
+	count = nullptr;
+}
+
+/**
+ * Get the time that the timer expires at, in Unix milliseconds.
+ */
+int64_t Timer::getExpiry() const
+{
+	return expiry;
+}
+
+/**
+ * Make an empty wheel. Each slot is a circular list with a sentinel head.
+ */
+TimerWheel::TimerWheel()
+{
+	for (Timer& head: slots)
+		head.prev = head.next = &head;
+}
+
+/**
+ * Unlink any timers that are still scheduled when the wheel is destroyed.
+ */
+TimerWheel::~TimerWheel()
+{
+	for (Timer& head: slots) {
+		while (head.next != &head)
+			head.next->cancel();
+		head.prev = head.next = nullptr;
+	}
+}
+
+/**
+ * Schedule a timer to expire at some time (in Unix milliseconds). If the timer
+ * was already scheduled, it's rescheduled. Timers that have already expired go
+ * in the slot of the last processed tick, so that they run on the next call to
+ * advance().
+ */
+void TimerWheel::schedule(Timer& timer, int64_t expiry)
+{
+	timer.cancel();
+	timer.expiry = expiry;
+	timer.count = &count;
+	link(slots[std::max(expiry / TICK, lastTick) % SLOTS], timer);
+	count++;
+}
+
+/**
+ * Run the callbacks of all timers that have expired by the given time. The
+ * slot of the last processed tick is checked again, since it may still hold
+ * timers that expire later within that tick. The expired timers are first
+ * moved to a separate list, so that callbacks can safely schedule or cancel
+ * any timer, including other expired ones.
+ */
+void TimerWheel::advance(int64_t now)
+{
+	int64_t tick = now / TICK;
+	if (lastTick == -1)
+		lastTick = tick - SLOTS;
+
+	// Collect the expired timers from every slot passed since the last call.
+	Timer expired;
+	expired.prev = expired.next = &expired;
+	int64_t first = std::max(lastTick, tick - static_cast<int64_t>(SLOTS) + 1);
+	for (int64_t t = first; t <= tick; t++) {
+		Timer& head = slots[t % SLOTS];
+		for (Timer* timer = head.next; timer != &head;) {
+			Timer* next = timer->next;
+			if (timer->expiry <= now) {
+				timer->cancel();
+				link(expired, *timer);
+			}
+			timer = next;
+		}
+	}
+	lastTick = tick;
+
+	// Run the expired timers.
+	while (expired.next != &expired) {
+		Timer* timer = expired.next;
+		timer->cancel();
+		if (timer->callback)
+			timer->callback();
+	}
+}
+
+/**
+ * Get the number of milliseconds until the end of the next tick with a non-empty
+ * slot, for use as an epoll_wait() timeout. Timers therefore run at most one
+ * tick late. Returns -1 if there are no timers at all.
+ */
+int TimerWheel::getTimeout(int64_t now) const
+{
+	if (count == 0)
+		return -1;
+	int64_t tick = now / TICK;
+	for (size_t i = 0; i < SLOTS; i++) {
+		const Timer& head = slots[(tick + i) % SLOTS];
+		if (head.next != &head)
+			return static_cast<int>(std::max<int64_t>(0, (tick + i + 1) * TICK - now));
+	}
+	return 0;
+}
+
+/**
+ * Get the number of scheduled timers.
+ */
+size_t TimerWheel::getTimerCount() const
+{
+	return count;
+}
+
+/**
+ * Insert a timer at the end of a list.
+ */
+void TimerWheel::link(Timer& head, Timer& timer)
+{
+	timer.prev = head.prev;
+	timer.next = &head;
+	head.prev->next = &timer;
+	head.prev = &timer;
+}
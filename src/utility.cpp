@@ -19,14 +19,14 @@ void safeClose(int& fd)
 }
 
 /**
-  * Check if two null-terminated strings match, ignoring lower/upper case.
-  */
-bool matchIgnoreCase(const char* a, const char* b)
+ * Convert a string to lowercase, for comparing names according to the server's
+ * casemapping (see setCasemapping).
+ */
+std::string foldCase(std::string_view string)
 {
-	for (; *a || *b; a++, b++)
-		if (std::toupper(*a) != std::toupper(*b))
-			return false;
-	return true;
+	std::string folded(string);
+	foldCaseInPlace(folded.data(), folded.length());
+	return folded;
 }
 
 /**
@@ -66,12 +66,27 @@ bool parseInt(const char* input, int& output)
 	return true;
 }
 
-bool isValidNameString(std::string_view string)
+/**
+ * Convert a string to a 64-bit integer, such as a timestamp. Return true if the
+ * conversion was successful.
+ */
+bool parseInt(const char* input, int64_t& output)
 {
-	static std::string_view forbidden = " ,:!@#*";
-
-	for (char c: string)
-		if ((forbidden.find(c) != forbidden.npos) || !std::isprint(c))
-			return false;
+	assert(input != nullptr);
+	char* end = nullptr;
+	errno = 0;
+	long long value = std::strtoll(input, &end, 10);
+	if (errno == ERANGE || *input == '\0' || *end != '\0')
+		return false;
+	output = value;
 	return true;
 }
+
+/**
+ * Check if a string only has characters allowed in names, such as nicknames
+ * and channel names (see NAME_CHARS).
+ */
+bool isValidNameString(std::string_view string)
+{
+	return isInCharClass(string, NAME_CHARS);
+}
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
+#include "log.hpp"
+#include "utility.hpp"
+#include "wordmatcher.hpp"
+
+/**
+ * Check if a byte is part of a word. Bytes from multibyte UTF-8 characters
+ * count as letters, so words aren't matched inside non-ASCII words either.
+ */
+static bool isWordChar(unsigned char c)
+{
+	return std::isalnum(c) || c == '_' || c >= 0x80;
+}
+
+/**
+ * Read a list of words from a file, one per line, and build a new automaton
+ * from them. Lines starting with '#' are comments. If the file can't be read,
+ * the error is logged, the current words are kept, and false is returned.
+ */
+bool WordMatcher::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		log::error("Failed to open word list ", path);
+		return false;
+	}
+	std::vector<std::string> list;
+	for (std::string line; std::getline(file, line);) {
+		size_t begin = line.find_first_not_of(" \t\r");
+		if (begin == line.npos || line[begin] == '#')
+			continue;
+		size_t end = line.find_last_not_of(" \t\r");
+		list.push_back(line.substr(begin, end - begin + 1));
+	}
+	build(list);
+	log::info("Loaded ", words.size(), " words from ", path, " (", outputs.size(), " states)");
+	return true;
+}
+
+/**
+ * Build the automaton for a list of words, replacing any previous one.
+ */
+void WordMatcher::build(const std::vector<std::string>& list)
+{
+	// Strip the '*' wildcards, and fold each word to lowercase.
+	std::vector<std::string> texts;
+	words.clear();
+	for (std::string_view text: list) {
+		Word word;
+		word.wholeStart = !text.starts_with('*');
+		word.wholeEnd = !text.ends_with('*');
+		text.remove_prefix(!word.wholeStart);
+		if (!text.empty())
+			text.remove_suffix(!word.wholeEnd);
+		if (text.empty())
+			continue;
+		word.length = text.size();
+		words.push_back(word);
+		texts.push_back(foldCase(text));
+	}
+
+	// Give each character that appears in a word its own class, shared by its
+	// uppercase form. All other bytes share class 0, which always leads back to
+	// the initial state. This keeps the table to a few dozen columns instead
+	// of 256.
+	std::fill(std::begin(classes), std::end(classes), 0);
+	classCount = 1;
+	for (const std::string& text: texts)
+		for (unsigned char c: text)
+			if (classes[c] == 0)
+				classes[c] = classCount++;
+	for (int c = 'A'; c <= 'Z'; c++)
+		classes[c] = classes[static_cast<unsigned char>(foldChar(c))];
+
+	// Build the trie of the words. State 0 is the initial state, and missing
+	// transitions are -1 until the failure links are filled in below.
+	transitions.assign(classCount, -1);
+	outputs.assign(1, -1);
+	for (size_t i = 0; i < texts.size(); i++) {
+		int32_t state = 0;
+		for (unsigned char c: texts[i]) {
+			int32_t& next = transitions[state * classCount + classes[c]];
+			if (next == -1) {
+				next = outputs.size();
+				outputs.push_back(-1);
+				transitions.resize(transitions.size() + classCount, -1);
+			}
+			state = transitions[state * classCount + classes[c]];
+		}
+		words[i].next = outputs[state];
+		outputs[state] = i;
+	}
+
+	// Visit the states in breadth-first order, so that each state's failure
+	// state (the longest proper suffix that's also in the trie) is finished
+	// before the state itself. Missing transitions are copied from the failure
+	// state, turning the trie into a DFA, and each state's output list is
+	// extended with the words ending in its failure state.
+	std::vector<int32_t> failure(outputs.size(), 0);
+	std::vector<int32_t> queue;
+	for (size_t c = 0; c < classCount; c++) {
+		int32_t& next = transitions[c];
+		if (next == -1)
+			next = 0;
+		else
+			queue.push_back(next);
+	}
+	for (size_t i = 0; i < queue.size(); i++) {
+		int32_t state = queue[i];
+		int32_t fallback = failure[state];
+		if (outputs[state] == -1) {
+			outputs[state] = outputs[fallback];
+		} else {
+			int32_t last = outputs[state];
+			while (words[last].next != -1)
+				last = words[last].next;
+			words[last].next = outputs[fallback];
+		}
+		for (size_t c = 0; c < classCount; c++) {
+			int32_t& next = transitions[state * classCount + c];
+			int32_t fallbackNext = transitions[fallback * classCount + c];
+			if (next == -1) {
+				next = fallbackNext;
+			} else {
+				failure[next] = fallbackNext;
+				queue.push_back(next);
+			}
+		}
+	}
+}
+
+/**
+ * Check if any of the words appear in a text.
+ */
+bool WordMatcher::matches(std::string_view text) const
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+	int32_t state = 0;
+	for (size_t i = 0; i < text.size(); i++) {
+		state = transitions[state * classCount + classes[bytes[i]]];
+		for (int32_t index = outputs[state]; index != -1; index = words[index].next) {
+			const Word& word = words[index];
+			size_t start = i + 1 - word.length;
+			if (word.wholeStart && start > 0 && isWordChar(bytes[start - 1]))
+				continue;
+			if (word.wholeEnd && i + 1 < text.size() && isWordChar(bytes[i + 1]))
+				continue;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Replace every occurrence of the words in a text with asterisks. Returns the
+ * number of occurrences replaced. The occurrences are all found before any are
+ * replaced, so the asterisks don't count as word boundaries.
+ */
+size_t WordMatcher::censor(std::string& text) const
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+	std::vector<std::pair<size_t, size_t>> found;
+	int32_t state = 0;
+	for (size_t i = 0; i < text.size(); i++) {
+		state = transitions[state * classCount + classes[bytes[i]]];
+		for (int32_t index = outputs[state]; index != -1; index = words[index].next) {
+			const Word& word = words[index];
+			size_t start = i + 1 - word.length;
+			if (word.wholeStart && start > 0 && isWordChar(bytes[start - 1]))
+				continue;
+			if (word.wholeEnd && i + 1 < text.size() && isWordChar(bytes[i + 1]))
+				continue;
+			found.emplace_back(start, word.length);
+		}
+	}
+	for (const auto& [start, length]: found)
+		text.replace(start, length, length, '*');
+	return found.size();
+}
+
+/**
+ * Get the number of words the automaton was built from.
+ */
+size_t WordMatcher::getWordCount() const
+{
+	return words.size();
+}
+
+/**
+ * Get the number of states in the automaton.
+ */
+size_t WordMatcher::getStateCount() const
+{
+	return outputs.size();
+}